@@ -0,0 +1,74 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+#include <concurrent_ordered_map.hpp>
+
+namespace {
+
+using map_type = nstd::concurrent_ordered_map<int, int>;
+
+/**
+ * Runs readers doing pinned lookups, while one writer keeps updating the map
+ * @return lookups per second of all the readers
+ */
+double measure(map_type& mp, size_t size, size_t threads, std::chrono::milliseconds duration) {
+    std::atomic<bool> finished = false;
+    std::atomic<size_t> lookups = 0;
+    std::vector<std::thread> readers;
+    for (size_t i = 0; i < threads; ++i) {
+        readers.emplace_back([&, i] {
+            auto reader = mp.make_reader();
+            std::mt19937 generator(static_cast<unsigned>(i));
+            size_t done = 0;
+            size_t found = 0;
+            while (!finished.load(std::memory_order_relaxed)) {
+                auto guard = reader.pin();
+                for (int j = 0; j < 64; ++j) {
+                    found += guard.contains(static_cast<int>(generator() % size));
+                }
+                done += 64;
+            }
+            lookups += done + found % 2;
+        });
+    }
+    std::thread writer([&] {
+        std::mt19937 generator(42);
+        while (!finished.load(std::memory_order_relaxed)) {
+            mp.insert_or_assign(static_cast<int>(generator() % size), 0);
+        }
+    });
+    std::this_thread::sleep_for(duration);
+    finished = true;
+    writer.join();
+    for (auto& reader: readers) {
+        reader.join();
+    }
+    return static_cast<double>(lookups) / std::chrono::duration<double>(duration).count();
+}
+
+} // namespace
+
+/**
+ * Measures reader throughput scaling of concurrent ordered map under one writer
+ * Usage: ConcurrentOrderedMapBenchmark [size] [max reader threads]
+ */
+int main(int argc, char** argv) {
+    size_t size = (argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000'000);
+    size_t max_threads = (argc > 2 ? std::strtoull(argv[2], nullptr, 10)
+                                   : std::max<size_t>(std::thread::hardware_concurrency(), 1));
+    map_type mp;
+    for (size_t i = 0; i < size; i += 2) {
+        mp.insert({static_cast<int>(i), 0});
+    }
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        double throughput = measure(mp, size, threads, std::chrono::milliseconds(1000));
+        std::printf("readers %3zu %14.0f lookups/s %12.0f lookups/s per reader\n", threads, throughput,
+                    throughput / threads);
+    }
+    return 0;
+}
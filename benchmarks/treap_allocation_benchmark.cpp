@@ -0,0 +1,103 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <vector>
+#include <ordered_set.hpp>
+#include <vector_tree.hpp>
+
+namespace {
+
+size_t heap_allocations = 0;
+
+template <typename Function>
+void measure(const char* name, size_t operations, Function function) {
+    size_t allocations = heap_allocations;
+    auto start = std::chrono::steady_clock::now();
+    function();
+    auto finish = std::chrono::steady_clock::now();
+    double nanoseconds = std::chrono::duration<double, std::nano>(finish - start).count();
+    std::printf("%-40s %10.1f ns/op %12.6f allocations/op\n", name, nanoseconds / operations,
+                static_cast<double>(heap_allocations - allocations) / operations);
+}
+
+} // namespace
+
+void* operator new(size_t size) {
+    ++heap_allocations;
+    if (void* ptr = std::malloc(size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+int main() {
+    constexpr size_t size = 1'000'000;
+    std::mt19937_64 generator(42);
+    std::vector<int> keys(size);
+    for (auto& key: keys) {
+        key = static_cast<int>(generator());
+    }
+
+    nstd::ordered_set<int> st;
+    measure("ordered_set random insert", size, [&] {
+        for (int key: keys) {
+            st.insert(key);
+        }
+    });
+    measure("ordered_set random erase_key", size, [&] {
+        for (int key: keys) {
+            st.erase_key(key);
+        }
+    });
+    measure("ordered_set random reinsert", size, [&] {
+        for (int key: keys) {
+            st.insert(key);
+        }
+    });
+
+    // narrow layout keeps the same tree in smaller nodes
+    nstd::ordered_set<int, std::less<int>, std::allocator<int>, nstd::random_priority_generator,
+            nstd::narrow_treap_layout> narrow;
+    measure("narrow ordered_set random insert", size, [&] {
+        for (int key: keys) {
+            narrow.insert(key);
+        }
+    });
+    size_t found = 0;
+    measure("ordered_set random find", size, [&] {
+        for (int key: keys) {
+            found += (st.find(key ^ 1) != st.end());
+        }
+    });
+    measure("narrow ordered_set random find", size, [&] {
+        for (int key: keys) {
+            found += (narrow.find(key ^ 1) != narrow.end());
+        }
+    });
+    std::printf("node bytes: ordered_set %zu, narrow ordered_set %zu (%zu found)\n",
+                sizeof(nstd::ordered_set_node<int>), sizeof(nstd::ordered_set_node<int, nstd::narrow_treap_layout>),
+                found);
+
+    nstd::vector_tree<int> vec;
+    measure("vector_tree random index insert", size / 10, [&] {
+        for (size_t i = 0; i < size / 10; ++i) {
+            vec.insert(generator() % (vec.size() + 1), keys[i]);
+        }
+    });
+    measure("vector_tree random index erase", size / 10, [&] {
+        for (size_t i = 0; i < size / 10; ++i) {
+            vec.erase_index(generator() % vec.size());
+        }
+    });
+    return 0;
+}
@@ -0,0 +1,87 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <numeric>
+#include <random>
+#include <set>
+#include <vector>
+#include <ordered_map.hpp>
+#include <ordered_set.hpp>
+#include <vector_tree.hpp>
+
+namespace {
+
+/**
+ * Scans the container forward and backward several times
+ * @return scanned elements per second for both directions
+ */
+template <typename Container, typename Projection>
+std::pair<double, double> measure(const Container& container, Projection projection, size_t rounds) {
+    long long checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < rounds; ++i) {
+        for (auto it = container.begin(); it != container.end(); ++it) {
+            checksum += projection(*it);
+        }
+    }
+    auto middle = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < rounds; ++i) {
+        for (auto it = container.end(); it != container.begin();) {
+            --it;
+            checksum -= projection(*it);
+        }
+    }
+    auto finish = std::chrono::steady_clock::now();
+    if (checksum != 0) {
+        std::printf("checksum mismatch\n");
+    }
+    double elements = static_cast<double>(container.size() * rounds);
+    return {elements / std::chrono::duration<double>(middle - start).count(),
+            elements / std::chrono::duration<double>(finish - middle).count()};
+}
+
+template <typename Container, typename Projection>
+void report(const char* name, const Container& container, Projection projection, size_t rounds) {
+    auto [forward, backward] = measure(container, projection, rounds);
+    std::printf("%-24s %14.0f elements/s forward %14.0f elements/s backward\n", name, forward, backward);
+}
+
+} // namespace
+
+/**
+ * Measures full scan throughput of treap containers against standard ones
+ * Keys are inserted in random order, so in-order neighbours are scattered in memory
+ * Usage: TreapIterationBenchmark [size] [rounds]
+ */
+int main(int argc, char** argv) {
+    size_t size = (argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000'000);
+    size_t rounds = (argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 10);
+    std::vector<int> keys(size);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+
+    using seeded = nstd::seeded_priority_generator<>;
+    nstd::ordered_set<int, std::less<int>, std::allocator<int>, seeded> ordered_set;
+    nstd::ordered_map<int, int, std::less<int>, std::allocator<int>, void, seeded> ordered_map;
+    nstd::vector_tree<int, std::allocator<int>, void, seeded> vector_tree;
+    std::set<int> set;
+    std::map<int, int> map;
+    for (int key: keys) {
+        ordered_set.insert(key);
+        ordered_map.insert({key, key});
+        vector_tree.insert(static_cast<size_t>(key) % (vector_tree.size() + 1), key);
+        set.insert(key);
+        map.insert({key, key});
+    }
+
+    auto key = [](int value) { return value; };
+    auto mapped = [](const auto& pair) { return pair.second; };
+    report("nstd::ordered_set", ordered_set, key, rounds);
+    report("std::set", set, key, rounds);
+    report("nstd::ordered_map", ordered_map, mapped, rounds);
+    report("std::map", map, mapped, rounds);
+    report("nstd::vector_tree", vector_tree, key, rounds);
+    return 0;
+}
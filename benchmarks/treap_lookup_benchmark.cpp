@@ -0,0 +1,117 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <random>
+#include <vector>
+#include <btree_map.hpp>
+#include <ordered_map.hpp>
+
+namespace {
+
+using map_type = nstd::ordered_map<int, int, std::less<int>, std::allocator<int>, void,
+        nstd::seeded_priority_generator<>>;
+using btree_map_type = nstd::btree_map<int, int>;
+
+/**
+ * Runs the lookup function several times
+ * @return resolved keys per second
+ */
+template <typename Lookup>
+double measure(size_t keys_count, size_t rounds, Lookup lookup) {
+    long long checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < rounds; ++i) {
+        checksum += lookup();
+    }
+    auto finish = std::chrono::steady_clock::now();
+    if (checksum < 0) {
+        std::printf("checksum mismatch\n");
+    }
+    return static_cast<double>(keys_count * rounds) / std::chrono::duration<double>(finish - start).count();
+}
+
+void report(const char* name, double keys_per_second) {
+    std::printf("%-32s %14.0f keys/s\n", name, keys_per_second);
+}
+
+/**
+ * Looks up the keys one by one
+ * @return count of the absent keys
+ */
+template <typename Map, typename Results>
+long long find_loop(const Map& map, const std::vector<int>& keys, Results& results) {
+    results.clear();
+    for (int key: keys) {
+        results.push_back(map.find(key));
+    }
+    return static_cast<long long>(std::count(results.begin(), results.end(), map.end()));
+}
+
+} // namespace
+
+/**
+ * Measures lookup throughput of nstd::ordered_map and nstd::btree_map for batches of probe keys
+ * Usage: TreapLookupBenchmark [size] [batch] [rounds]
+ */
+int main(int argc, char** argv) {
+    size_t size = (argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000'000);
+    size_t batch = (argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 100'000);
+    size_t rounds = (argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 10);
+    std::mt19937 generator(42);
+    int key_range = static_cast<int>(2 * size);
+
+    map_type map;
+    btree_map_type btree_map;
+    for (size_t i = 0; i < size; ++i) {
+        int key = static_cast<int>(generator() % key_range);
+        map.insert({key, key});
+        btree_map.insert({key, key});
+    }
+    std::vector<int> keys(batch);
+    for (int& key: keys) {
+        key = static_cast<int>(generator() % key_range);
+    }
+
+    std::vector<map_type::const_iterator> results;
+    results.reserve(batch);
+    std::vector<btree_map_type::const_iterator> btree_results;
+    btree_results.reserve(batch);
+    const map_type& const_map = map;
+    const btree_map_type& const_btree_map = btree_map;
+    report("unsorted find loop", measure(batch, rounds, [&]() {
+        return find_loop(const_map, keys, results);
+    }));
+    report("unsorted find_batch", measure(batch, rounds, [&]() {
+        results.clear();
+        const_map.find_batch(keys.begin(), keys.end(), std::back_inserter(results));
+        return static_cast<long long>(std::count(results.begin(), results.end(), const_map.end()));
+    }));
+    report("unsorted btree_map find loop", measure(batch, rounds, [&]() {
+        return find_loop(const_btree_map, keys, btree_results);
+    }));
+
+    std::sort(keys.begin(), keys.end());
+    report("sorted find loop", measure(batch, rounds, [&]() {
+        return find_loop(const_map, keys, results);
+    }));
+    report("sorted find_many", measure(batch, rounds, [&]() {
+        results.clear();
+        const_map.find_many(keys.begin(), keys.end(), std::back_inserter(results));
+        return static_cast<long long>(std::count(results.begin(), results.end(), const_map.end()));
+    }));
+    report("sorted lower_bound from hint", measure(batch, rounds, [&]() {
+        results.clear();
+        auto hint = const_map.begin();
+        for (int key: keys) {
+            hint = const_map.lower_bound(hint, key);
+            results.push_back(hint);
+        }
+        return static_cast<long long>(std::count(results.begin(), results.end(), const_map.end()));
+    }));
+    report("sorted btree_map find loop", measure(batch, rounds, [&]() {
+        return find_loop(const_btree_map, keys, btree_results);
+    }));
+    return 0;
+}
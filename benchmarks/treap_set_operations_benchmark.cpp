@@ -0,0 +1,66 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+#include <ordered_set.hpp>
+
+namespace {
+
+using set_type = nstd::ordered_set<long long>;
+
+std::vector<long long> random_sorted_keys(size_t size, std::mt19937_64& generator) {
+    std::vector<long long> keys(size);
+    for (auto& key: keys) {
+        key = static_cast<long long>(generator() % (4 * size));
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    return keys;
+}
+
+template <typename Operation>
+void measure(const char* name, const std::vector<long long>& first, const std::vector<long long>& second,
+             const nstd::set_operation_policy& policy, Operation operation) {
+    set_type st = set_type::from_sorted(first.begin(), first.end());
+    set_type other = set_type::from_sorted(second.begin(), second.end());
+    auto start = std::chrono::steady_clock::now();
+    operation(st, std::move(other), policy);
+    auto finish = std::chrono::steady_clock::now();
+    double milliseconds = std::chrono::duration<double, std::milli>(finish - start).count();
+    std::printf("%-26s threads %3zu %12.2f ms, result size %zu\n", name, policy.threads, milliseconds, st.size());
+}
+
+} // namespace
+
+/**
+ * Measures fork-join set operations scaling
+ * Usage: TreapSetOperationsBenchmark [size] [max threads] [grain size]
+ */
+int main(int argc, char** argv) {
+    size_t size = (argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4'000'000);
+    size_t max_threads = (argc > 2 ? std::strtoull(argv[2], nullptr, 10)
+                                   : std::max<size_t>(std::thread::hardware_concurrency(), 1));
+    size_t grain_size = (argc > 3 ? std::strtoull(argv[3], nullptr, 10) : nstd::set_operation_policy().grain_size);
+
+    std::mt19937_64 generator(42);
+    std::vector<long long> first = random_sorted_keys(size, generator);
+    std::vector<long long> second = random_sorted_keys(size, generator);
+
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        nstd::set_operation_policy policy{threads, grain_size};
+        measure("set_union", first, second, policy,
+                [](set_type& st, set_type&& other, auto& policy) { st.set_union(std::move(other), policy); });
+        measure("set_intersection", first, second, policy,
+                [](set_type& st, set_type&& other, auto& policy) { st.set_intersection(std::move(other), policy); });
+        measure("set_difference", first, second, policy,
+                [](set_type& st, set_type&& other, auto& policy) { st.set_difference(std::move(other), policy); });
+        measure("set_symmetric_difference", first, second, policy,
+                [](set_type& st, set_type&& other, auto& policy) {
+                    st.set_symmetric_difference(std::move(other), policy);
+                });
+    }
+    return 0;
+}
@@ -5,10 +5,55 @@
 #include <gtest/gtest.h>
 #include <ordered_map.hpp>
 #include <ordered_set.hpp>
+#include <ordered_multiset.hpp>
+#include <ordered_multimap.hpp>
+#include <btree_set.hpp>
+#include <btree_map.hpp>
+#include <persistent_ordered_map.hpp>
+#include <concurrent_ordered_map.hpp>
+#include <array>
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
+#include <thread>
 #include <vector>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <random>
 #include <algorithm>
+#include <iterator>
+#include <numeric>
 #include <vector_tree.hpp>
 
+template<typename T>
+struct counting_allocator {
+    using value_type = T;
+
+    size_t* allocations;
+
+    explicit counting_allocator(size_t* allocations) : allocations(allocations) {}
+
+    template<typename U>
+    counting_allocator(const counting_allocator<U>& other) : allocations(other.allocations) {}
+
+    T* allocate(size_t n) {
+        ++*allocations;
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T* ptr, size_t n) { std::allocator<T>().deallocate(ptr, n); }
+
+    template<typename U>
+    bool operator==(const counting_allocator<U>& other) const { return allocations == other.allocations; }
+
+    template<typename U>
+    bool operator!=(const counting_allocator<U>& other) const { return allocations != other.allocations; }
+};
+
 template<typename Container1, typename Container2>
 void EXPECT_EQ_WITH_CONTENT(const Container1& cont1, const Container2& cont2) {
     EXPECT_EQ(cont1.size(), cont2.size());
@@ -40,6 +85,50 @@ TEST(TreesTest, OrderedSetIterators) {
     EXPECT_EQ_WITH_CONTENT(st, vec);
 }
 
+TEST(TreesTest, OrderedSetIncrementDecrement) {
+    std::mt19937 generator(41);
+    nstd::ordered_set<int> st;
+    std::set<int> expected;
+    EXPECT_EQ(st.begin(), st.end());
+    for (int i = 0; i < 2000; ++i) {
+        int key = static_cast<int>(generator() % 1000);
+        if (generator() % 3 == 0) {
+            st.erase_key(key);
+            expected.erase(key);
+        } else {
+            st.insert(key);
+            expected.insert(key);
+        }
+        if (i % 100 != 0) {
+            continue;
+        }
+        auto it = st.begin();
+        for (int value: expected) {
+            ASSERT_EQ(*it++, value);
+        }
+        EXPECT_EQ(it, st.end());
+        for (auto expected_it = expected.rbegin(); expected_it != expected.rend(); ++expected_it) {
+            ASSERT_EQ(*--it, *expected_it);
+        }
+        EXPECT_EQ(it, st.begin());
+        // mixed steps from the middle
+        it = st.begin() + static_cast<std::ptrdiff_t>(st.size() / 2);
+        auto expected_it = std::next(expected.begin(), static_cast<std::ptrdiff_t>(expected.size() / 2));
+        for (int step = 0; step < 50 && it != st.end() && it != st.begin(); ++step) {
+            if (generator() % 2 == 0) {
+                ++it;
+                ++expected_it;
+            } else {
+                --it;
+                --expected_it;
+            }
+            if (it != st.end()) {
+                ASSERT_EQ(*it, *expected_it);
+            }
+        }
+    }
+}
+
 TEST(TreesTest, OrderedSetInsertErase) {
     nstd::ordered_set<int> st;
     constexpr int size = 50;
@@ -88,6 +177,279 @@ TEST(TreesTest, OrderedSetCopy) {
     EXPECT_NE(st2.size(), st.size());
 }
 
+TEST(TreesTest, OrderedSetNodePool) {
+    size_t allocations = 0;
+    nstd::ordered_set<int, std::less<>, counting_allocator<int>> st{std::less<>(), counting_allocator<int>(&allocations)};
+    constexpr int size = 10000;
+    for (int i = 0; i < size; ++i) {
+        st.insert(i);
+    }
+    // nodes are allocated in geometrically growing chunks
+    EXPECT_LT(allocations, 20);
+    size_t chunk_allocations = allocations;
+    // erased nodes are recycled by the following insertions
+    for (int round = 0; round < 10; ++round) {
+        st.erase_key_interval(0, size / 2);
+        for (int i = 0; i < size / 2; ++i) {
+            st.insert(i);
+        }
+    }
+    EXPECT_EQ(allocations, chunk_allocations);
+    EXPECT_EQ(st.size(), size);
+    st.clear();
+    EXPECT_TRUE(st.empty());
+    st.insert({3, 1, 2});
+    EXPECT_EQ(st.key_of_order(0), 1);
+    EXPECT_EQ(st.key_of_order(2), 3);
+}
+
+TEST(TreesTest, OrderedSetSortedConstruction) {
+    std::vector<int> sorted;
+    for (int i = 0; i < 1000; ++i) {
+        sorted.push_back(2 * i);
+        sorted.push_back(2 * i);
+    }
+    auto st = nstd::ordered_set<int>::from_sorted(sorted.begin(), sorted.end());
+    EXPECT_EQ(st.size(), 1000);
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_EQ(st.key_of_order(i), 2 * i);
+        EXPECT_EQ(st.order_of_key(2 * i), i);
+    }
+    // appending sorted range after the greatest key
+    std::vector<int> tail{5000, 5001, 5002};
+    st.insert(tail.begin(), tail.end());
+    // inserting runs, which overlap with existing keys
+    std::vector<int> mixed{7, 3, 2, 1, 4, 5, 6, 4000, 3, 9};
+    st.insert(mixed.begin(), mixed.end());
+    std::vector<int> expected(sorted);
+    expected.insert(expected.end(), tail.begin(), tail.end());
+    expected.insert(expected.end(), mixed.begin(), mixed.end());
+    std::sort(expected.begin(), expected.end());
+    expected.resize(std::unique(expected.begin(), expected.end()) - expected.begin());
+    EXPECT_EQ_WITH_CONTENT(st, expected);
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ(st.order_of_key(expected[i]), i);
+    }
+
+    nstd::ordered_set<int> moved(std::move(st));
+    EXPECT_TRUE(st.empty());
+    EXPECT_TRUE(st.begin() == st.end());
+    EXPECT_EQ_WITH_CONTENT(moved, expected);
+
+    nstd::ordered_map<int, char> mp{{1, 'a'}, {2, 'b'}, {2, 'c'}, {3, 'd'}};
+    EXPECT_EQ(mp.size(), 3);
+    EXPECT_EQ(mp[2], 'b');
+    nstd::ordered_map<int, char> copied(mp);
+    copied.assign_sorted(mp.rbegin(), mp.rend());
+    EXPECT_EQ(copied.size(), 1);
+    EXPECT_EQ(copied.key_of_order(0), 3);
+}
+
+TEST(TreesTest, OrderedSetRandomOperations) {
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> distribution(0, 500);
+    nstd::ordered_set<int> st;
+    std::set<int> expected;
+    for (int i = 0; i < 5000; ++i) {
+        int key = distribution(generator);
+        switch (generator() % 4) {
+            case 0:
+            case 1:
+                st.insert(key);
+                expected.insert(key);
+                break;
+            case 2:
+                st.erase_key(key);
+                expected.erase(key);
+                break;
+            default:
+                st.erase_key_interval(key, key + 10);
+                expected.erase(expected.lower_bound(key), expected.lower_bound(key + 10));
+        }
+        ASSERT_EQ(st.size(), expected.size());
+        ASSERT_EQ(st.order_of_key(key), expected.count(key) != 0 ? std::distance(expected.begin(), expected.find(key))
+                                                                 : expected.size());
+    }
+    EXPECT_EQ_WITH_CONTENT(st, expected);
+}
+
+TEST(TreesTest, OrderedSetAlgebra) {
+    std::mt19937 generator(13);
+    for (int round = 0; round < 20; ++round) {
+        std::set<int> first;
+        std::set<int> second;
+        for (int i = 0; i < 300; ++i) {
+            first.insert(static_cast<int>(generator() % 1000));
+            second.insert(static_cast<int>(generator() % (round % 2 == 0 ? 1000 : 50)));
+        }
+        std::vector<int> expected_union;
+        std::vector<int> expected_intersection;
+        std::vector<int> expected_difference;
+        std::vector<int> expected_symmetric_difference;
+        std::set_union(first.begin(), first.end(), second.begin(), second.end(), std::back_inserter(expected_union));
+        std::set_intersection(first.begin(), first.end(), second.begin(), second.end(),
+                              std::back_inserter(expected_intersection));
+        std::set_difference(first.begin(), first.end(), second.begin(), second.end(),
+                            std::back_inserter(expected_difference));
+        std::set_symmetric_difference(first.begin(), first.end(), second.begin(), second.end(),
+                                      std::back_inserter(expected_symmetric_difference));
+
+        auto make_first = [&] { return nstd::ordered_set<int>::from_sorted(first.begin(), first.end()); };
+        auto make_second = [&] { return nstd::ordered_set<int>::from_sorted(second.begin(), second.end()); };
+
+        auto st = make_first();
+        st.set_union(make_second());
+        EXPECT_EQ_WITH_CONTENT(st, expected_union);
+        auto other = make_second();
+        st = make_first();
+        st.set_intersection(std::move(other));
+        EXPECT_TRUE(other.empty());
+        EXPECT_EQ_WITH_CONTENT(st, expected_intersection);
+        st = make_first();
+        st.set_difference(make_second());
+        EXPECT_EQ_WITH_CONTENT(st, expected_difference);
+        st = make_first();
+        other = make_second();
+        st.set_symmetric_difference(other);
+        EXPECT_EQ(other.size(), second.size());
+        EXPECT_EQ_WITH_CONTENT(st, expected_symmetric_difference);
+        for (size_t i = 0; i < expected_symmetric_difference.size(); ++i) {
+            EXPECT_EQ(st.order_of_key(expected_symmetric_difference[i]), i);
+        }
+        // stolen nodes are usable after the source container is destroyed
+        st.insert(-1);
+        st.erase_key(expected_symmetric_difference.front());
+    }
+
+    // when keys are equal, this container value is kept
+    nstd::ordered_map<int, char> mp{{1, 'a'}, {2, 'b'}, {3, 'c'}};
+    nstd::ordered_map<int, char> other{{2, 'x'}, {3, 'y'}, {4, 'z'}};
+    mp.set_union(std::move(other));
+    EXPECT_EQ(mp.size(), 4);
+    EXPECT_EQ(mp[2], 'b');
+    EXPECT_EQ(mp[4], 'z');
+}
+
+TEST(TreesTest, OrderedSetParallelAlgebra) {
+    std::mt19937 generator(17);
+    std::set<int> first;
+    std::set<int> second;
+    for (int i = 0; i < 20000; ++i) {
+        first.insert(static_cast<int>(generator() % 40000));
+        second.insert(static_cast<int>(generator() % 40000));
+    }
+    std::vector<int> expected_union;
+    std::vector<int> expected_intersection;
+    std::vector<int> expected_difference;
+    std::vector<int> expected_symmetric_difference;
+    std::set_union(first.begin(), first.end(), second.begin(), second.end(), std::back_inserter(expected_union));
+    std::set_intersection(first.begin(), first.end(), second.begin(), second.end(),
+                          std::back_inserter(expected_intersection));
+    std::set_difference(first.begin(), first.end(), second.begin(), second.end(),
+                        std::back_inserter(expected_difference));
+    std::set_symmetric_difference(first.begin(), first.end(), second.begin(), second.end(),
+                                  std::back_inserter(expected_symmetric_difference));
+
+    auto make_first = [&] { return nstd::ordered_set<int>::from_sorted(first.begin(), first.end()); };
+    auto make_second = [&] { return nstd::ordered_set<int>::from_sorted(second.begin(), second.end()); };
+    for (size_t threads: {2, 3, 8}) {
+        nstd::set_operation_policy policy{threads, 64};
+        auto st = make_first();
+        st.set_union(make_second(), policy);
+        EXPECT_EQ_WITH_CONTENT(st, expected_union);
+        st = make_first();
+        st.set_intersection(make_second(), policy);
+        EXPECT_EQ_WITH_CONTENT(st, expected_intersection);
+        st = make_first();
+        st.set_difference(make_second(), policy);
+        EXPECT_EQ_WITH_CONTENT(st, expected_difference);
+        st = make_first();
+        auto other = make_second();
+        st.set_symmetric_difference(other, policy);
+        EXPECT_EQ_WITH_CONTENT(st, expected_symmetric_difference);
+        for (size_t i = 0; i < expected_symmetric_difference.size(); i += 97) {
+            EXPECT_EQ(st.order_of_key(expected_symmetric_difference[i]), i);
+        }
+    }
+
+    nstd::ordered_map<int, int> mp;
+    nstd::ordered_map<int, int> other;
+    for (int i = 0; i < 10000; ++i) {
+        mp[2 * i] = 1;
+        other[3 * i] = 2;
+    }
+    mp.set_union(std::move(other), nstd::set_operation_policy{4, 16});
+    EXPECT_EQ(mp.size(), 10000 + 10000 - 3334);
+    EXPECT_EQ(mp[6], 1);
+    EXPECT_EQ(mp[3], 2);
+}
+
+struct throwing_less {
+    // comparisons left before exception, shared by the comparator copies
+    std::shared_ptr<std::atomic<long>> budget = std::make_shared<std::atomic<long>>(1L << 40);
+
+    bool operator()(const std::string& left, const std::string& right) const {
+        if (budget->fetch_sub(1) <= 0) {
+            throw std::runtime_error("comparison budget is exhausted");
+        }
+        return left < right;
+    }
+};
+
+TEST(TreesTest, OrderedSetAlgebraThrowingComparator) {
+    using throwing_set = nstd::ordered_set<std::string, throwing_less>;
+    std::vector<std::string> first;
+    std::vector<std::string> second;
+    for (int i = 0; i < 3000; ++i) {
+        first.push_back(std::to_string(1000000 + 2 * i));
+        second.push_back(std::to_string(1000000 + 3 * i));
+    }
+    auto apply = [](size_t op, throwing_set& st, throwing_set&& other, const nstd::set_operation_policy& policy) {
+        switch (op) {
+            case 0: st.set_union(std::move(other), policy); break;
+            case 1: st.set_intersection(std::move(other), policy); break;
+            case 2: st.set_difference(std::move(other), policy); break;
+            default: st.set_symmetric_difference(std::move(other), policy); break;
+        }
+    };
+    for (size_t op = 0; op < 4; ++op) {
+        for (nstd::set_operation_policy policy: {nstd::set_operation_policy{}, nstd::set_operation_policy{4, 16}}) {
+            for (long budget: {0L, 1L, 7L, 100L, 1000L, 5000L}) {
+                throwing_less comparator;
+                auto st = throwing_set::from_sorted(first.begin(), first.end(), comparator);
+                auto other = throwing_set::from_sorted(second.begin(), second.end(), comparator);
+                comparator.budget->store(budget);
+                EXPECT_THROW(apply(op, st, std::move(other), policy), std::runtime_error);
+                EXPECT_TRUE(st.empty());
+                EXPECT_EQ(st.begin(), st.end());
+                EXPECT_TRUE(other.empty());
+
+                // both trees stay usable
+                comparator.budget->store(1L << 40);
+                st.insert(second.begin(), second.end());
+                other.insert(first.begin(), first.end());
+                apply(op, st, std::move(other), policy);
+                EXPECT_EQ(static_cast<size_t>(std::distance(st.begin(), st.end())), st.size());
+                EXPECT_TRUE(std::is_sorted(st.begin(), st.end()));
+            }
+        }
+    }
+
+    throwing_less comparator;
+    auto st = throwing_set::from_sorted(first.begin(), first.end(), comparator);
+    const auto other = throwing_set::from_sorted(second.begin(), second.end(), comparator);
+    // exception while copying other tree keeps this tree unchanged
+    comparator.budget->store(100);
+    EXPECT_THROW(st.set_union(other), std::runtime_error);
+    comparator.budget->store(1L << 40);
+    EXPECT_EQ_WITH_CONTENT(st, first);
+    comparator.budget->store(static_cast<long>(second.size()) + 100);
+    EXPECT_THROW(st.set_union(other), std::runtime_error);
+    EXPECT_TRUE(st.empty());
+    comparator.budget->store(1L << 40);
+    EXPECT_EQ_WITH_CONTENT(other, second);
+}
+
 TEST(TreesTest, OrderedMap) {
     nstd::ordered_map<int, int> mp;
     for (int i = 0; i < 1000; ++i) {
@@ -99,6 +461,1463 @@ TEST(TreesTest, OrderedMap) {
     }
 }
 
+TEST(TreesTest, PersistentOrderedMap) {
+    std::mt19937 generator(19);
+    nstd::persistent_ordered_map<int, int> mp;
+    std::map<int, int> expected;
+    std::vector<std::pair<nstd::persistent_ordered_map<int, int>::snapshot_type, std::map<int, int>>> versions;
+    for (int i = 0; i < 3000; ++i) {
+        int key = static_cast<int>(generator() % 500);
+        switch (generator() % 3) {
+            case 0:
+                EXPECT_EQ(mp.insert({key, i}), expected.insert({key, i}).second);
+                break;
+            case 1:
+                EXPECT_EQ(mp.insert_or_assign(key, i), expected.count(key) == 0);
+                expected[key] = i;
+                break;
+            default:
+                EXPECT_EQ(mp.erase_key(key), expected.erase(key));
+        }
+        if (i % 300 == 0) {
+            versions.emplace_back(mp.snapshot(), expected);
+        }
+    }
+    versions.emplace_back(mp, expected);
+    mp.clear();
+    EXPECT_TRUE(mp.empty());
+    for (const auto& [snapshot, content]: versions) {
+        ASSERT_EQ(snapshot.size(), content.size());
+        EXPECT_TRUE(std::equal(snapshot.begin(), snapshot.end(), content.begin(), content.end()));
+        size_t order = 0;
+        for (const auto& [key, value]: content) {
+            EXPECT_EQ(snapshot.find(key)->second, value);
+            EXPECT_EQ(snapshot.order_of_key(key), order);
+            EXPECT_EQ(snapshot.key_of_order(order), key);
+            ++order;
+        }
+        EXPECT_EQ(snapshot.find(-1), snapshot.end());
+        EXPECT_EQ(snapshot.order_of_key(-1), snapshot.size());
+        if (!content.empty()) {
+            // iterators given by find continue iteration from the found key
+            auto middle = content.begin();
+            std::advance(middle, content.size() / 2);
+            EXPECT_TRUE(std::equal(snapshot.find(middle->first), snapshot.end(), middle, content.end()));
+            EXPECT_TRUE(std::equal(snapshot.upper_bound(middle->first), snapshot.end(), std::next(middle),
+                                   content.end()));
+        }
+    }
+
+    // readers keep consistent view, while the writer modifies the map
+    for (int i = 0; i < 1000; ++i) {
+        mp.insert({i, i});
+    }
+    auto snapshot = mp.snapshot();
+    std::thread reader([snapshot]() mutable {
+        for (int round = 0; round < 20; ++round) {
+            int expected_key = 0;
+            for (const auto& [key, value]: snapshot) {
+                EXPECT_EQ(key, expected_key++);
+                EXPECT_EQ(value, key);
+            }
+            EXPECT_EQ(expected_key, 1000);
+        }
+        snapshot = decltype(snapshot)();
+    });
+    for (int i = 0; i < 1000; ++i) {
+        mp.erase_key(i);
+        mp.insert_or_assign(i + 1000, -i);
+    }
+    reader.join();
+    EXPECT_EQ(snapshot.size(), 1000);
+    EXPECT_EQ(mp.size(), 1000);
+    EXPECT_EQ(mp.key_of_order(0), 1000);
+
+    // snapshots don't allocate, updates copy only the touched path
+    size_t allocations = 0;
+    using allocator_type = counting_allocator<std::pair<const int, int>>;
+    nstd::persistent_ordered_map<int, int, std::less<>, allocator_type> counted{std::less<>(),
+                                                                               allocator_type(&allocations)};
+    for (int i = 0; i < 100000; ++i) {
+        counted.insert({i, i});
+    }
+    allocations = 0;
+    auto counted_snapshot = counted.snapshot();
+    EXPECT_EQ(allocations, 0);
+    counted.insert_or_assign(50000, 0);
+    counted.erase_key(70000);
+    EXPECT_LT(allocations, 200);
+    EXPECT_EQ(counted_snapshot.find(50000)->second, 50000);
+    EXPECT_TRUE(counted_snapshot.contains(70000));
+}
+
+TEST(TreesTest, ConcurrentOrderedMap) {
+    // writer keeps the keys forming [first, last) interval, where each key is mapped to itself
+    nstd::concurrent_ordered_map<int, int> mp;
+    using guard_type = nstd::concurrent_ordered_map<int, int>::read_guard;
+    using snapshot_type = nstd::concurrent_ordered_map<int, int>::snapshot_type;
+    // guard doesn't own the pinned version, so it can't be turned into a snapshot without snapshot()
+    static_assert(!std::is_constructible_v<snapshot_type, guard_type&&>);
+    static_assert(!std::is_convertible_v<guard_type&, const snapshot_type&>);
+    std::atomic<bool> finished = false;
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; ++i) {
+        readers.emplace_back([&mp, &finished] {
+            auto reader = mp.make_reader();
+            nstd::concurrent_ordered_map<int, int>::snapshot_type snapshot;
+            while (!finished.load()) {
+                auto guard = reader.pin();
+                if (guard.empty()) {
+                    continue;
+                }
+                int first = guard.begin()->first;
+                int expected_key = first;
+                for (const auto& [key, value]: guard) {
+                    ASSERT_EQ(key, expected_key++);
+                    ASSERT_EQ(value, key);
+                }
+                ASSERT_EQ(expected_key - first, guard.size());
+                ASSERT_EQ(guard.order_of_key(expected_key - 1), guard.size() - 1);
+                ASSERT_EQ(guard.key_of_order(0), first);
+                ASSERT_TRUE(guard.contains(first));
+                ASSERT_FALSE(guard.contains(expected_key));
+                snapshot = guard.snapshot();
+            }
+            // snapshot stays valid after unpinning
+            if (!snapshot.empty()) {
+                EXPECT_EQ(snapshot.key_of_order(snapshot.size() - 1) - snapshot.key_of_order(0) + 1,
+                          snapshot.size());
+            }
+        });
+    }
+    int first = 0;
+    int last = 0;
+    for (int i = 0; i < 20000; ++i) {
+        if (last - first < 500 || i % 3 != 0) {
+            EXPECT_TRUE(mp.insert({last, last}));
+            ++last;
+        } else {
+            EXPECT_EQ(mp.erase_key(first++), 1);
+        }
+        EXPECT_FALSE(mp.insert_or_assign(first, first));
+    }
+    finished.store(true);
+    for (auto& reader: readers) {
+        reader.join();
+    }
+    EXPECT_EQ(mp.size(), last - first);
+    mp.reclaim();
+    auto reader = mp.make_reader();
+    EXPECT_EQ(reader.pin().key_of_order(0), first);
+}
+
+TEST(TreesTest, OrderedMapRangeAggregate) {
+    std::mt19937 generator(23);
+    nstd::ordered_map<int, long long, std::less<>, std::allocator<int>, nstd::sum_monoid<long long>> sums;
+    nstd::ordered_map<int, int, std::less<>, std::allocator<int>, nstd::min_monoid<int>> mins;
+    std::map<int, int> expected;
+    for (int i = 0; i < 5000; ++i) {
+        int key = static_cast<int>(generator() % 1000);
+        int value = static_cast<int>(generator() % 2001) - 1000;
+        switch (generator() % 4) {
+            case 0:
+                sums.erase_key(key);
+                mins.erase_key(key);
+                expected.erase(key);
+                break;
+            case 1: {
+                // modification through operator[] is followed by refresh
+                sums.insert_or_assign(key, 0);
+                sums[key] = value;
+                sums.refresh(sums.find(key));
+                mins.insert_or_assign(key, value);
+                expected[key] = value;
+                break;
+            }
+            default:
+                sums.insert_or_assign(key, value);
+                mins.insert_or_assign(key, value);
+                expected[key] = value;
+        }
+        if (i % 50 == 0) {
+            sums.erase_key_interval(key, key + 20);
+            mins.erase_key_interval(key, key + 20);
+            expected.erase(expected.lower_bound(key), expected.lower_bound(key + 20));
+        }
+        int begin_key = static_cast<int>(generator() % 1100) - 50;
+        int end_key = begin_key + static_cast<int>(generator() % 300);
+        long long expected_sum = 0;
+        int expected_min = std::numeric_limits<int>::max();
+        for (auto it = expected.lower_bound(begin_key); it != expected.end() && it->first < end_key; ++it) {
+            expected_sum += it->second;
+            expected_min = std::min(expected_min, it->second);
+        }
+        ASSERT_EQ(sums.range_aggregate(begin_key, end_key), expected_sum);
+        ASSERT_EQ(mins.range_aggregate(begin_key, end_key), expected_min);
+        auto end_it = expected.find(end_key);
+        ASSERT_EQ(sums.range_aggregate_with_end(begin_key, end_key),
+                  expected_sum + (end_it != expected.end() && begin_key <= end_key ? end_it->second : 0));
+    }
+    long long total = 0;
+    for (const auto& [key, value]: expected) {
+        total += value;
+    }
+    EXPECT_EQ(sums.aggregate(), total);
+    EXPECT_EQ(sums.size(), expected.size());
+}
+
+// polynomial hash of a sequence, its combine operation is not commutative, so aggregates must keep the order
+struct polynomial_hash {
+    static constexpr unsigned long long base = 131;
+
+    unsigned long long hash = 0;
+    unsigned long long power = 1;
+
+    polynomial_hash() = default;
+
+    explicit polynomial_hash(unsigned long long value) : hash(value), power(base) {}
+
+    bool operator==(const polynomial_hash& other) const { return hash == other.hash && power == other.power; }
+};
+
+struct polynomial_hash_monoid {
+    using value_type = polynomial_hash;
+
+    static value_type identity() { return {}; }
+
+    static value_type combine(const value_type& left, const value_type& right) {
+        value_type result;
+        result.hash = left.hash * right.power + right.hash;
+        result.power = left.power * right.power;
+        return result;
+    }
+};
+
+TEST(TreesTest, OrderedMapNonCommutativeAggregate) {
+    std::mt19937 generator(37);
+    std::vector<int> keys(40);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::shuffle(keys.begin(), keys.end(), generator);
+    nstd::ordered_map<int, int, std::less<>, std::allocator<int>, polynomial_hash_monoid> hashes;
+    for (int key: keys) {
+        hashes.insert({key, key * 7 + 1});
+    }
+    auto expected_hash = [](int begin_key, int end_key) {
+        polynomial_hash result;
+        for (int key = std::max(begin_key, 0); key < std::min(end_key, 40); ++key) {
+            result = polynomial_hash_monoid::combine(result, polynomial_hash(key * 7 + 1));
+        }
+        return result;
+    };
+    EXPECT_EQ(hashes.aggregate(), expected_hash(0, 40));
+    for (int begin_key = -1; begin_key <= 41; ++begin_key) {
+        for (int end_key = begin_key; end_key <= 41; ++end_key) {
+            ASSERT_EQ(hashes.range_aggregate(begin_key, end_key), expected_hash(begin_key, end_key));
+            ASSERT_EQ(hashes.range_aggregate_with_end(begin_key, end_key), expected_hash(begin_key, end_key + 1));
+        }
+    }
+}
+
+TEST(TreesTest, TreapPriorityGenerators) {
+    nstd::seeded_priority_generator<42> seeded1;
+    nstd::seeded_priority_generator<42> seeded2;
+    nstd::random_priority_generator random1;
+    nstd::random_priority_generator random2;
+    bool random_differ = false;
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(seeded1(), seeded2());
+        random_differ |= (random1() != random2());
+    }
+    EXPECT_TRUE(random_differ);
+
+    // containers filled from different threads own their generators
+    std::vector<nstd::ordered_map<int, int>> maps(4);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < maps.size(); ++t) {
+        threads.emplace_back([&map = maps[t], t]() {
+            for (int i = 0; i < 10000; ++i) {
+                map.insert({i * 7 % 10000, static_cast<int>(t)});
+            }
+        });
+    }
+    for (auto& thread: threads) {
+        thread.join();
+    }
+    for (const auto& map: maps) {
+        EXPECT_EQ(map.size(), 10000u);
+        int expected = 0;
+        for (const auto& [key, value]: map) {
+            EXPECT_EQ(key, expected++);
+        }
+    }
+
+    nstd::ordered_set<int, std::less<int>, std::allocator<int>, nstd::seeded_priority_generator<>> seeded_set{3, 1, 2};
+    EXPECT_EQ_WITH_CONTENT(seeded_set, (std::vector<int>{1, 2, 3}));
+    nstd::vector_tree<int, std::allocator<int>, void, nstd::seeded_priority_generator<>> seeded_vector{3, 1, 2};
+    EXPECT_EQ_WITH_CONTENT(seeded_vector, (std::vector<int>{3, 1, 2}));
+}
+
+TEST(TreesTest, NarrowTreapLayout) {
+    EXPECT_LT(sizeof(nstd::ordered_set_node<int, nstd::narrow_treap_layout>), sizeof(nstd::ordered_set_node<int>));
+    EXPECT_LT((sizeof(nstd::ordered_map_node<int, int, void, nstd::narrow_treap_layout>)),
+              (sizeof(nstd::ordered_map_node<int, int>)));
+
+    std::mt19937 generator(43);
+    nstd::ordered_set<int, std::less<int>, std::allocator<int>, nstd::random_priority_generator,
+            nstd::narrow_treap_layout> st;
+    nstd::ordered_map<int, int, std::less<int>, std::allocator<int>, nstd::sum_monoid<int>,
+            nstd::random_priority_generator, nstd::narrow_treap_layout> mp;
+    nstd::vector_tree<int, std::allocator<int>, nstd::range_sum_operations<int>, nstd::random_priority_generator,
+            nstd::narrow_treap_layout> vec;
+    std::map<int, int> expected;
+    std::vector<int> expected_vector;
+    for (int i = 0; i < 5000; ++i) {
+        int key = static_cast<int>(generator() % 2000);
+        if (generator() % 3 == 0) {
+            st.erase_key(key);
+            mp.erase_key(key);
+            expected.erase(key);
+        } else {
+            st.insert(key);
+            mp.insert_or_assign(key, i);
+            expected[key] = i;
+        }
+        size_t index = generator() % (expected_vector.size() + 1);
+        vec.insert(index, key);
+        expected_vector.insert(expected_vector.begin() + index, key);
+    }
+    ASSERT_EQ(st.size(), expected.size());
+    ASSERT_EQ(mp.size(), expected.size());
+    auto set_it = st.begin();
+    auto map_it = mp.begin();
+    int sum = 0;
+    for (const auto& [key, value]: expected) {
+        ASSERT_EQ(*set_it++, key);
+        ASSERT_EQ(map_it->first, key);
+        ASSERT_EQ(map_it->second, value);
+        ++map_it;
+        sum += value;
+    }
+    EXPECT_EQ(mp.aggregate(), sum);
+    EXPECT_EQ(st.order_of_key(expected.rbegin()->first), expected.size() - 1);
+    EXPECT_EQ_WITH_CONTENT(vec, expected_vector);
+    EXPECT_EQ(vec.aggregate(), std::accumulate(expected_vector.begin(), expected_vector.end(), 0));
+}
+
+TEST(TreesTest, OrderedMapBatchLookups) {
+    std::mt19937 generator(44);
+    nstd::ordered_map<int, int> mp;
+    for (int i = 0; i < 3000; ++i) {
+        int key = static_cast<int>(generator() % 10000);
+        mp.insert({key, i});
+    }
+    const auto& cmp = mp;
+    for (size_t batch: {0, 1, 10, 1000, 20000}) {
+        std::vector<int> keys(batch);
+        for (int& key: keys) {
+            key = static_cast<int>(generator() % 10010) - 5;
+        }
+        std::sort(keys.begin(), keys.end());
+
+        std::vector<decltype(mp.begin())> found;
+        std::vector<decltype(cmp.begin())> const_found;
+        std::vector<decltype(mp.begin())> bounds;
+        std::vector<decltype(cmp.begin())> const_bounds;
+        std::vector<bool> contained;
+        std::vector<size_t> orders;
+        mp.find_many(keys.begin(), keys.end(), std::back_inserter(found));
+        cmp.find_many(keys.begin(), keys.end(), std::back_inserter(const_found));
+        mp.lower_bound_many(keys.begin(), keys.end(), std::back_inserter(bounds));
+        cmp.lower_bound_many(keys.begin(), keys.end(), std::back_inserter(const_bounds));
+        cmp.contains_many(keys.begin(), keys.end(), std::back_inserter(contained));
+        cmp.order_of_keys(keys.begin(), keys.end(), std::back_inserter(orders));
+        ASSERT_EQ(found.size(), batch);
+        ASSERT_EQ(const_found.size(), batch);
+        ASSERT_EQ(bounds.size(), batch);
+        ASSERT_EQ(const_bounds.size(), batch);
+        ASSERT_EQ(contained.size(), batch);
+        ASSERT_EQ(orders.size(), batch);
+        for (size_t i = 0; i < batch; ++i) {
+            EXPECT_EQ(found[i], mp.find(keys[i]));
+            EXPECT_EQ(const_found[i], cmp.find(keys[i]));
+            EXPECT_EQ(bounds[i], mp.lower_bound(keys[i]));
+            EXPECT_EQ(const_bounds[i], cmp.lower_bound(keys[i]));
+            EXPECT_EQ(contained[i], mp.contains(keys[i]));
+            EXPECT_EQ(orders[i], mp.order_of_key(keys[i]));
+        }
+
+        std::shuffle(keys.begin(), keys.end(), generator);
+        found.clear();
+        const_found.clear();
+        mp.find_batch(keys.begin(), keys.end(), std::back_inserter(found));
+        cmp.find_batch(keys.begin(), keys.end(), std::back_inserter(const_found));
+        ASSERT_EQ(found.size(), batch);
+        ASSERT_EQ(const_found.size(), batch);
+        for (size_t i = 0; i < batch; ++i) {
+            EXPECT_EQ(found[i], mp.find(keys[i]));
+            EXPECT_EQ(const_found[i], cmp.find(keys[i]));
+        }
+    }
+
+    nstd::ordered_set<int> empty;
+    std::vector<int> keys{1, 2, 2, 3};
+    std::vector<size_t> orders;
+    empty.order_of_keys(keys.begin(), keys.end(), std::back_inserter(orders));
+    EXPECT_EQ(orders, (std::vector<size_t>(4, 0)));
+    std::vector<bool> contained(4, true);
+    empty.contains_many(keys.begin(), keys.end(), contained.begin());
+    EXPECT_EQ(contained, (std::vector<bool>(4, false)));
+    std::vector<nstd::ordered_set<int>::iterator> found;
+    empty.find_batch(keys.begin(), keys.end(), std::back_inserter(found));
+    EXPECT_EQ(found, (std::vector<nstd::ordered_set<int>::iterator>(4, empty.end())));
+}
+
+TEST(TreesTest, TreapSerialization) {
+    nstd::ordered_map<int, std::string> mp;
+    for (int i = 0; i < 1000; ++i) {
+        mp.insert({i * 37 % 1000, std::string(static_cast<size_t>(i % 13), static_cast<char>('a' + i % 26))});
+    }
+    for (bool with_priorities: {false, true}) {
+        std::stringstream stream;
+        mp.save(stream, with_priorities);
+        nstd::ordered_map<int, std::string> loaded{{-1, "old"}};
+        loaded.load(stream);
+        EXPECT_EQ_WITH_CONTENT(loaded, mp);
+        EXPECT_EQ(loaded.order_of_key(500), 500u);
+        loaded.insert({1000, "new"});
+        EXPECT_EQ(loaded.size(), 1001u);
+    }
+
+    nstd::ordered_set<int> st{5, 3, 8, 1};
+    std::stringstream set_stream;
+    st.save(set_stream, true);
+    nstd::ordered_set<int> loaded_set;
+    loaded_set.load(set_stream);
+    EXPECT_EQ_WITH_CONTENT(loaded_set, (std::vector<int>{1, 3, 5, 8}));
+
+    nstd::ordered_set<int> empty;
+    std::stringstream empty_stream;
+    empty.save(empty_stream);
+    loaded_set.load(empty_stream);
+    EXPECT_TRUE(loaded_set.empty());
+    EXPECT_EQ(loaded_set.begin(), loaded_set.end());
+
+    nstd::vector_tree<int, std::allocator<int>, nstd::range_sum_operations<int>> vec{1, 2, 3, 4, 5, 6};
+    vec.reverse_interval(1, 5);
+    vec.add_interval(0, 3, 10);
+    std::stringstream vector_stream;
+    vec.save(vector_stream, true);
+    nstd::vector_tree<int, std::allocator<int>, nstd::range_sum_operations<int>> loaded_vector;
+    loaded_vector.load(vector_stream);
+    EXPECT_EQ_WITH_CONTENT(loaded_vector, (std::vector<int>{11, 15, 14, 3, 2, 6}));
+    EXPECT_EQ(loaded_vector.aggregate_interval(0, 6), 51);
+
+    // invalid data leaves the container unchanged
+    std::stringstream unsorted_stream;
+    nstd::vector_tree<int>{3, 1, 2}.save(unsorted_stream);
+    EXPECT_THROW(loaded_set.load(unsorted_stream), nstd::serialization_error);
+    std::string data;
+    {
+        std::stringstream stream;
+        st.save(stream);
+        data = stream.str();
+    }
+    std::stringstream truncated_stream(data.substr(0, data.size() - 1));
+    loaded_set = st;
+    EXPECT_THROW(loaded_set.load(truncated_stream), nstd::serialization_error);
+    std::stringstream garbage_stream(std::string(64, 'x'));
+    EXPECT_THROW(loaded_set.load(garbage_stream), nstd::serialization_error);
+    EXPECT_EQ_WITH_CONTENT(loaded_set, st);
+}
+
+struct counted_key {
+    static inline size_t constructions = 0;
+
+    int value;
+
+    explicit counted_key(int value) : value(value) { ++constructions; }
+
+    counted_key(const counted_key& other) : value(other.value) { ++constructions; }
+};
+
+struct counted_key_less {
+    using is_transparent = void;
+
+    bool operator()(const counted_key& lhs, const counted_key& rhs) const { return lhs.value < rhs.value; }
+
+    bool operator()(const counted_key& lhs, int rhs) const { return lhs.value < rhs; }
+
+    bool operator()(int lhs, const counted_key& rhs) const { return lhs < rhs.value; }
+};
+
+TEST(TreesTest, TransparentComparatorLookups) {
+    nstd::ordered_map<std::string, int, std::less<>> mp{{"apple", 1}, {"banana", 2}, {"cherry", 3}};
+    std::string_view view = "banana";
+    EXPECT_TRUE(mp.contains(view));
+    EXPECT_FALSE(mp.contains("durian"));
+    EXPECT_EQ(mp.find(view)->second, 2);
+    EXPECT_EQ(std::as_const(mp).find("cherry")->second, 3);
+    EXPECT_EQ(mp.find("blueberry"), mp.end());
+    EXPECT_EQ(mp.lower_bound("b")->first, "banana");
+    EXPECT_EQ(std::as_const(mp).upper_bound(view)->first, "cherry");
+    EXPECT_EQ(mp.order_of_key("cherry"), 2u);
+    EXPECT_EQ(mp.order_of_key("durian"), mp.size());
+    EXPECT_EQ(mp.erase_key(view)->first, "cherry");
+    EXPECT_EQ_WITH_CONTENT(mp, (std::vector<std::pair<const std::string, int>>{{"apple", 1}, {"cherry", 3}}));
+
+    nstd::ordered_set<counted_key, counted_key_less> st;
+    for (int i = 0; i < 100; i += 2) {
+        st.emplace(i);
+    }
+    size_t constructions = counted_key::constructions;
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(st.contains(i), i % 2 == 0);
+        EXPECT_EQ(st.find(i) != st.end(), i % 2 == 0);
+        if (i < 98) {
+            EXPECT_EQ(st.lower_bound(i)->value, i + i % 2);
+        }
+        EXPECT_EQ(st.order_of_key(i), (i % 2 == 0 ? static_cast<size_t>(i / 2) : st.size()));
+    }
+    EXPECT_EQ(st.upper_bound(98), st.end());
+    EXPECT_EQ(st.erase_key(50)->value, 52);
+    EXPECT_FALSE(st.contains(50));
+    EXPECT_EQ(counted_key::constructions, constructions);
+}
+
+TEST(TreesTest, TreapNodeHandles) {
+    using map_type = nstd::ordered_map<int, std::unique_ptr<int>>;
+    map_type hot;
+    map_type::node_type handle;
+    {
+        map_type cold;
+        for (int i = 0; i < 100; ++i) {
+            cold.insert({i, std::make_unique<int>(i * 10)});
+        }
+        const int* address = cold.find(42)->second.get();
+        handle = cold.extract(42);
+        EXPECT_FALSE(cold.contains(42));
+        EXPECT_EQ(cold.size(), 99u);
+        ASSERT_FALSE(handle.empty());
+        EXPECT_EQ(handle.key(), 42);
+        EXPECT_EQ(handle.mapped().get(), address);
+        EXPECT_TRUE(cold.extract(42).empty());
+
+        auto first = cold.extract(cold.begin());
+        EXPECT_EQ(first.key(), 0);
+        EXPECT_EQ(cold.begin()->first, 1);
+        auto result = hot.insert(std::move(first));
+        EXPECT_TRUE(result.inserted);
+        EXPECT_TRUE(result.node.empty());
+        EXPECT_EQ(result.position, hot.begin());
+
+        hot.insert({5, std::make_unique<int>(-5)});
+        hot.merge(cold);
+        EXPECT_EQ(hot.size(), 99u);
+        ASSERT_EQ(cold.size(), 1u);
+        EXPECT_EQ(cold.begin()->first, 5);
+        EXPECT_EQ(*cold.begin()->second, 50);
+        EXPECT_EQ(*hot.find(5)->second, -5);
+    }
+    // the cold map is destroyed, the handle and moved nodes keep their memory
+    auto result = hot.insert(std::move(handle));
+    EXPECT_TRUE(result.inserted);
+    EXPECT_EQ(*result.position->second, 420);
+    ASSERT_EQ(hot.size(), 100u);
+    int expected = 0;
+    for (const auto& [key, value]: hot) {
+        EXPECT_EQ(key, expected);
+        EXPECT_EQ(*value, key == 5 ? -5 : key * 10);
+        ++expected;
+    }
+    auto duplicate = hot.extract(7);
+    hot.insert({7, std::make_unique<int>(7)});
+    result = hot.insert(std::move(duplicate));
+    EXPECT_FALSE(result.inserted);
+    EXPECT_EQ(*result.position->second, 7);
+    EXPECT_EQ(*result.node.mapped(), 70);
+    hot.erase_key_interval(10, 90);
+    EXPECT_EQ(hot.size(), 20u);
+
+    // nodes are moved between trees sharing the allocator without node allocations
+    size_t allocations = 0;
+    using counted_set = nstd::ordered_set<int, std::less<>, counting_allocator<int>>;
+    counted_set st1(std::less<>(), counting_allocator<int>{&allocations});
+    counted_set st2(std::less<>(), counting_allocator<int>{&allocations});
+    for (int i = 0; i < 1000; ++i) {
+        st1.insert(i);
+    }
+    size_t filled = allocations;
+    for (int round = 0; round < 3; ++round) {
+        while (!st1.empty()) {
+            st2.insert(st1.extract(st1.begin()));
+        }
+        st1.merge(st2);
+        EXPECT_TRUE(st2.empty());
+        EXPECT_EQ(st1.size(), 1000u);
+    }
+    EXPECT_EQ(allocations, filled);
+    // nodes of dropped handles are reused
+    for (int round = 0; round < 100000; ++round) {
+        int key = round % 1000;
+        EXPECT_FALSE(st1.extract(key).empty());
+        st1.insert(key);
+    }
+    EXPECT_LE(allocations, filled + 1);
+    EXPECT_EQ(st1.size(), 1000u);
+    st2.insert(2000);
+    st2.set_union(std::move(st1));
+    EXPECT_EQ(st2.size(), 1001u);
+    EXPECT_EQ(*st2.rbegin(), 2000);
+
+    // trees with different allocators copy moved values into their own nodes
+    size_t other_allocations = 0;
+    counted_set st3(std::less<>(), counting_allocator<int>{&other_allocations});
+    auto moved = st3.insert(st2.extract(500));
+    EXPECT_TRUE(moved.inserted);
+    EXPECT_EQ(*moved.position, 500);
+    EXPECT_EQ(other_allocations, 1u);
+    EXPECT_FALSE(st2.contains(500));
+}
+
+TEST(TreesTest, TreapNodeHandlesAcrossThreads) {
+    // containers, which have exchanged nodes, share the chunks group and still may be used by different threads
+    nstd::ordered_set<int> hot;
+    nstd::ordered_set<int> cold;
+    for (int i = 0; i < 1000; ++i) {
+        hot.insert(i);
+        cold.insert(i + 1000);
+    }
+    cold.insert(hot.extract(0));
+    auto churn = [](nstd::ordered_set<int>& st, int first) {
+        for (int round = 0; round < 20000; ++round) {
+            int key = first + round % 999 + 1;
+            st.insert(st.extract(key));
+            // dropped handles return their nodes to the shared group
+            EXPECT_FALSE(st.extract(key).empty());
+            st.insert(key);
+        }
+    };
+    std::thread hot_thread(churn, std::ref(hot), 0);
+    std::thread cold_thread(churn, std::ref(cold), 1000);
+    hot_thread.join();
+    cold_thread.join();
+    EXPECT_EQ(hot.size(), 999u);
+    EXPECT_EQ(cold.size(), 1001u);
+    EXPECT_EQ(*hot.begin(), 1);
+    EXPECT_EQ(*cold.begin(), 0);
+}
+
+struct counted_value {
+    static inline size_t constructions = 0;
+
+    int value;
+
+    explicit counted_value(int value = 0) : value(value) { ++constructions; }
+
+    counted_value(const counted_value& other) : value(other.value) { ++constructions; }
+
+    counted_value& operator=(const counted_value& other) = default;
+};
+
+TEST(TreesTest, OrderedMapSingleDescentInsertion) {
+    nstd::ordered_map<int, counted_value> values;
+    EXPECT_TRUE(values.try_emplace(1, 10).second);
+    size_t constructions = counted_value::constructions;
+    auto [it, inserted] = values.try_emplace(1, 20);
+    EXPECT_FALSE(inserted);
+    EXPECT_EQ(it->second.value, 10);
+    EXPECT_EQ(counted_value::constructions, constructions);
+    values[2].value = 5;
+    EXPECT_EQ(values[2].value, 5);
+    EXPECT_EQ(values.size(), 2u);
+    EXPECT_FALSE(values.insert_or_assign(2, counted_value(7)).second);
+    EXPECT_EQ(values[2].value, 7);
+
+    std::string long_key(100, 'k');
+    nstd::ordered_map<std::string, std::unique_ptr<int>> owners;
+    auto owner = std::make_unique<int>(1);
+    EXPECT_TRUE(owners.try_emplace(std::move(long_key), std::move(owner)).second);
+    EXPECT_EQ(owner, nullptr);
+    owner = std::make_unique<int>(2);
+    EXPECT_FALSE(owners.try_emplace(std::string(100, 'k'), std::move(owner)).second);
+    EXPECT_NE(owner, nullptr);
+    EXPECT_TRUE(owners.insert_or_assign("a", std::move(owner)).second);
+    EXPECT_EQ(*owners.begin()->second, 2);
+
+    // random operations keep the tree consistent with std::map, including sizes and aggregates
+    std::mt19937 generator(45);
+    nstd::ordered_map<int, long long, std::less<int>, std::allocator<int>, nstd::sum_monoid<long long>> sums;
+    std::map<int, long long> expected;
+    for (int i = 0; i < 20000; ++i) {
+        int key = static_cast<int>(generator() % 3000);
+        long long value = static_cast<long long>(generator() % 100);
+        switch (generator() % 6) {
+            case 0:
+                EXPECT_EQ(sums.try_emplace(key, value).second, expected.try_emplace(key, value).second);
+                break;
+            case 1:
+                EXPECT_EQ(sums.insert_or_assign(key, value).second, expected.insert_or_assign(key, value).second);
+                break;
+            case 2:
+                sums[key] += value;
+                sums.refresh(sums.find(key));
+                expected[key] += value;
+                break;
+            case 3: {
+                // correct hint
+                auto hint = sums.lower_bound(key);
+                auto result = sums.emplace_hint(hint, key, value);
+                EXPECT_EQ(result->first, key);
+                expected.emplace(key, value);
+                break;
+            }
+            case 4: {
+                // arbitrary hint
+                auto hint = (sums.empty() ? sums.end() : sums.begin() + static_cast<long>(generator() % sums.size()));
+                EXPECT_EQ(sums.emplace_hint(hint, key, value)->first, key);
+                expected.emplace(key, value);
+                break;
+            }
+            default:
+                sums.erase_key(key);
+                expected.erase(key);
+        }
+    }
+    ASSERT_EQ(sums.size(), expected.size());
+    EXPECT_EQ_WITH_CONTENT(sums, expected);
+    size_t order = 0;
+    long long total = 0;
+    for (const auto& [key, value]: expected) {
+        EXPECT_EQ(sums.order_of_key(key), order++);
+        total += value;
+    }
+    EXPECT_EQ(sums.range_aggregate(-1, 3000), total);
+    auto last = sums.end();
+    for (auto rit = expected.rbegin(); rit != expected.rend(); ++rit) {
+        --last;
+        EXPECT_EQ(last->first, rit->first);
+    }
+
+    nstd::ordered_set<int> st;
+    for (int i = 0; i < 100; ++i) {
+        st.emplace_hint(st.end(), i);
+    }
+    for (int i = -1; i > -100; --i) {
+        EXPECT_EQ(*st.emplace_hint(st.begin(), i), i);
+    }
+    EXPECT_EQ(*st.emplace_hint(st.begin(), 50), 50);
+    EXPECT_EQ(st.size(), 199u);
+    EXPECT_EQ(*st.begin(), -99);
+    EXPECT_TRUE(std::is_sorted(st.begin(), st.end()));
+}
+
+struct live_value {
+    static inline long long live = 0;
+
+    int value;
+
+    live_value(int value = 0) : value(value) { ++live; }
+
+    live_value(const live_value& other) : value(other.value) { ++live; }
+
+    live_value& operator=(const live_value& other) = default;
+
+    ~live_value() { --live; }
+};
+
+TEST(TreesTest, TreapDeferredDestruction) {
+    {
+        nstd::ordered_map<int, live_value> values;
+        values.set_reclaim_step(4);
+        for (int i = 0; i < 1000; ++i) {
+            values.emplace(i, i);
+        }
+        auto it = values.erase_key_interval(100, 900);
+        EXPECT_EQ(it->first, 900);
+        EXPECT_EQ(values.size(), 200u);
+        // only the step is destroyed by the erasure itself
+        EXPECT_EQ(values.retired_size(), 796u);
+        EXPECT_EQ(live_value::live, 996);
+        // each insertion destroys the next step
+        values.emplace(5000, 5000);
+        EXPECT_EQ(values.retired_size(), 792u);
+        values.erase_key(0);
+        EXPECT_EQ(values.retired_size(), 789u);
+        EXPECT_EQ(values.reclaim(89), 700u);
+        EXPECT_EQ(live_value::live, 200 + 700);
+        values.erase_interval(0, 50);
+        EXPECT_EQ(values.begin()->first, 51);
+        EXPECT_EQ(values.retired_size(), 746u);
+        EXPECT_EQ(values.size() + values.retired_size(), static_cast<size_t>(live_value::live));
+
+        // retired nodes go with the memory to the container stealing the nodes
+        nstd::ordered_map<int, live_value> others;
+        others.emplace(-1, -1);
+        others.set_union(std::move(values));
+        EXPECT_EQ(others.size(), 151u);
+        EXPECT_EQ(others.retired_size(), 0u);
+        EXPECT_EQ(live_value::live, 151);
+
+        others.set_reclaim_step(1);
+        others.clear();
+        EXPECT_TRUE(others.empty());
+        EXPECT_EQ(others.retired_size(), 150u);
+        others.emplace(1, 1);
+        EXPECT_EQ(others[1].value, 1);
+        EXPECT_EQ(others.retired_size(), 149u);
+
+        // the container destroys its retired nodes as well
+        values.set_reclaim_step(16);
+        for (int i = 0; i < 1000; ++i) {
+            values.emplace(i, i);
+        }
+        values.erase_key_interval(0, 1000);
+        nstd::ordered_map<int, live_value> moved(std::move(values));
+        EXPECT_EQ(moved.retired_size(), 984u);
+        EXPECT_EQ(moved.reclaim_step(), 16u);
+        moved.swap(others);
+        EXPECT_EQ(others.retired_size(), 984u);
+        EXPECT_EQ(moved.retired_size(), 149u);
+        moved.set_reclaim_step(0);
+        EXPECT_EQ(moved.retired_size(), 0u);
+        EXPECT_EQ(live_value::live, 1 + 984);
+    }
+    EXPECT_EQ(live_value::live, 0);
+
+    nstd::vector_tree<int> vector;
+    vector.set_reclaim_step(2);
+    for (int i = 0; i < 100; ++i) {
+        vector.push_back(i);
+    }
+    vector.erase_interval(10, 90);
+    EXPECT_EQ(vector.retired_size(), 78u);
+    EXPECT_EQ(vector.size(), 20u);
+    EXPECT_EQ(vector[10], 90);
+    for (int i = 0; i < 50; ++i) {
+        vector.push_back(i);
+    }
+    EXPECT_EQ(vector.retired_size(), 0u);
+    EXPECT_EQ(vector.size(), 70u);
+    EXPECT_EQ(vector[69], 49);
+}
+
+TEST(TreesTest, OrderedMultisetAndMultimap) {
+    nstd::ordered_multiset<int> samples {5, 1, 5, 3, 5, 1};
+    EXPECT_EQ(samples.size(), 6u);
+    EXPECT_EQ(samples.count(5), 3u);
+    EXPECT_EQ(samples.count(2), 0u);
+    EXPECT_EQ(samples.order_of_key(5), 3u);
+    EXPECT_EQ(samples.order_of_key(4), samples.size());
+    EXPECT_EQ(samples.key_of_order(2), 3);
+    auto [first, last] = samples.equal_range(1);
+    EXPECT_EQ(std::distance(first, last), 2);
+    EXPECT_EQ(*samples.erase_one(5), 5);
+    EXPECT_EQ(samples.count(5), 2u);
+    EXPECT_EQ(samples.erase_key(1), 2u);
+    EXPECT_EQ(samples.erase_key(1), 0u);
+    EXPECT_EQ(samples.erase_one(4), samples.lower_bound(4));
+    EXPECT_EQ(std::vector<int>(samples.begin(), samples.end()), std::vector<int>({3, 5, 5}));
+
+    // values of equal keys keep the insertion order
+    nstd::ordered_multimap<int, std::string> scores {{2, "b"}, {1, "a"}, {2, "c"}};
+    scores.emplace(2, "d");
+    scores.insert({1, "e"});
+    auto [begin, end] = scores.equal_range(2);
+    std::vector<std::string> names;
+    for (auto it = begin; it != end; ++it) {
+        names.push_back(it->second);
+    }
+    EXPECT_EQ(names, std::vector<std::string>({"b", "c", "d"}));
+    EXPECT_EQ(scores.find(1)->second, "a");
+    EXPECT_EQ(scores.erase_one(1)->second, "e");
+    EXPECT_EQ(scores.order_of_key(2), 1u);
+    auto copied = scores;
+    EXPECT_EQ_WITH_CONTENT(copied, scores);
+    std::stringstream stream;
+    scores.save(stream);
+    nstd::ordered_multimap<int, std::string> loaded;
+    loaded.load(stream);
+    EXPECT_EQ_WITH_CONTENT(loaded, scores);
+
+    std::vector<int> range {1, 1, 2, 0, 2};
+    auto sorted = nstd::ordered_multiset<int>::from_sorted(range.begin(), range.end());
+    EXPECT_EQ(std::vector<int>(sorted.begin(), sorted.end()), std::vector<int>({1, 1, 2, 2}));
+
+    // random operations keep the tree consistent with std::multimap
+    std::mt19937 generator(46);
+    nstd::ordered_multimap<int, int> values;
+    std::multimap<int, int> expected;
+    for (int i = 0; i < 20000; ++i) {
+        int key = static_cast<int>(generator() % 200);
+        switch (generator() % 7) {
+            case 0:
+            case 1:
+            case 2:
+                values.emplace(key, i);
+                expected.emplace(key, i);
+                break;
+            case 3: {
+                auto erased = values.erase_one(key);
+                auto it = expected.lower_bound(key);
+                if (it != expected.end() && it->first == key) {
+                    it = expected.erase(it);
+                }
+                EXPECT_EQ(erased == values.end(), it == expected.end());
+                break;
+            }
+            case 4:
+                EXPECT_EQ(values.erase_key(key), expected.erase(key));
+                break;
+            case 5: {
+                auto [vbegin, vend] = values.equal_range(key);
+                auto [ebegin, eend] = expected.equal_range(key);
+                EXPECT_TRUE(std::equal(vbegin, vend, ebegin, eend));
+                EXPECT_EQ(values.count(key), expected.count(key));
+                break;
+            }
+            default: {
+                int end_key = key + static_cast<int>(generator() % 10);
+                values.erase_key_interval(key, end_key);
+                expected.erase(expected.lower_bound(key), expected.lower_bound(end_key));
+            }
+        }
+    }
+    ASSERT_EQ(values.size(), expected.size());
+    EXPECT_EQ_WITH_CONTENT(values, expected);
+    size_t order = 0;
+    for (auto it = expected.begin(); it != expected.end(); ++order, ++it) {
+        EXPECT_EQ(values.key_of_order(order), it->first);
+        if (it == expected.begin() || std::prev(it)->first != it->first) {
+            EXPECT_EQ(values.order_of_key(it->first), order);
+        }
+    }
+    auto reverse = values.end();
+    for (auto rit = expected.rbegin(); rit != expected.rend(); ++rit) {
+        --reverse;
+        EXPECT_EQ(*reverse, *rit);
+    }
+}
+
+TEST(TreesTest, BtreeSetAndMap) {
+    nstd::btree_set<int> keys {5, 1, 4, 1, 3};
+    EXPECT_EQ(keys.size(), 4u);
+    EXPECT_EQ(keys.order_of_key(4), 2u);
+    EXPECT_EQ(keys.order_of_key(2), keys.size());
+    EXPECT_EQ(keys.key_of_order(3), 5);
+    EXPECT_THROW(keys.key_of_order(4), std::out_of_range);
+    EXPECT_EQ(*keys.lower_bound(2), 3);
+    EXPECT_EQ(keys.upper_bound(5), keys.end());
+    EXPECT_EQ(*keys.erase_key(3), 4);
+    EXPECT_EQ(std::vector<int>(keys.rbegin(), keys.rend()), std::vector<int>({5, 4, 1}));
+
+    nstd::btree_map<std::string, int> words {{"b", 2}, {"a", 1}};
+    words["c"] = 3;
+    EXPECT_FALSE(words.try_emplace("a", 10).second);
+    EXPECT_FALSE(words.insert_or_assign("b", 20).second);
+    EXPECT_EQ(words.find("b")->second, 20);
+    EXPECT_FALSE(words.contains("d"));
+    auto copied = words;
+    EXPECT_EQ_WITH_CONTENT(copied, words);
+    auto moved = std::move(copied);
+    EXPECT_TRUE(copied.empty());
+    EXPECT_EQ_WITH_CONTENT(moved, words);
+
+    // sequential keys fill the leaves, sorted ranges are appended
+    std::vector<int> range(10000);
+    std::iota(range.begin(), range.end(), 0);
+    auto sorted = nstd::btree_set<int>::from_sorted(range.begin(), range.end());
+    EXPECT_TRUE(std::equal(sorted.begin(), sorted.end(), range.begin(), range.end()));
+    EXPECT_EQ(*sorted.erase_interval(100, 9900), 9900);
+    EXPECT_EQ(sorted.size(), 200u);
+    EXPECT_EQ(sorted.key_of_order(100), 9900);
+
+    // random operations keep the tree consistent with std::map
+    std::mt19937 generator(47);
+    nstd::btree_map<int, int> values;
+    std::map<int, int> expected;
+    for (int i = 0; i < 50000; ++i) {
+        int key = static_cast<int>(generator() % 5000);
+        switch (generator() % 7) {
+            case 0:
+            case 1:
+            case 2:
+                EXPECT_EQ(values.insert({key, i}).second, expected.insert({key, i}).second);
+                break;
+            case 3:
+                values.erase_key(key);
+                expected.erase(key);
+                break;
+            case 4: {
+                auto it = expected.find(key);
+                size_t order = (it == expected.end() ? expected.size() : std::distance(expected.begin(), it));
+                EXPECT_EQ(values.order_of_key(key), order);
+                break;
+            }
+            case 5: {
+                int end_key = key + static_cast<int>(generator() % 100);
+                values.erase_key_interval(key, end_key);
+                expected.erase(expected.lower_bound(key), expected.lower_bound(end_key));
+                break;
+            }
+            default:
+                if (!expected.empty()) {
+                    size_t begin = generator() % expected.size();
+                    size_t end = std::min(begin + generator() % 100, expected.size());
+                    values.erase_interval(begin, end);
+                    expected.erase(std::next(expected.begin(), begin), std::next(expected.begin(), end));
+                }
+        }
+    }
+    ASSERT_EQ(values.size(), expected.size());
+    EXPECT_EQ_WITH_CONTENT(values, expected);
+    size_t order = 0;
+    for (auto it = expected.begin(); it != expected.end(); ++order, ++it) {
+        EXPECT_EQ(values.key_of_order(order), it->first);
+    }
+    auto reverse = values.rbegin();
+    for (auto rit = expected.rbegin(); rit != expected.rend(); ++rit, ++reverse) {
+        EXPECT_EQ(*reverse, *rit);
+    }
+}
+
+TEST(TreesTest, BtreeErasureKeepsLeavesLinked) {
+    // large keys give the smallest nodes, so erasures restructure the tree often
+    using wide_key = std::array<long, 16>;
+    std::mt19937 generator(3);
+    nstd::btree_set<wide_key> wide;
+    nstd::btree_set<std::string> words;
+    std::set<wide_key> expected_wide;
+    std::set<std::string> expected_words;
+    auto make_key = [](long value) {
+        wide_key key {};
+        key[0] = value;
+        return key;
+    };
+    for (int step = 0; step < 6000; ++step) {
+        long value = static_cast<long>(generator() % 300);
+        long end_value = value + static_cast<long>(generator() % 40);
+        std::string word = std::to_string(value);
+        // decimal strings are ordered lexicographically
+        std::string end_word = std::max(word, std::to_string(end_value));
+        switch (generator() % 5) {
+            case 0:
+                wide.erase_key(make_key(value));
+                expected_wide.erase(make_key(value));
+                words.erase_key(word);
+                expected_words.erase(word);
+                break;
+            case 1:
+                wide.erase_key_interval(make_key(value), make_key(end_value));
+                expected_wide.erase(expected_wide.lower_bound(make_key(value)),
+                                    expected_wide.lower_bound(make_key(end_value)));
+                words.erase_key_interval(word, end_word);
+                expected_words.erase(expected_words.lower_bound(word), expected_words.lower_bound(end_word));
+                break;
+            default:
+                wide.insert(make_key(value));
+                expected_wide.insert(make_key(value));
+                words.insert(word);
+                expected_words.insert(word);
+        }
+        ASSERT_EQ(wide.size(), expected_wide.size());
+        ASSERT_TRUE(std::equal(wide.begin(), wide.end(), expected_wide.begin(), expected_wide.end()));
+        ASSERT_TRUE(std::equal(wide.rbegin(), wide.rend(), expected_wide.rbegin(), expected_wide.rend()));
+        ASSERT_TRUE(std::equal(words.begin(), words.end(), expected_words.begin(), expected_words.end()));
+        if (!expected_wide.empty()) {
+            ASSERT_EQ(wide.key_of_order(expected_wide.size() - 1), *expected_wide.rbegin());
+        }
+    }
+}
+
+TEST(TreesTest, TreapFingerSearch) {
+    nstd::ordered_set<int> empty;
+    EXPECT_EQ(empty.lower_bound(empty.end(), 1), empty.end());
+    EXPECT_EQ(empty.order_of_key(empty.end(), 1), 0u);
+
+    // hinted lookups give the same results as plain ones for any hint
+    std::mt19937 generator(48);
+    nstd::ordered_set<int> keys;
+    nstd::ordered_multiset<int> samples;
+    for (int i = 0; i < 2000; ++i) {
+        keys.insert(static_cast<int>(generator() % 4000));
+        samples.insert(static_cast<int>(generator() % 500));
+    }
+    for (int i = 0; i < 5000; ++i) {
+        int key = static_cast<int>(generator() % 4100) - 50;
+        auto hint = (i % 10 == 0 ? keys.end() : keys.begin() + generator() % keys.size());
+        EXPECT_EQ(keys.lower_bound(hint, key), keys.lower_bound(key));
+        EXPECT_EQ(keys.upper_bound(hint, key), keys.upper_bound(key));
+        EXPECT_EQ(keys.find(hint, key), keys.find(key));
+        EXPECT_EQ(keys.order_of_key(hint, key), keys.order_of_key(key));
+
+        int sample = key / 8;
+        auto sample_hint = (i % 10 == 0 ? samples.end() : samples.begin() + generator() % samples.size());
+        EXPECT_EQ(samples.lower_bound(sample_hint, sample), samples.lower_bound(sample));
+        EXPECT_EQ(samples.upper_bound(sample_hint, sample), samples.upper_bound(sample));
+        EXPECT_EQ(samples.find(sample_hint, sample), samples.find(sample));
+        EXPECT_EQ(samples.order_of_key(sample_hint, sample), samples.order_of_key(sample));
+    }
+
+    // merge join of the sorted keys, each lookup starts from the previous result
+    const nstd::ordered_map<int, int> map {{1, 10}, {3, 30}, {5, 50}, {7, 70}};
+    std::vector<int> joined;
+    auto hint = map.begin();
+    for (int key: {0, 3, 4, 5, 8}) {
+        hint = map.lower_bound(hint, key);
+        if (hint != map.end() && hint->first == key) {
+            joined.push_back(hint->second);
+        }
+    }
+    EXPECT_EQ(joined, std::vector<int>({30, 50}));
+}
+
+TEST(TreesTest, TreapStatistics) {
+    // shape is available without counting policy, counters stay zero
+    nstd::ordered_set<int> plain {5, 3, 8};
+    EXPECT_TRUE(plain.contains(3));
+    auto plain_stats = plain.stats();
+    EXPECT_EQ(plain_stats.size, 3u);
+    EXPECT_EQ(std::accumulate(plain_stats.depth_histogram.begin(), plain_stats.depth_histogram.end(), size_t(0)), 3u);
+    EXPECT_EQ(plain_stats.depth_histogram[0], 1u);
+    EXPECT_EQ(plain_stats.lookups, 0u);
+    EXPECT_EQ(nstd::ordered_set<int>().stats().max_depth, 0u);
+
+    nstd::ordered_set<int, std::less<int>, std::allocator<int>, nstd::random_priority_generator,
+            nstd::default_treap_layout, nstd::treap_operation_counters> keys;
+    for (int i = 0; i < 1000; ++i) {
+        keys.insert(i * 7 % 1000);
+    }
+    auto stats = keys.stats();
+    EXPECT_EQ(stats.size, 1000u);
+    EXPECT_EQ(stats.max_depth, stats.depth_histogram.size());
+    EXPECT_EQ(std::accumulate(stats.depth_histogram.begin(), stats.depth_histogram.end(), size_t(0)), 1000u);
+    EXPECT_GT(stats.average_depth, 1.0);
+    EXPECT_LE(stats.average_depth, static_cast<double>(stats.max_depth));
+    EXPECT_EQ(stats.constructed_nodes, 1000u);
+    // the node pool allocates chunks, not single nodes
+    EXPECT_GT(stats.allocations, 0u);
+    EXPECT_LT(stats.allocations_per_node(), 0.1);
+
+    keys.reset_stats();
+    EXPECT_EQ(keys.stats().lookups, 0u);
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_NE(keys.find(i), keys.end());
+    }
+    stats = keys.stats();
+    EXPECT_EQ(stats.lookups, 100u);
+    EXPECT_GE(stats.visited_nodes_per_lookup(), 1.0);
+    EXPECT_LE(stats.visited_nodes, 100 * stats.max_depth);
+    keys.erase_key_interval(100, 200);
+    EXPECT_GE(keys.stats().splits, 2u);
+    EXPECT_GE(keys.stats().merges, 1u);
+    // copies start counting from zero
+    auto copied = keys;
+    EXPECT_EQ(copied.stats().lookups, 0u);
+    EXPECT_EQ(copied.stats().depth_histogram.size(), copied.stats().max_depth);
+
+    nstd::vector_tree<int, std::allocator<int>, void, nstd::random_priority_generator, nstd::default_treap_layout,
+            nstd::treap_operation_counters> vector;
+    for (int i = 0; i < 100; ++i) {
+        vector.push_back(1);
+    }
+    EXPECT_EQ(vector[50], 1);
+    EXPECT_EQ(vector.stats().lookups, 1u);
+    EXPECT_GE(vector.stats().visited_nodes, 1u);
+
+    nstd::ordered_multiset<int, std::less<int>, std::allocator<int>, nstd::random_priority_generator,
+            nstd::default_treap_layout, nstd::treap_operation_counters> samples {1, 1, 2};
+    EXPECT_EQ(samples.count(1), 2u);
+    EXPECT_EQ(samples.stats().lookups, 2u);
+}
+
+// affine actions x -> a * x + b modulo prime with sum aggregate
+struct affine_operations {
+    static constexpr unsigned long long modulo = 1'000'000'007;
+
+    struct action_type {
+        unsigned long long multiplier = 1;
+        unsigned long long addend = 0;
+    };
+
+    struct monoid_type {
+        using value_type = unsigned long long;
+
+        static constexpr bool commutative = true;
+
+        static value_type identity() { return 0; }
+
+        static value_type combine(value_type left, value_type right) { return (left + right) % modulo; }
+    };
+
+    using aggregate_type = unsigned long long;
+
+    static aggregate_type lift(unsigned long long value) { return value; }
+
+    static action_type identity_action() { return {}; }
+
+    static bool is_identity(const action_type& action) { return action.multiplier == 1 && action.addend == 0; }
+
+    static action_type compose(const action_type& first, const action_type& second) {
+        return {first.multiplier * second.multiplier % modulo,
+                (first.addend * second.multiplier + second.addend) % modulo};
+    }
+
+    static void apply(unsigned long long& value, const action_type& action) {
+        value = (value * action.multiplier + action.addend) % modulo;
+    }
+
+    static aggregate_type apply(aggregate_type aggregate, const action_type& action, size_t count) {
+        return (aggregate * action.multiplier + count % modulo * action.addend) % modulo;
+    }
+};
+
+TEST(TreesTest, VectorTreeIntervalOperations) {
+    std::mt19937 generator(29);
+    nstd::vector_tree<long long, std::allocator<long long>, nstd::range_sum_operations<long long>> sums;
+    nstd::vector_tree<long long, std::allocator<long long>, nstd::range_min_operations<long long>> mins;
+    nstd::vector_tree<long long, std::allocator<long long>, nstd::range_max_operations<long long>> maxs;
+    std::vector<long long> expected;
+    auto random_interval = [&]() {
+        size_t begin = generator() % (expected.size() + 1);
+        size_t end = begin + generator() % (expected.size() - begin + 1);
+        return std::make_pair(begin, end);
+    };
+    for (int i = 0; i < 3000; ++i) {
+        auto [begin, end] = random_interval();
+        long long value = static_cast<long long>(generator() % 201) - 100;
+        switch (generator() % 6) {
+            case 0:
+                sums.insert(begin, value);
+                mins.insert(begin, value);
+                maxs.insert(begin, value);
+                expected.insert(expected.begin() + begin, value);
+                break;
+            case 1:
+                sums.erase_interval(begin, end);
+                mins.erase_interval(begin, end);
+                maxs.erase_interval(begin, end);
+                expected.erase(expected.begin() + begin, expected.begin() + end);
+                break;
+            case 2:
+                sums.add_interval(begin, end, value);
+                mins.add_interval(mins.begin() + begin, mins.begin() + end, value);
+                maxs.add_interval(begin, end, value);
+                std::for_each(expected.begin() + begin, expected.begin() + end, [value](auto& x) { x += value; });
+                break;
+            case 3:
+                sums.assign_interval(begin, end, value);
+                mins.assign_interval(begin, end, value);
+                maxs.assign_interval(maxs.begin() + begin, maxs.begin() + end, value);
+                std::fill(expected.begin() + begin, expected.begin() + end, value);
+                break;
+            case 4: {
+                size_t count = generator() % 5;
+                sums.shift_interval(begin, end, count);
+                mins.shift_interval(begin, end, count);
+                maxs.shift_interval(begin, end, count);
+                if (begin < end) {
+                    std::rotate(expected.begin() + begin, expected.begin() + (end - (count % (end - begin))),
+                                expected.begin() + end);
+                }
+                break;
+            }
+            default:
+                for (int j = 0; j < 3; ++j) {
+                    sums.push_back(value + j);
+                    mins.push_back(value + j);
+                    maxs.push_back(value + j);
+                    expected.push_back(value + j);
+                }
+        }
+        auto [query_begin, query_end] = random_interval();
+        long long expected_sum = 0;
+        long long expected_min = std::numeric_limits<long long>::max();
+        long long expected_max = std::numeric_limits<long long>::lowest();
+        for (size_t j = query_begin; j < query_end; ++j) {
+            expected_sum += expected[j];
+            expected_min = std::min(expected_min, expected[j]);
+            expected_max = std::max(expected_max, expected[j]);
+        }
+        ASSERT_EQ(sums.aggregate_interval(query_begin, query_end), expected_sum);
+        ASSERT_EQ(mins.aggregate_interval(query_begin, query_end), expected_min);
+        ASSERT_EQ(maxs.aggregate_interval(maxs.begin() + query_begin, maxs.begin() + query_end), expected_max);
+        if (i % 100 == 0) {
+            // iteration and operator[] see pending actions
+            EXPECT_EQ_WITH_CONTENT(sums, expected);
+            EXPECT_TRUE(std::equal(mins.rbegin(), mins.rend(), expected.rbegin(), expected.rend()));
+            for (size_t j = 0; j < expected.size(); j += 7) {
+                ASSERT_EQ(maxs[j], expected[j]);
+            }
+        }
+    }
+    EXPECT_EQ(sums.aggregate(), std::accumulate(expected.begin(), expected.end(), 0LL));
+
+    // after applying the pending actions const functions may be called concurrently
+    sums.add_interval(0, expected.size(), 3);
+    sums.reverse();
+    std::for_each(expected.begin(), expected.end(), [](auto& x) { x += 3; });
+    std::reverse(expected.begin(), expected.end());
+    sums.apply_pending();
+    const auto& settled = sums;
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; ++i) {
+        readers.emplace_back([&settled, &expected] {
+            EXPECT_TRUE(std::equal(settled.begin(), settled.end(), expected.begin(), expected.end()));
+            EXPECT_EQ(settled.aggregate_interval(1, expected.size() / 2),
+                      std::accumulate(expected.begin() + 1, expected.begin() + expected.size() / 2, 0LL));
+        });
+    }
+    for (auto& reader: readers) {
+        reader.join();
+    }
+
+    // custom operations
+    nstd::vector_tree<unsigned long long, std::allocator<unsigned long long>, affine_operations> affine;
+    std::vector<unsigned long long> expected_affine;
+    for (unsigned long long i = 0; i < 500; ++i) {
+        affine.push_back(i);
+        expected_affine.push_back(i);
+    }
+    for (int i = 0; i < 500; ++i) {
+        size_t begin = generator() % 500;
+        size_t end = begin + generator() % (500 - begin + 1);
+        affine_operations::action_type action{generator() % 1000, generator() % 1000};
+        affine.apply_interval(begin, end, action);
+        for (size_t j = begin; j < end; ++j) {
+            affine_operations::apply(expected_affine[j], action);
+        }
+        size_t query = generator() % 500;
+        unsigned long long expected_sum = 0;
+        for (size_t j = query; j < 500; ++j) {
+            expected_sum = (expected_sum + expected_affine[j]) % affine_operations::modulo;
+        }
+        ASSERT_EQ(affine.aggregate_interval(query, 500), expected_sum);
+    }
+    EXPECT_EQ_WITH_CONTENT(affine, expected_affine);
+}
+
+// scaling actions with polynomial hash aggregate, which is sensitive to the element order
+struct scaled_hash_operations {
+    using monoid_type = polynomial_hash_monoid;
+    using aggregate_type = polynomial_hash;
+    using action_type = unsigned long long;
+
+    static aggregate_type lift(unsigned long long value) { return aggregate_type(value); }
+
+    static action_type identity_action() { return 1; }
+
+    static bool is_identity(action_type action) { return action == 1; }
+
+    static action_type compose(action_type first, action_type second) { return first * second; }
+
+    static void apply(unsigned long long& value, action_type action) { value *= action; }
+
+    static aggregate_type apply(aggregate_type aggregate, action_type action, size_t) {
+        aggregate.hash *= action;
+        return aggregate;
+    }
+};
+
+TEST(TreesTest, VectorTreeNonCommutativeAggregate) {
+    std::mt19937 generator(41);
+    static_assert(!nstd::is_commutative_monoid_v<polynomial_hash_monoid>);
+    static_assert(nstd::is_commutative_monoid_v<affine_operations::monoid_type>);
+    nstd::vector_tree<unsigned long long, std::allocator<unsigned long long>, scaled_hash_operations> hashes;
+    std::vector<unsigned long long> expected;
+    for (unsigned long long i = 0; i < 16; ++i) {
+        hashes.push_back(i * 7 + 1);
+        expected.push_back(i * 7 + 1);
+    }
+    for (int round = 0; round < 90; ++round) {
+        size_t begin = generator() % 16;
+        size_t end = begin + generator() % (16 - begin + 1);
+        if (round % 3 == 0) {
+            unsigned long long multiplier = generator() % 5 + 2;
+            hashes.apply_interval(begin, end, multiplier);
+            std::for_each(expected.begin() + begin, expected.begin() + end, [multiplier](auto& x) { x *= multiplier; });
+        } else if (round % 3 == 1) {
+            // reversed intervals are folded in the new element order
+            hashes.reverse_interval(begin, end);
+            std::reverse(expected.begin() + begin, expected.begin() + end);
+        } else {
+            hashes.shift_interval(begin, end, 3);
+            if (begin < end) {
+                std::rotate(expected.begin() + begin, expected.begin() + (end - 3 % (end - begin)),
+                            expected.begin() + end);
+            }
+        }
+        for (size_t query_begin = 0; query_begin <= 16; ++query_begin) {
+            polynomial_hash expected_hash;
+            for (size_t query_end = query_begin; query_end <= 16; ++query_end) {
+                ASSERT_EQ(hashes.aggregate_interval(query_begin, query_end), expected_hash);
+                if (query_end < 16) {
+                    expected_hash = polynomial_hash_monoid::combine(expected_hash, polynomial_hash(expected[query_end]));
+                }
+            }
+        }
+    }
+    EXPECT_EQ_WITH_CONTENT(hashes, expected);
+}
+
+TEST(TreesTest, VectorTreeReverseInterval) {
+    std::mt19937 generator(31);
+    nstd::vector_tree<int> vec;
+    nstd::vector_tree<long long, std::allocator<long long>, nstd::range_sum_operations<long long>> sums;
+    std::vector<int> expected;
+    for (int i = 0; i < 3000; ++i) {
+        size_t begin = generator() % (expected.size() + 1);
+        size_t end = begin + generator() % (expected.size() - begin + 1);
+        int value = static_cast<int>(generator() % 1000);
+        switch (generator() % 5) {
+            case 0:
+            case 1:
+                vec.insert(begin, value);
+                sums.insert(sums.begin() + begin, value);
+                expected.insert(expected.begin() + begin, value);
+                break;
+            case 2:
+                vec.erase_interval(begin, end);
+                sums.erase_interval(begin, end);
+                expected.erase(expected.begin() + begin, expected.begin() + end);
+                break;
+            case 3:
+                sums.add_interval(begin, end, 1);
+                vec.reverse_interval(vec.begin() + begin, vec.begin() + end);
+                std::reverse(expected.begin() + begin, expected.begin() + end);
+                break;
+            default:
+                vec.reverse_interval(begin, end);
+                sums.reverse_interval(begin, end);
+                std::reverse(expected.begin() + begin, expected.begin() + end);
+                sums.add_interval(begin, end, -1);
+                sums.add_interval(begin, end, 1);
+        }
+        if (!expected.empty()) {
+            size_t index = generator() % expected.size();
+            ASSERT_EQ(vec[index], expected[index]);
+        }
+        if (i % 50 == 0) {
+            EXPECT_EQ_WITH_CONTENT(vec, expected);
+            EXPECT_TRUE(std::equal(vec.rbegin(), vec.rend(), expected.rbegin(), expected.rend()));
+            EXPECT_EQ(sums.aggregate_interval(0, sums.size()), sums.aggregate());
+        }
+    }
+
+    // passed iterators keep showing the same elements and move according to the new order
+    nstd::vector_tree<int> values{0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+    auto it = values.begin() + 2;
+    values.reverse_interval(it, values.begin() + 8);
+    EXPECT_EQ(*it, 2);
+    EXPECT_EQ(it.order(), 7u);
+    EXPECT_EQ(*(it + 1), 8);
+    EXPECT_EQ(*(it - 1), 3);
+    values.reverse();
+    EXPECT_EQ(*it, 2);
+    EXPECT_EQ(it - values.begin(), 2);
+    EXPECT_EQ(*++it, 3);
+    EXPECT_EQ_WITH_CONTENT(values, (std::vector<int>{9, 8, 2, 3, 4, 5, 6, 7, 1, 0}));
+}
+
 TEST(TreesTest, VectorTree) {
     nstd::vector_tree<int> vec;
     for (int i = 0; i < 1000; ++i) {
@@ -113,4 +1932,74 @@ TEST(TreesTest, VectorTree) {
     EXPECT_EQ(vec.end() - vec.begin(), vec.size());
 }
 
+TEST(TreesTest, VectorTreeRangeOperations) {
+    std::list<int> source;
+    for (int i = 0; i < 1000; ++i) {
+        source.push_back(i);
+    }
+    nstd::vector_tree<int> vec(source.begin(), source.end());
+    std::vector<int> expected(source.begin(), source.end());
+    EXPECT_EQ_WITH_CONTENT(vec, expected);
+
+    std::mt19937 generator(37);
+    for (int i = 0; i < 100; ++i) {
+        size_t index = generator() % (expected.size() + 2);
+        std::vector<int> inserted(generator() % 50, i);
+        std::iota(inserted.begin(), inserted.end(), -i * 100);
+        auto it = vec.insert(index, inserted.begin(), inserted.end());
+        index = std::min(index, expected.size());
+        expected.insert(expected.begin() + index, inserted.begin(), inserted.end());
+        EXPECT_EQ(it - vec.begin(), index);
+        if (index != expected.size()) {
+            EXPECT_EQ(*it, expected[index]);
+        }
+    }
+    EXPECT_EQ_WITH_CONTENT(vec, expected);
+    EXPECT_TRUE(std::equal(vec.rbegin(), vec.rend(), expected.rbegin(), expected.rend()));
+
+    nstd::vector_tree<int> copied(vec);
+    EXPECT_EQ_WITH_CONTENT(copied, expected);
+    copied.assign({3, 2, 1});
+    EXPECT_EQ_WITH_CONTENT(copied, (std::vector<int>{3, 2, 1}));
+    EXPECT_EQ(*copied.begin(), 3);
+    copied.assign(source.begin(), source.begin());
+    EXPECT_TRUE(copied.empty());
+    EXPECT_EQ(copied.begin(), copied.end());
+
+    nstd::vector_tree<long long, std::allocator<long long>, nstd::range_sum_operations<long long>> sums(
+            expected.begin(), expected.end());
+    sums.insert(sums.begin() + 10, {1, 2, 3});
+    EXPECT_EQ(sums.aggregate(), std::accumulate(expected.begin(), expected.end(), 6LL));
+    EXPECT_EQ(sums.aggregate_interval(10, 13), 6);
+}
+
+TEST(TreesTest, VectorTreeRandomOperations) {
+    std::mt19937 generator(7);
+    nstd::vector_tree<int> vec;
+    std::vector<int> expected;
+    for (int i = 0; i < 3000; ++i) {
+        size_t index = generator() % (expected.size() + 1);
+        size_t end = index + generator() % (expected.size() - index + 1);
+        switch (generator() % 4) {
+            case 0:
+            case 1:
+                vec.insert(index, i);
+                expected.insert(expected.begin() + index, i);
+                break;
+            case 2:
+                vec.erase_interval(index, std::min(end, index + 3));
+                expected.erase(expected.begin() + index, expected.begin() + std::min(end, index + 3));
+                break;
+            default:
+                vec.shift_interval(index, end, 2);
+                if (end - index > 0) {
+                    std::rotate(expected.begin() + index, expected.begin() + end - 2 % (end - index),
+                                expected.begin() + end);
+                }
+        }
+        ASSERT_EQ(vec.size(), expected.size());
+    }
+    EXPECT_EQ_WITH_CONTENT(vec, expected);
+}
+
 #endif // TEST_TREES
\ No newline at end of file
@@ -0,0 +1,1216 @@
+#ifndef BASICS_BTREE_HPP
+#define BASICS_BTREE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <reverse_iterator.hpp>
+
+namespace nstd {
+
+/**
+ * B+ tree with order statistics
+ * Values are kept in wide leaves linked into a list, internal nodes keep separator keys and per-child subtree sizes,
+ * so searches touch O(log size / log node width) nodes and order statistics work in O(log size) complexity
+ * Keys and values are moved between nodes on splits and merges, so modifications invalidate iterators like std::vector
+ * @tparam Traits value traits: key_type, value_type given by iterators, slot_type kept in leaves,
+ * get_key(const slot_type&) and element(slot_type&) functions
+ */
+template <typename Traits, typename Compare, typename Allocator>
+class btree {
+public:
+    using key_type = typename Traits::key_type;
+    using value_type = typename Traits::slot_type;
+    using key_compare = Compare;
+    using allocator_type = Allocator;
+    using size_type = size_t;
+
+private:
+    using slot_type = typename Traits::slot_type;
+    using alloc_traits = std::allocator_traits<allocator_type>;
+    using slot_allocator_type = typename alloc_traits::template rebind_alloc<slot_type>;
+    using slot_traits = std::allocator_traits<slot_allocator_type>;
+    using key_allocator_type = typename alloc_traits::template rebind_alloc<key_type>;
+    using key_traits = std::allocator_traits<key_allocator_type>;
+
+    // values are relocated between nodes, relocations must not fail in the middle of restructuring
+    static_assert(std::is_nothrow_move_constructible_v<slot_type> && std::is_nothrow_move_constructible_v<key_type>,
+                  "B-tree keys and values must be nothrow move constructible");
+
+    // nodes are sized to several cache lines, so one node is loaded by a few sequential memory accesses
+    static constexpr size_type node_bytes = 512;
+    static constexpr size_type leaf_capacity = std::clamp<size_type>(node_bytes / sizeof(slot_type), 4, 255);
+    static constexpr size_type internal_capacity =
+            std::clamp<size_type>(node_bytes / (sizeof(key_type) + sizeof(void*) + sizeof(size_type)), 4, 255);
+    // nodes having less entries are merged with a sibling, when they fit together
+    static constexpr size_type leaf_min_count = leaf_capacity / 2;
+    static constexpr size_type internal_min_count = internal_capacity / 2;
+    // root splits happen only for full roots, so the height can't exceed the size bits count
+    static constexpr size_type max_height = 64;
+
+    /**
+     * Arithmetic keys compared with standard comparators are searched by branchless counting over the whole node,
+     * which compilers vectorize, other keys are searched by binary search
+     */
+    static constexpr bool linear_search = std::is_arithmetic_v<key_type> &&
+                                          (std::is_same_v<Compare, std::less<key_type>> ||
+                                           std::is_same_v<Compare, std::less<>> ||
+                                           std::is_same_v<Compare, std::greater<key_type>> ||
+                                           std::is_same_v<Compare, std::greater<>>);
+
+    struct internal_node;
+
+    struct node_header {
+        internal_node* parent;
+        // index in the parent children
+        std::uint16_t position;
+        // values count for leaf, children count for internal node
+        std::uint16_t count;
+        bool leaf;
+    };
+
+    // leaves are linked into circular list through the tree end link
+    struct leaf_link {
+        leaf_link* prev;
+        leaf_link* next;
+    };
+
+    struct leaf_node : node_header, leaf_link {
+        alignas(slot_type) unsigned char storage[leaf_capacity * sizeof(slot_type)];
+
+        slot_type* slots() { return reinterpret_cast<slot_type*>(storage); }
+    };
+
+    /**
+     * Separator key i is not greater than the keys of child i + 1 and greater than the keys of child i
+     * counts[i] is the values count of child i subtree
+     */
+    struct internal_node : node_header {
+        alignas(key_type) unsigned char key_storage[(internal_capacity - 1) * sizeof(key_type)];
+        node_header* children[internal_capacity];
+        size_type counts[internal_capacity];
+
+        key_type* keys() { return reinterpret_cast<key_type*>(key_storage); }
+    };
+
+    using leaf_allocator_type = typename alloc_traits::template rebind_alloc<leaf_node>;
+    using leaf_traits = std::allocator_traits<leaf_allocator_type>;
+    using internal_allocator_type = typename alloc_traits::template rebind_alloc<internal_node>;
+    using internal_traits = std::allocator_traits<internal_allocator_type>;
+
+    /**
+     * Iterator class for B-tree, points on the leaf value or on the tree end link
+     * @tparam B determines is iterator class for const elements or not
+     */
+    template <bool B>
+    class common_iterator {
+        friend class common_iterator<!B>;
+        friend class btree;
+
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = std::conditional_t<B, const typename Traits::value_type, typename Traits::value_type>;
+        using difference_type = ptrdiff_t;
+        using pointer = value_type*;
+        using reference = value_type&;
+
+    private:
+        leaf_link* _node;
+        size_type _index;
+
+    public:
+        common_iterator(leaf_link* node = nullptr, size_type index = 0) : _node(node), _index(index) {}
+
+        /**
+         * This constructor serves as copy constructor for iterator
+         * And conversion operator from iterator to const_iterator either
+         */
+        common_iterator(const common_iterator<false>& other) : _node(other._node), _index(other._index) {}
+
+    public:
+        common_iterator& operator++() {
+            if (++_index == static_cast<leaf_node*>(_node)->count) {
+                _node = _node->next;
+                _index = 0;
+            }
+            return *this;
+        }
+
+        common_iterator operator++(int)& {
+            common_iterator iter = *this;
+            ++*this;
+            return iter;
+        }
+
+        common_iterator& operator--() {
+            if (_index == 0) {
+                _node = _node->prev;
+                _index = static_cast<leaf_node*>(_node)->count;
+            }
+            --_index;
+            return *this;
+        }
+
+        common_iterator operator--(int)& {
+            common_iterator iter = *this;
+            --*this;
+            return iter;
+        }
+
+    public:
+        value_type& operator*() const { return Traits::element(static_cast<leaf_node*>(_node)->slots()[_index]); }
+
+        value_type* operator->() const { return std::addressof(**this); }
+
+    public:
+        bool operator==(const common_iterator& other) const { return _node == other._node && _index == other._index; }
+
+        bool operator!=(const common_iterator& other) const { return !(*this == other); }
+    };
+
+public:
+    using iterator = common_iterator<false>;
+    using const_iterator = common_iterator<true>;
+    using reverse_iterator = common_reverse_iterator<iterator>;
+    using const_reverse_iterator = common_reverse_iterator<const_iterator>;
+
+private:
+    /**
+     * Value place found by descent, index may be equal to the leaf count
+     */
+    struct leaf_position {
+        leaf_node* leaf;
+        size_type index;
+        // count of the tree values before the place
+        size_type order;
+    };
+
+    /**
+     * Nodes allocated before the insertion restructuring, so the restructuring itself can't fail
+     * Not used nodes are deallocated by destructor
+     */
+    class node_reserve {
+    private:
+        btree& _tree;
+        leaf_node* _leaf = nullptr;
+        internal_node* _internals[max_height];
+        size_type _count = 0;
+
+    public:
+        explicit node_reserve(btree& tree) noexcept : _tree(tree) {}
+
+        node_reserve(const node_reserve&) = delete;
+
+        node_reserve& operator=(const node_reserve&) = delete;
+
+        ~node_reserve();
+
+        void reserve(size_type internals);
+
+        leaf_node* take_leaf() noexcept { return std::exchange(_leaf, nullptr); }
+
+        internal_node* take_internal() noexcept { return _internals[--_count]; }
+    };
+
+private:
+    node_header* _root = nullptr;
+    leaf_link _end;
+    size_type _size = 0;
+    key_compare _comparator;
+    allocator_type _allocator;
+
+public:
+    explicit btree(const key_compare& comparator = key_compare(), const allocator_type& allocator = allocator_type());
+
+    btree(const btree& other);
+
+    btree(btree&& other) noexcept;
+
+    btree& operator=(const btree& other);
+
+    btree& operator=(btree&& other) noexcept;
+
+    ~btree() { clear(); }
+
+private:
+    /**
+     * Counts the items having keys less than the passed key (not greater, when KeyIncluded is true)
+     * Items must be sorted by their keys
+     */
+    template <bool KeyIncluded, typename Item, typename Projection>
+    size_type search(const Item* items, size_type count, const key_type& key, Projection projection) const;
+
+    /**
+     * Finds the leaf place of the lower bound (upper bound, when KeyIncluded is true) of the key
+     * Works in O(log size) complexity
+     */
+    template <bool KeyIncluded>
+    leaf_position find_position(const key_type& key) const;
+
+    /**
+     * Finds the leaf place of the value having the passed order, order must be less than size
+     */
+    leaf_position position_of_order(size_type order) const;
+
+    /**
+     * Gives the order of the iterator value, size for the end iterator
+     */
+    size_type order_of(const_iterator it) const;
+
+    iterator make_iterator(const leaf_position& position) const;
+
+    /**
+     * Inserts the value constructed with the passed arguments at the leaf place
+     * Full nodes on the path are split, nodes are allocated before restructuring
+     * Provides strong exception safety
+     */
+    template <typename... Args>
+    iterator insert_at(leaf_node* leaf, size_type index, Args&& ... args);
+
+    /**
+     * Splits full leaf, so the value can be inserted at the index
+     * @return leaf and index of the insertion place after split
+     */
+    std::pair<leaf_node*, size_type> split_leaf(leaf_node* leaf, size_type index);
+
+    /**
+     * Inserts child with its separator key after the parent child having position - 1 index
+     * The inserted child values are taken from its left sibling, so the parent subtree size doesn't change
+     * Full parents are split recursively, a new root is created, when the root is split
+     */
+    void insert_child(internal_node* parent, size_type position, key_type&& separator, node_header* child,
+                      size_type child_count, node_reserve& reserve) noexcept;
+
+    /**
+     * Erases count values starting from the index of the leaf and rebalances the tree
+     */
+    void erase_slots(leaf_node* leaf, size_type index, size_type count) noexcept;
+
+    /**
+     * Merges the underfull nodes on the path from the passed node with their siblings, when they fit together
+     * Underfull internal nodes, which don't fit with their siblings, borrow a child from the bigger sibling,
+     * so internal nodes keep at least two children and empty leaves always fit with their siblings
+     * Leaves are only merged, as borrowing values would copy a new separator key
+     * Merging and borrowing only relocate keys, so erasure doesn't copy keys and doesn't throw
+     */
+    void rebalance(node_header* node) noexcept;
+
+    /**
+     * Moves the last child of the left sibling to the beginning of the internal node through the parent separator
+     */
+    void borrow_from_left(internal_node* node) noexcept;
+
+    /**
+     * Moves the first child of the right sibling to the end of the internal node through the parent separator
+     */
+    void borrow_from_right(internal_node* node) noexcept;
+
+    /**
+     * Moves the child having position + 1 index to its left sibling and removes it from the parent
+     */
+    void merge_children(internal_node* parent, size_type position) noexcept;
+
+    static void set_child(internal_node* parent, size_type position, node_header* child) noexcept;
+
+    void link_leaf_after(leaf_link* link, leaf_node* leaf) noexcept;
+
+    static void unlink_leaf(leaf_node* leaf) noexcept;
+
+    void relocate_slot(slot_type* destination, slot_type* source) noexcept;
+
+    void relocate_key(key_type* destination, key_type* source) noexcept;
+
+    leaf_node* allocate_leaf();
+
+    internal_node* allocate_internal();
+
+    void deallocate_leaf(leaf_node* leaf) noexcept;
+
+    void deallocate_internal(internal_node* node) noexcept;
+
+    void destroy_node(node_header* node) noexcept;
+
+    // links the end link to the first and the last leaves after the tree members are moved
+    void relink_end() noexcept;
+
+protected:
+    /**
+     * Inserts a value constructed with passed arguments, when the key is absent
+     * Key place is found in one descent and the value is constructed only, when the key is absent
+     * @return pair of the key iterator and boolean showing whether the key was inserted or not
+     */
+    template <typename... Args>
+    std::pair<iterator, bool> emplace_with_key(const key_type& key, Args&& ... args);
+
+public:
+    void swap(btree& other) noexcept;
+
+    size_type size() const noexcept { return _size; }
+
+    bool empty() const noexcept { return _size == 0; }
+
+    void clear() noexcept;
+
+    std::pair<iterator, bool> insert(const value_type& value) {
+        return emplace_with_key(Traits::get_key(value), value);
+    }
+
+    std::pair<iterator, bool> insert(value_type&& value) {
+        return emplace_with_key(Traits::get_key(value), std::move(value));
+    }
+
+    /**
+     * Inserts range elements, which keys are absent in the tree
+     * Works in O(range size * log size) complexity
+     */
+    template <typename InputIterator>
+    void insert(InputIterator begin, InputIterator end);
+
+    void insert(std::initializer_list<value_type> il) { insert(il.begin(), il.end()); }
+
+    /**
+     * Inserts a value constructed with passed arguments, when its key is absent
+     * The value is constructed before the search and moved into the leaf
+     * Working complexity is O (log size)
+     * @return pair, where the first one is inserted iterator and the second one is boolean showing whether the key was actually inserted or not
+     */
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(Args&& ... args);
+
+    /**
+     * Replaces tree content with the passed sorted range elements
+     * Values are appended to the last leaf, so working complexity is O(range size) amortized
+     * and sequentially filled leaves are kept almost full
+     * Keys, which are not greater than the previous one, are skipped
+     */
+    template <typename InputIterator>
+    void assign_sorted(InputIterator begin, InputIterator end);
+
+public:
+    /**
+     * Erases interval with the passed endpoints from the tree
+     * Values of each leaf are erased at once, so working complexity is O(end - begin + (end - begin) / leaf width * log size)
+     * If end <= begin nothing happens
+     * @param begin interval begin (inclusive endpoint)
+     * @param end interval end (exclusive endpoint)
+     * @returns iterator pointing on the value after interval
+     */
+    iterator erase_interval(size_type begin, size_type end) noexcept;
+
+    iterator erase_index(size_type index) noexcept { return erase_interval(index, index + 1); }
+
+    iterator erase(const_iterator it) noexcept;
+
+    iterator erase(const_iterator begin, const_iterator end) noexcept;
+
+    /**
+     * Erases passed key interval from the tree
+     * @param begin_key begin key (inclusive endpoint)
+     * @param end_key end key (exclusive endpoint)
+     * @returns iterator pointing on first value after interval
+     */
+    iterator erase_key_interval(const key_type& begin_key, const key_type& end_key);
+
+    /**
+     * Erases passed key interval from the tree
+     * @param begin_key begin key (inclusive endpoint)
+     * @param end_key end key (inclusive endpoint)
+     * @returns iterator pointing on first value after interval
+     */
+    iterator erase_key_interval_with_end(const key_type& begin_key, const key_type& end_key);
+
+    /**
+     * Erases the value with the passed key, if there is no such key, nothing happens
+     * Working complexity is O (log size)
+     * @returns iterator pointing on the value after key
+     */
+    iterator erase_key(const key_type& key);
+
+public:
+    bool contains(const key_type& key) const { return find(key) != end(); }
+
+    iterator find(const key_type& key);
+
+    const_iterator find(const key_type& key) const;
+
+    iterator lower_bound(const key_type& key) { return make_iterator(find_position<false>(key)); }
+
+    const_iterator lower_bound(const key_type& key) const { return make_iterator(find_position<false>(key)); }
+
+    iterator upper_bound(const key_type& key) { return make_iterator(find_position<true>(key)); }
+
+    const_iterator upper_bound(const key_type& key) const { return make_iterator(find_position<true>(key)); }
+
+    /**
+     * Returns the key, which is located in the passed index
+     * Works in O (log size) complexity
+     * Throws std::out_of_range exception, when index >= size
+     */
+    const key_type& key_of_order(size_type index) const;
+
+    /**
+     * Returns index of the passed key
+     * Works in O (log size) complexity
+     * @return proper index, when the tree has the key, size() otherwise
+     */
+    size_type order_of_key(const key_type& key) const;
+
+public:
+    iterator begin() noexcept { return {_end.next, 0}; }
+
+    const_iterator begin() const noexcept { return {_end.next, 0}; }
+
+    iterator end() noexcept { return {&_end, 0}; }
+
+    const_iterator end() const noexcept { return {const_cast<leaf_link*>(&_end), 0}; }
+
+    reverse_iterator rbegin() noexcept { return end(); }
+
+    const_reverse_iterator rbegin() const noexcept { return end(); }
+
+    reverse_iterator rend() noexcept { return begin(); }
+
+    const_reverse_iterator rend() const noexcept { return begin(); }
+
+    const_iterator cbegin() const noexcept { return begin(); }
+
+    const_iterator cend() const noexcept { return end(); }
+
+    const_reverse_iterator crbegin() const noexcept { return rbegin(); }
+
+    const_reverse_iterator crend() const noexcept { return rend(); }
+};
+
+//======================node reserve implementation==========================================
+
+template <typename Traits, typename Compare, typename Allocator>
+btree<Traits, Compare, Allocator>::node_reserve::~node_reserve() {
+    if (_leaf != nullptr) {
+        _tree.deallocate_leaf(_leaf);
+    }
+    while (_count > 0) {
+        _tree.deallocate_internal(_internals[--_count]);
+    }
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+void btree<Traits, Compare, Allocator>::node_reserve::reserve(size_type internals) {
+    _leaf = _tree.allocate_leaf();
+    while (_count < internals) {
+        _internals[_count] = _tree.allocate_internal();
+        ++_count;
+    }
+}
+
+//======================B-tree implementation==========================================
+
+template <typename Traits, typename Compare, typename Allocator>
+btree<Traits, Compare, Allocator>::btree(const key_compare& comparator, const allocator_type& allocator)
+        : _end{&_end, &_end}, _comparator(comparator), _allocator(allocator) {}
+
+template <typename Traits, typename Compare, typename Allocator>
+btree<Traits, Compare, Allocator>::btree(const btree& other)
+        : _end{&_end, &_end}, _comparator(other._comparator),
+          _allocator(alloc_traits::select_on_container_copy_construction(other._allocator)) {
+    assign_sorted(other.begin(), other.end());
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+btree<Traits, Compare, Allocator>::btree(btree&& other) noexcept
+        : _root(std::exchange(other._root, nullptr)), _end(other._end), _size(std::exchange(other._size, 0)),
+          _comparator(std::move(other._comparator)), _allocator(std::move(other._allocator)) {
+    relink_end();
+    other.relink_end();
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+btree<Traits, Compare, Allocator>& btree<Traits, Compare, Allocator>::operator=(const btree& other) {
+    if (this != &other) {
+        btree copied(other);
+        swap(copied);
+    }
+    return *this;
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+btree<Traits, Compare, Allocator>& btree<Traits, Compare, Allocator>::operator=(btree&& other) noexcept {
+    if (this != &other) {
+        btree moved(std::move(other));
+        swap(moved);
+    }
+    return *this;
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+template <bool KeyIncluded, typename Item, typename Projection>
+typename btree<Traits, Compare, Allocator>::size_type
+btree<Traits, Compare, Allocator>::search(const Item* items, size_type count, const key_type& key,
+                                          Projection projection) const {
+    if constexpr (linear_search) {
+        // no branches depend on the comparison results, so the loop is vectorized
+        size_type result = 0;
+        for (size_type i = 0; i < count; ++i) {
+            result += (KeyIncluded ? !_comparator(key, projection(items[i])) : _comparator(projection(items[i]), key));
+        }
+        return result;
+    } else {
+        size_type low = 0;
+        size_type high = count;
+        while (low < high) {
+            size_type middle = low + (high - low) / 2;
+            bool before = (KeyIncluded ? !_comparator(key, projection(items[middle]))
+                                       : _comparator(projection(items[middle]), key));
+            if (before) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        return low;
+    }
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+template <bool KeyIncluded>
+typename btree<Traits, Compare, Allocator>::leaf_position
+btree<Traits, Compare, Allocator>::find_position(const key_type& key) const {
+    if (_root == nullptr) {
+        return {nullptr, 0, 0};
+    }
+    auto key_of_key = [](const key_type& separator) -> const key_type& { return separator; };
+    auto key_of_slot = [](const slot_type& slot) -> const key_type& { return Traits::get_key(slot); };
+    node_header* node = _root;
+    size_type order = 0;
+    while (!node->leaf) {
+        auto* internal = static_cast<internal_node*>(node);
+        // the lower and upper bounds are in the child following the separators not greater than the key
+        size_type child = search<true>(internal->keys(), internal->count - 1u, key, key_of_key);
+        for (size_type i = 0; i < child; ++i) {
+            order += internal->counts[i];
+        }
+        node = internal->children[child];
+    }
+    auto* leaf = static_cast<leaf_node*>(node);
+    size_type index = search<KeyIncluded>(leaf->slots(), leaf->count, key, key_of_slot);
+    return {leaf, index, order + index};
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+typename btree<Traits, Compare, Allocator>::leaf_position
+btree<Traits, Compare, Allocator>::position_of_order(size_type order) const {
+    node_header* node = _root;
+    size_type rest = order;
+    while (!node->leaf) {
+        auto* internal = static_cast<internal_node*>(node);
+        size_type child = 0;
+        while (rest >= internal->counts[child]) {
+            rest -= internal->counts[child];
+            ++child;
+        }
+        node = internal->children[child];
+    }
+    return {static_cast<leaf_node*>(node), rest, order};
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+typename btree<Traits, Compare, Allocator>::size_type
+btree<Traits, Compare, Allocator>::order_of(const_iterator it) const {
+    if (it._node == &_end) {
+        return _size;
+    }
+    node_header* node = static_cast<leaf_node*>(it._node);
+    size_type order = it._index;
+    for (internal_node* parent = node->parent; parent != nullptr; node = parent, parent = parent->parent) {
+        for (size_type i = 0; i < node->position; ++i) {
+            order += parent->counts[i];
+        }
+    }
+    return order;
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+typename btree<Traits, Compare, Allocator>::iterator
+btree<Traits, Compare, Allocator>::make_iterator(const leaf_position& position) const {
+    if (position.leaf == nullptr) {
+        return {const_cast<leaf_link*>(&_end), 0};
+    }
+    if (position.index == position.leaf->count) {
+        // the place is after the leaf values, so the next leaf value or the end is there
+        return {position.leaf->next, 0};
+    }
+    return {position.leaf, position.index};
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+template <typename... Args>
+typename btree<Traits, Compare, Allocator>::iterator
+btree<Traits, Compare, Allocator>::insert_at(leaf_node* leaf, size_type index, Args&& ... args) {
+    slot_allocator_type allocator(_allocator);
+    if (leaf == nullptr) {
+        leaf = allocate_leaf();
+        try {
+            slot_traits::construct(allocator, leaf->slots(), std::forward<Args>(args)...);
+        } catch (...) {
+            deallocate_leaf(leaf);
+            throw;
+        }
+        leaf->count = 1;
+        link_leaf_after(&_end, leaf);
+        _root = leaf;
+        _size = 1;
+        return {leaf, 0};
+    }
+    if (leaf->count == leaf_capacity) {
+        std::tie(leaf, index) = split_leaf(leaf, index);
+    }
+    slot_type* slots = leaf->slots();
+    for (size_type i = leaf->count; i > index; --i) {
+        relocate_slot(slots + i, slots + i - 1);
+    }
+    try {
+        slot_traits::construct(allocator, slots + index, std::forward<Args>(args)...);
+    } catch (...) {
+        // the split tree is valid without the value, so only the leaf values are moved back
+        for (size_type i = index; i < leaf->count; ++i) {
+            relocate_slot(slots + i, slots + i + 1);
+        }
+        throw;
+    }
+    ++leaf->count;
+    ++_size;
+    for (node_header* node = leaf; node->parent != nullptr; node = node->parent) {
+        ++node->parent->counts[node->position];
+    }
+    return {leaf, index};
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+std::pair<typename btree<Traits, Compare, Allocator>::leaf_node*, typename btree<Traits, Compare, Allocator>::size_type>
+btree<Traits, Compare, Allocator>::split_leaf(leaf_node* leaf, size_type index) {
+    // full ancestors are split as well, the root split needs a new root
+    size_type internals = 0;
+    internal_node* parent = leaf->parent;
+    while (parent != nullptr && parent->count == internal_capacity) {
+        ++internals;
+        parent = parent->parent;
+    }
+    if (parent == nullptr) {
+        ++internals;
+    }
+    node_reserve reserve(*this);
+    reserve.reserve(internals);
+    // appending to the leaf end moves only the last value, so sequentially filled leaves stay full
+    size_type split = (index == leaf->count ? leaf->count - 1u : leaf->count / 2u);
+    key_type separator(Traits::get_key(leaf->slots()[split]));
+    // the rest can't fail
+    leaf_node* right = reserve.take_leaf();
+    for (size_type i = split; i < leaf->count; ++i) {
+        relocate_slot(right->slots() + (i - split), leaf->slots() + i);
+    }
+    right->count = static_cast<std::uint16_t>(leaf->count - split);
+    leaf->count = static_cast<std::uint16_t>(split);
+    link_leaf_after(leaf, right);
+    insert_child(leaf->parent, leaf->position + 1u, std::move(separator), right, right->count, reserve);
+    if (index <= split) {
+        return {leaf, index};
+    }
+    return {right, index - split};
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+void btree<Traits, Compare, Allocator>::insert_child(internal_node* parent, size_type position, key_type&& separator,
+                                                     node_header* child, size_type child_count,
+                                                     node_reserve& reserve) noexcept {
+    key_allocator_type allocator(_allocator);
+    if (parent == nullptr) {
+        // the root was split
+        internal_node* root = reserve.take_internal();
+        node_header* left = _root;
+        key_traits::construct(allocator, root->keys(), std::move(separator));
+        root->count = 2;
+        set_child(root, 0, left);
+        set_child(root, 1, child);
+        root->counts[0] = _size - child_count;
+        root->counts[1] = child_count;
+        _root = root;
+        return;
+    }
+    internal_node* target = parent;
+    internal_node* right = nullptr;
+    // the separator going up is kept aside, so the insertion into the left half doesn't overwrite it
+    alignas(key_type) unsigned char up_key_storage[sizeof(key_type)];
+    auto* up_key = reinterpret_cast<key_type*>(up_key_storage);
+    if (parent->count == internal_capacity) {
+        // appending to the node end moves only the last child, so sequentially filled nodes stay full
+        size_type split = (position == parent->count ? parent->count - 1u : parent->count / 2u);
+        right = reserve.take_internal();
+        for (size_type i = split; i < parent->count; ++i) {
+            set_child(right, i - split, parent->children[i]);
+            right->counts[i - split] = parent->counts[i];
+            if (i > split) {
+                relocate_key(right->keys() + (i - split - 1), parent->keys() + (i - 1));
+            }
+        }
+        relocate_key(up_key, parent->keys() + (split - 1));
+        right->count = static_cast<std::uint16_t>(parent->count - split);
+        parent->count = static_cast<std::uint16_t>(split);
+        if (position > split) {
+            target = right;
+            position -= split;
+        }
+    }
+    key_type* keys = target->keys();
+    for (size_type i = target->count; i > position; --i) {
+        set_child(target, i, target->children[i - 1]);
+        target->counts[i] = target->counts[i - 1];
+        relocate_key(keys + (i - 1), keys + (i - 2));
+    }
+    key_traits::construct(allocator, keys + (position - 1), std::move(separator));
+    set_child(target, position, child);
+    target->counts[position] = child_count;
+    target->counts[position - 1] -= child_count;
+    ++target->count;
+    if (right != nullptr) {
+        size_type right_count = 0;
+        for (size_type i = 0; i < right->count; ++i) {
+            right_count += right->counts[i];
+        }
+        key_type moved_key(std::move(*up_key));
+        key_traits::destroy(allocator, up_key);
+        insert_child(parent->parent, parent->position + 1u, std::move(moved_key), right, right_count, reserve);
+    }
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+void btree<Traits, Compare, Allocator>::erase_slots(leaf_node* leaf, size_type index, size_type count) noexcept {
+    slot_allocator_type allocator(_allocator);
+    slot_type* slots = leaf->slots();
+    for (size_type i = index; i < index + count; ++i) {
+        slot_traits::destroy(allocator, slots + i);
+    }
+    for (size_type i = index + count; i < leaf->count; ++i) {
+        relocate_slot(slots + (i - count), slots + i);
+    }
+    leaf->count = static_cast<std::uint16_t>(leaf->count - count);
+    _size -= count;
+    for (node_header* node = leaf; node->parent != nullptr; node = node->parent) {
+        node->parent->counts[node->position] -= count;
+    }
+    rebalance(leaf);
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+void btree<Traits, Compare, Allocator>::rebalance(node_header* node) noexcept {
+    while (true) {
+        if (node == _root) {
+            if (node->leaf) {
+                if (node->count == 0) {
+                    unlink_leaf(static_cast<leaf_node*>(node));
+                    deallocate_leaf(static_cast<leaf_node*>(node));
+                    _root = nullptr;
+                }
+                return;
+            }
+            if (node->count > 1) {
+                return;
+            }
+            // the root having the only child is dropped
+            auto* root = static_cast<internal_node*>(node);
+            _root = root->children[0];
+            _root->parent = nullptr;
+            _root->position = 0;
+            deallocate_internal(root);
+            node = _root;
+            continue;
+        }
+        if (node->count >= (node->leaf ? leaf_min_count : internal_min_count)) {
+            return;
+        }
+        internal_node* parent = node->parent;
+        size_type position = node->position;
+        size_type capacity = (node->leaf ? leaf_capacity : internal_capacity);
+        size_type left_count = (position > 0 ? parent->children[position - 1]->count : 0);
+        size_type right_count = (position + 1u < parent->count ? parent->children[position + 1]->count : 0);
+        if (position > 0 && left_count + node->count <= capacity) {
+            merge_children(parent, position - 1);
+        } else if (position + 1u < parent->count && right_count + node->count <= capacity) {
+            merge_children(parent, position);
+        } else {
+            if (!node->leaf) {
+                // internal nodes lose one child at once, so one borrowed child is enough
+                if (left_count >= right_count) {
+                    borrow_from_left(static_cast<internal_node*>(node));
+                } else {
+                    borrow_from_right(static_cast<internal_node*>(node));
+                }
+            }
+            return;
+        }
+        node = parent;
+    }
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+void btree<Traits, Compare, Allocator>::merge_children(internal_node* parent, size_type position) noexcept {
+    key_allocator_type allocator(_allocator);
+    node_header* left = parent->children[position];
+    node_header* right = parent->children[position + 1];
+    key_type* separator = parent->keys() + position;
+    if (left->leaf) {
+        auto* left_leaf = static_cast<leaf_node*>(left);
+        auto* right_leaf = static_cast<leaf_node*>(right);
+        for (size_type i = 0; i < right_leaf->count; ++i) {
+            relocate_slot(left_leaf->slots() + (left_leaf->count + i), right_leaf->slots() + i);
+        }
+        unlink_leaf(right_leaf);
+        key_traits::destroy(allocator, separator);
+    } else {
+        auto* left_internal = static_cast<internal_node*>(left);
+        auto* right_internal = static_cast<internal_node*>(right);
+        // the parent separator goes down between the merged children
+        relocate_key(left_internal->keys() + (left->count - 1), separator);
+        for (size_type i = 0; i < right->count; ++i) {
+            set_child(left_internal, left->count + i, right_internal->children[i]);
+            left_internal->counts[left->count + i] = right_internal->counts[i];
+            if (i > 0) {
+                relocate_key(left_internal->keys() + (left->count + i - 1), right_internal->keys() + (i - 1));
+            }
+        }
+    }
+    left->count = static_cast<std::uint16_t>(left->count + right->count);
+    parent->counts[position] += parent->counts[position + 1];
+    if (right->leaf) {
+        deallocate_leaf(static_cast<leaf_node*>(right));
+    } else {
+        deallocate_internal(static_cast<internal_node*>(right));
+    }
+    key_type* keys = parent->keys();
+    for (size_type i = position + 1; i + 1 < parent->count; ++i) {
+        relocate_key(keys + (i - 1), keys + i);
+        set_child(parent, i, parent->children[i + 1]);
+        parent->counts[i] = parent->counts[i + 1];
+    }
+    --parent->count;
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+void btree<Traits, Compare, Allocator>::borrow_from_left(internal_node* node) noexcept {
+    internal_node* parent = node->parent;
+    size_type position = node->position;
+    auto* left = static_cast<internal_node*>(parent->children[position - 1]);
+    key_type* keys = node->keys();
+    for (size_type i = node->count; i > 0; --i) {
+        set_child(node, i, node->children[i - 1]);
+        node->counts[i] = node->counts[i - 1];
+        if (i > 1) {
+            relocate_key(keys + (i - 1), keys + (i - 2));
+        }
+    }
+    // the parent separator goes down and the left sibling last separator goes up
+    relocate_key(keys, parent->keys() + (position - 1));
+    relocate_key(parent->keys() + (position - 1), left->keys() + (left->count - 2));
+    size_type moved_count = left->counts[left->count - 1];
+    set_child(node, 0, left->children[left->count - 1]);
+    node->counts[0] = moved_count;
+    ++node->count;
+    --left->count;
+    parent->counts[position - 1] -= moved_count;
+    parent->counts[position] += moved_count;
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+void btree<Traits, Compare, Allocator>::borrow_from_right(internal_node* node) noexcept {
+    internal_node* parent = node->parent;
+    size_type position = node->position;
+    auto* right = static_cast<internal_node*>(parent->children[position + 1]);
+    // the parent separator goes down and the right sibling first separator goes up
+    relocate_key(node->keys() + (node->count - 1), parent->keys() + position);
+    relocate_key(parent->keys() + position, right->keys());
+    size_type moved_count = right->counts[0];
+    set_child(node, node->count, right->children[0]);
+    node->counts[node->count] = moved_count;
+    ++node->count;
+    key_type* keys = right->keys();
+    for (size_type i = 0; i + 1 < right->count; ++i) {
+        set_child(right, i, right->children[i + 1]);
+        right->counts[i] = right->counts[i + 1];
+        if (i + 2 < right->count) {
+            relocate_key(keys + i, keys + (i + 1));
+        }
+    }
+    --right->count;
+    parent->counts[position] += moved_count;
+    parent->counts[position + 1] -= moved_count;
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+void btree<Traits, Compare, Allocator>::set_child(internal_node* parent, size_type position, node_header* child) noexcept {
+    parent->children[position] = child;
+    child->parent = parent;
+    child->position = static_cast<std::uint16_t>(position);
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+void btree<Traits, Compare, Allocator>::link_leaf_after(leaf_link* link, leaf_node* leaf) noexcept {
+    leaf_link* leaf_as_link = leaf;
+    leaf_as_link->prev = link;
+    leaf_as_link->next = link->next;
+    link->next->prev = leaf_as_link;
+    link->next = leaf_as_link;
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+void btree<Traits, Compare, Allocator>::unlink_leaf(leaf_node* leaf) noexcept {
+    leaf->prev->next = leaf->next;
+    leaf->next->prev = leaf->prev;
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+void btree<Traits, Compare, Allocator>::relocate_slot(slot_type* destination, slot_type* source) noexcept {
+    slot_allocator_type allocator(_allocator);
+    slot_traits::construct(allocator, destination, std::move(*source));
+    slot_traits::destroy(allocator, source);
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+void btree<Traits, Compare, Allocator>::relocate_key(key_type* destination, key_type* source) noexcept {
+    key_allocator_type allocator(_allocator);
+    key_traits::construct(allocator, destination, std::move(*source));
+    key_traits::destroy(allocator, source);
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+typename btree<Traits, Compare, Allocator>::leaf_node* btree<Traits, Compare, Allocator>::allocate_leaf() {
+    leaf_allocator_type allocator(_allocator);
+    leaf_node* leaf = ::new(static_cast<void*>(leaf_traits::allocate(allocator, 1))) leaf_node;
+    leaf->parent = nullptr;
+    leaf->position = 0;
+    leaf->count = 0;
+    leaf->leaf = true;
+    return leaf;
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+typename btree<Traits, Compare, Allocator>::internal_node* btree<Traits, Compare, Allocator>::allocate_internal() {
+    internal_allocator_type allocator(_allocator);
+    internal_node* node = ::new(static_cast<void*>(internal_traits::allocate(allocator, 1))) internal_node;
+    node->parent = nullptr;
+    node->position = 0;
+    node->count = 0;
+    node->leaf = false;
+    return node;
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+void btree<Traits, Compare, Allocator>::deallocate_leaf(leaf_node* leaf) noexcept {
+    leaf_allocator_type allocator(_allocator);
+    leaf_traits::deallocate(allocator, leaf, 1);
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+void btree<Traits, Compare, Allocator>::deallocate_internal(internal_node* node) noexcept {
+    internal_allocator_type allocator(_allocator);
+    internal_traits::deallocate(allocator, node, 1);
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+void btree<Traits, Compare, Allocator>::destroy_node(node_header* node) noexcept {
+    if (node->leaf) {
+        auto* leaf = static_cast<leaf_node*>(node);
+        slot_allocator_type allocator(_allocator);
+        for (size_type i = 0; i < leaf->count; ++i) {
+            slot_traits::destroy(allocator, leaf->slots() + i);
+        }
+        deallocate_leaf(leaf);
+        return;
+    }
+    auto* internal = static_cast<internal_node*>(node);
+    key_allocator_type allocator(_allocator);
+    for (size_type i = 0; i < internal->count; ++i) {
+        destroy_node(internal->children[i]);
+        if (i > 0) {
+            key_traits::destroy(allocator, internal->keys() + (i - 1));
+        }
+    }
+    deallocate_internal(internal);
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+void btree<Traits, Compare, Allocator>::relink_end() noexcept {
+    if (_root == nullptr) {
+        _end.prev = _end.next = &_end;
+        return;
+    }
+    _end.next->prev = &_end;
+    _end.prev->next = &_end;
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+template <typename... Args>
+std::pair<typename btree<Traits, Compare, Allocator>::iterator, bool>
+btree<Traits, Compare, Allocator>::emplace_with_key(const key_type& key, Args&& ... args) {
+    leaf_position position = find_position<false>(key);
+    if (position.leaf != nullptr && position.index < position.leaf->count &&
+        !_comparator(key, Traits::get_key(position.leaf->slots()[position.index]))) {
+        return {{position.leaf, position.index}, false};
+    }
+    return {insert_at(position.leaf, position.index, std::forward<Args>(args)...), true};
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+void btree<Traits, Compare, Allocator>::swap(btree& other) noexcept {
+    std::swap(_root, other._root);
+    std::swap(_end, other._end);
+    std::swap(_size, other._size);
+    std::swap(_comparator, other._comparator);
+    std::swap(_allocator, other._allocator);
+    relink_end();
+    other.relink_end();
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+void btree<Traits, Compare, Allocator>::clear() noexcept {
+    if (_root != nullptr) {
+        destroy_node(_root);
+    }
+    _root = nullptr;
+    _size = 0;
+    relink_end();
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+template <typename InputIterator>
+void btree<Traits, Compare, Allocator>::insert(InputIterator begin, InputIterator end) {
+    for (; begin != end; ++begin) {
+        insert(*begin);
+    }
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+template <typename... Args>
+std::pair<typename btree<Traits, Compare, Allocator>::iterator, bool>
+btree<Traits, Compare, Allocator>::emplace(Args&& ... args) {
+    slot_type slot(std::forward<Args>(args)...);
+    return emplace_with_key(Traits::get_key(slot), std::move(slot));
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+template <typename InputIterator>
+void btree<Traits, Compare, Allocator>::assign_sorted(InputIterator begin, InputIterator end) {
+    btree result(_comparator, _allocator);
+    for (; begin != end; ++begin) {
+        const slot_type& slot = *begin;
+        auto* last = static_cast<leaf_node*>(result._end.prev);
+        if (result._root == nullptr) {
+            result.insert_at(nullptr, 0, slot);
+        } else if (_comparator(Traits::get_key(last->slots()[last->count - 1]), Traits::get_key(slot))) {
+            result.insert_at(last, last->count, slot);
+        }
+    }
+    swap(result);
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+typename btree<Traits, Compare, Allocator>::iterator
+btree<Traits, Compare, Allocator>::erase_interval(size_type begin, size_type end) noexcept {
+    size_type finish = std::min(end, _size);
+    while (begin < finish) {
+        // the interval part lying in one leaf is erased at once
+        leaf_position position = position_of_order(begin);
+        size_type count = std::min<size_type>(finish - begin, position.leaf->count - position.index);
+        erase_slots(position.leaf, position.index, count);
+        finish -= count;
+    }
+    if (begin >= _size) {
+        return this->end();
+    }
+    return make_iterator(position_of_order(begin));
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+typename btree<Traits, Compare, Allocator>::iterator btree<Traits, Compare, Allocator>::erase(const_iterator it) noexcept {
+    size_type order = order_of(it);
+    return erase_interval(order, order + 1);
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+typename btree<Traits, Compare, Allocator>::iterator
+btree<Traits, Compare, Allocator>::erase(const_iterator begin, const_iterator end) noexcept {
+    return erase_interval(order_of(begin), order_of(end));
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+typename btree<Traits, Compare, Allocator>::iterator
+btree<Traits, Compare, Allocator>::erase_key_interval(const key_type& begin_key, const key_type& end_key) {
+    size_type begin = find_position<false>(begin_key).order;
+    size_type end = find_position<false>(end_key).order;
+    return erase_interval(begin, end);
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+typename btree<Traits, Compare, Allocator>::iterator
+btree<Traits, Compare, Allocator>::erase_key_interval_with_end(const key_type& begin_key, const key_type& end_key) {
+    size_type begin = find_position<false>(begin_key).order;
+    size_type end = find_position<true>(end_key).order;
+    return erase_interval(begin, end);
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+typename btree<Traits, Compare, Allocator>::iterator btree<Traits, Compare, Allocator>::erase_key(const key_type& key) {
+    leaf_position position = find_position<false>(key);
+    if (position.leaf != nullptr && position.index < position.leaf->count &&
+        !_comparator(key, Traits::get_key(position.leaf->slots()[position.index]))) {
+        return erase_interval(position.order, position.order + 1);
+    }
+    return make_iterator(position);
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+typename btree<Traits, Compare, Allocator>::iterator btree<Traits, Compare, Allocator>::find(const key_type& key) {
+    leaf_position position = find_position<false>(key);
+    if (position.leaf != nullptr && position.index < position.leaf->count &&
+        !_comparator(key, Traits::get_key(position.leaf->slots()[position.index]))) {
+        return {position.leaf, position.index};
+    }
+    return end();
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+typename btree<Traits, Compare, Allocator>::const_iterator
+btree<Traits, Compare, Allocator>::find(const key_type& key) const {
+    return const_cast<btree*>(this)->find(key);
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+const typename btree<Traits, Compare, Allocator>::key_type&
+btree<Traits, Compare, Allocator>::key_of_order(size_type index) const {
+    if (index >= _size) {
+        throw std::out_of_range("Index is out of bounds");
+    }
+    leaf_position position = position_of_order(index);
+    return Traits::get_key(position.leaf->slots()[position.index]);
+}
+
+template <typename Traits, typename Compare, typename Allocator>
+typename btree<Traits, Compare, Allocator>::size_type
+btree<Traits, Compare, Allocator>::order_of_key(const key_type& key) const {
+    leaf_position position = find_position<false>(key);
+    if (position.leaf != nullptr && position.index < position.leaf->count &&
+        !_comparator(key, Traits::get_key(position.leaf->slots()[position.index]))) {
+        return position.order;
+    }
+    return _size;
+}
+
+} // namespace nstd
+
+#endif //BASICS_BTREE_HPP
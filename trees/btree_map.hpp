@@ -0,0 +1,132 @@
+#ifndef BASICS_BTREE_MAP_HPP
+#define BASICS_BTREE_MAP_HPP
+
+#include <tuple>
+#include <utility>
+#include <btree.hpp>
+
+namespace nstd {
+
+/**
+ * Leaves keep pairs with mutable keys, so they are relocated between nodes by move
+ * Iterators give them as pairs with constant keys like std::map
+ */
+template <typename Key, typename Value>
+struct btree_map_traits {
+    using key_type = Key;
+    using value_type = std::pair<const Key, Value>;
+    using slot_type = std::pair<Key, Value>;
+
+    static const key_type& get_key(const slot_type& slot) { return slot.first; }
+
+    static value_type& element(slot_type& slot) { return reinterpret_cast<value_type&>(slot); }
+
+    static const value_type& element(const slot_type& slot) { return reinterpret_cast<const value_type&>(slot); }
+};
+
+/**
+ * Ordered map based on B+ tree
+ * Has the same interface as ordered_map without monoid, keeps values in wide nodes, so lookups touch less cache lines
+ * Modifications invalidate iterators
+ */
+template <typename Key, typename Value, typename Compare = std::less<Key>, typename Allocator = std::allocator<Key>>
+class btree_map : public btree<btree_map_traits<Key, Value>, Compare, Allocator> {
+private:
+    using base_type = btree<btree_map_traits<Key, Value>, Compare, Allocator>;
+
+public:
+    using key_type = Key;
+    using value_type = Value;
+    using typename base_type::key_compare;
+    using typename base_type::allocator_type;
+    using typename base_type::size_type;
+
+public:
+    using typename base_type::iterator;
+    using typename base_type::const_iterator;
+    using typename base_type::reverse_iterator;
+    using typename base_type::const_reverse_iterator;
+
+public:
+    using base_type::base_type;
+
+    btree_map(std::initializer_list<std::pair<key_type, value_type>> il,
+              const key_compare& comparator = key_compare(),
+              const allocator_type& allocator = allocator_type())
+            : base_type(comparator, allocator) {
+        base_type::insert(il.begin(), il.end());
+    }
+
+    /**
+     * Builds container from the range sorted by comparator in O(range size) complexity
+     * Keys, which are not greater than the previous one, are skipped
+     * @param begin range begin
+     * @param end range end
+     * @return built container
+     */
+    template <typename InputIterator>
+    static btree_map from_sorted(InputIterator begin, InputIterator end,
+                                 const key_compare& comparator = key_compare(),
+                                 const allocator_type& allocator = allocator_type()) {
+        btree_map result(comparator, allocator);
+        result.assign_sorted(begin, end);
+        return result;
+    }
+
+public:
+    /**
+     * Gives mapped value of the key, inserts default constructed one, when the key is absent
+     * Works in one descent in O(log size) complexity
+     */
+    value_type& operator[](const key_type& key) { return try_emplace(key).first->second; }
+
+    value_type& operator[](key_type&& key) { return try_emplace(std::move(key)).first->second; }
+
+    const value_type& operator[](const key_type& key) const {
+        return base_type::find(key)->second;
+    }
+
+    /**
+     * Inserts value or assigns mapped value of the existing key
+     * @return iterator pointing on the key and true, if the value was inserted
+     */
+    template <typename M>
+    std::pair<iterator, bool> insert_or_assign(const key_type& key, M&& mapped) {
+        auto result = base_type::emplace_with_key(key, key, std::forward<M>(mapped));
+        if (!result.second) {
+            // mapped is forwarded only, when the value is constructed
+            result.first->second = std::forward<M>(mapped);
+        }
+        return result;
+    }
+
+    template <typename M>
+    std::pair<iterator, bool> insert_or_assign(key_type&& key, M&& mapped) {
+        auto result = base_type::emplace_with_key(key, std::move(key), std::forward<M>(mapped));
+        if (!result.second) {
+            result.first->second = std::forward<M>(mapped);
+        }
+        return result;
+    }
+
+    /**
+     * Inserts the value constructed from the key and the mapped value arguments, when the key is absent
+     * Finds the key place in one descent, the arguments are left untouched, when the key is present
+     * @return iterator pointing on the key and true, if the value was inserted
+     */
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const key_type& key, Args&& ... args) {
+        return base_type::emplace_with_key(key, std::piecewise_construct, std::forward_as_tuple(key),
+                                           std::forward_as_tuple(std::forward<Args>(args)...));
+    }
+
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(key_type&& key, Args&& ... args) {
+        return base_type::emplace_with_key(key, std::piecewise_construct, std::forward_as_tuple(std::move(key)),
+                                           std::forward_as_tuple(std::forward<Args>(args)...));
+    }
+};
+
+} // namespace nstd
+
+#endif //BASICS_BTREE_MAP_HPP
@@ -0,0 +1,70 @@
+#ifndef BASICS_BTREE_SET_HPP
+#define BASICS_BTREE_SET_HPP
+
+#include <btree.hpp>
+
+namespace nstd {
+
+template <typename Key>
+struct btree_set_traits {
+    using key_type = Key;
+    using value_type = const Key;
+    using slot_type = Key;
+
+    static const key_type& get_key(const slot_type& slot) { return slot; }
+
+    static const value_type& element(const slot_type& slot) { return slot; }
+};
+
+/**
+ * Ordered set based on B+ tree
+ * Has the same interface as ordered_set, keeps keys in wide nodes, so lookups touch less cache lines
+ * Modifications invalidate iterators
+ */
+template <typename Key, typename Compare = std::less<Key>, typename Allocator = std::allocator<Key>>
+class btree_set : public btree<btree_set_traits<Key>, Compare, Allocator> {
+    using base_type = btree<btree_set_traits<Key>, Compare, Allocator>;
+
+public:
+    using key_type = Key;
+    using value_type = Key;
+    using typename base_type::key_compare;
+    using typename base_type::allocator_type;
+    using typename base_type::size_type;
+
+public:
+    using const_iterator = typename base_type::const_iterator;
+    using iterator = typename base_type::iterator;
+    using const_reverse_iterator = typename base_type::const_reverse_iterator;
+    using reverse_iterator = typename base_type::reverse_iterator;
+
+public:
+    using base_type::base_type;
+
+    btree_set(std::initializer_list<key_type> il,
+              const key_compare& comparator = key_compare(),
+              const allocator_type& allocator = allocator_type())
+            : base_type(comparator, allocator) {
+        base_type::insert(il.begin(), il.end());
+    }
+
+    /**
+     * Builds container from the range sorted by comparator in O(range size) complexity
+     * Keys, which are not greater than the previous one, are skipped
+     * @param begin range begin
+     * @param end range end
+     * @return built container
+     */
+    template <typename InputIterator>
+    static btree_set from_sorted(InputIterator begin, InputIterator end,
+                                 const key_compare& comparator = key_compare(),
+                                 const allocator_type& allocator = allocator_type()) {
+        btree_set result(comparator, allocator);
+        result.assign_sorted(begin, end);
+        return result;
+    }
+};
+
+} // namespace nstd
+
+#endif //BASICS_BTREE_SET_HPP
@@ -0,0 +1,387 @@
+#ifndef BASICS_CONCURRENT_ORDERED_MAP_HPP
+#define BASICS_CONCURRENT_ORDERED_MAP_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <persistent_ordered_map.hpp>
+
+namespace nstd {
+
+/**
+ * Ordered map with lock-free readers
+ * Writers modify persistent treap under the mutex and publish the new root atomically
+ * Readers pin the current version and read it without locks and reference counting,
+ * so they are never blocked by writers and don't share written cache lines with each other
+ * Replaced versions are reclaimed using epoch based reclamation:
+ * version retired in epoch e is released, when all the pinned readers have entered later epochs
+ * All the readers must be destroyed before the map
+ * @tparam Key key type
+ * @tparam Value mapped value type
+ * @tparam Compare comparator type
+ * @tparam Allocator allocator type
+ * @tparam Priority node priority generator, see treap_priority.hpp
+ */
+template <typename Key, typename Value, typename Compare = std::less<Key>,
+        typename Allocator = std::allocator<std::pair<const Key, Value>>, typename Priority = random_priority_generator>
+class concurrent_ordered_map {
+private:
+    using map_type = persistent_ordered_map<Key, Value, Compare, Allocator, Priority>;
+    using view_type = persistent_ordered_map_view<Key, Value, Compare, Allocator>;
+    using node_type = typename view_type::node_type;
+    using epoch_type = unsigned long long;
+
+public:
+    using key_type = Key;
+    using mapped_type = Value;
+    using value_type = typename map_type::value_type;
+    using key_compare = Compare;
+    using allocator_type = Allocator;
+    using size_type = size_t;
+    using snapshot_type = view_type;
+
+    class read_guard;
+
+    class reader;
+
+private:
+    // reader state, each record is placed in its own cache line
+    struct alignas(64) reader_record {
+        // epoch of the pinned reader, 0 when reader is not pinned
+        std::atomic<epoch_type> epoch{0};
+        std::atomic<bool> used{false};
+        reader_record* next = nullptr;
+    };
+
+    struct retired_version {
+        view_type version;
+        epoch_type epoch;
+    };
+
+    // retired versions are reclaimed in batches, so writers don't scan readers on each modification
+    static constexpr size_type reclaim_threshold = 64;
+
+private:
+    // writer version, it's modified only under the writer mutex
+    map_type _map;
+    std::mutex _writer_mutex;
+    std::vector<retired_version> _retired;
+    // the last published version
+    alignas(64) std::atomic<node_type*> _published;
+    std::atomic<size_type> _size;
+    std::atomic<epoch_type> _epoch;
+    // list of reader records, records are reused by new readers and deleted with the map
+    std::atomic<reader_record*> _readers;
+
+public:
+    explicit concurrent_ordered_map(const key_compare& comparator = key_compare(),
+                                    const allocator_type& allocator = allocator_type())
+            : _map(comparator, allocator), _published(nullptr), _size(0), _epoch(1), _readers(nullptr) {}
+
+    concurrent_ordered_map(const concurrent_ordered_map& other) = delete;
+
+    concurrent_ordered_map& operator=(const concurrent_ordered_map& other) = delete;
+
+    ~concurrent_ordered_map();
+
+public:
+    /**
+     * Gives reader handle, which may be used by one thread at once
+     * Handles are supposed to be long living, as their creation scans the reader list
+     */
+    reader make_reader();
+
+    /**
+     * Gives size of the last published version
+     */
+    size_type size() const noexcept { return _size.load(std::memory_order_acquire); }
+
+    bool empty() const noexcept { return size() == 0; }
+
+    /**
+     * Modification functions, they are serialized by the writer mutex
+     * Each modification publishes new version in O(log size) complexity, readers see it with the next pin
+     */
+    bool insert(const std::pair<key_type, mapped_type>& value);
+
+    template <typename... Args>
+    bool emplace(const key_type& key, Args&& ... args);
+
+    template <typename M>
+    bool insert_or_assign(const key_type& key, M&& mapped);
+
+    size_type erase_key(const key_type& key);
+
+    void clear();
+
+    /**
+     * Releases all the retired versions, which are not used by pinned readers anymore
+     */
+    void reclaim();
+
+private:
+    /**
+     * Applies modification to the writer version, publishes the result and retires the previous version
+     */
+    template <typename Modification>
+    auto modify(Modification modification);
+
+    /**
+     * Releases retired versions, which are not used by pinned readers anymore, writer mutex must be locked
+     */
+    void reclaim_retired();
+
+    reader_record* acquire_record();
+};
+
+/**
+ * Pinned version of the map
+ * Gives all the read functions of snapshot without reference counting
+ * Guard doesn't own the pinned version, so the view is inherited privately and its copy, move and swap are hidden
+ * Iterators are valid while the guard is alive
+ */
+template <typename Key, typename Value, typename Compare, typename Allocator, typename Priority>
+class concurrent_ordered_map<Key, Value, Compare, Allocator, Priority>::read_guard : private view_type {
+    friend class reader;
+
+public:
+    using typename view_type::key_type;
+    using typename view_type::mapped_type;
+    using typename view_type::value_type;
+    using typename view_type::key_compare;
+    using typename view_type::allocator_type;
+    using typename view_type::size_type;
+    using typename view_type::difference_type;
+    using typename view_type::const_iterator;
+    using typename view_type::iterator;
+
+private:
+    reader_record* _record;
+
+    read_guard(const concurrent_ordered_map& map, reader_record* record);
+
+public:
+    read_guard(const read_guard& other) = delete;
+
+    read_guard& operator=(const read_guard& other) = delete;
+
+    ~read_guard();
+
+public:
+    using view_type::key_comp;
+    using view_type::get_allocator;
+    using view_type::size;
+    using view_type::empty;
+    using view_type::begin;
+    using view_type::end;
+    using view_type::cbegin;
+    using view_type::cend;
+    using view_type::contains;
+    using view_type::find;
+    using view_type::lower_bound;
+    using view_type::upper_bound;
+    using view_type::key_of_order;
+    using view_type::order_of_key;
+
+    /**
+     * Gives snapshot of the pinned version, which stays valid after unpinning
+     */
+    snapshot_type snapshot() const noexcept { return snapshot_type(*this); }
+};
+
+/**
+ * Reader handle, which owns reader record
+ */
+template <typename Key, typename Value, typename Compare, typename Allocator, typename Priority>
+class concurrent_ordered_map<Key, Value, Compare, Allocator, Priority>::reader {
+    friend class concurrent_ordered_map;
+
+private:
+    const concurrent_ordered_map* _map;
+    reader_record* _record;
+
+    reader(const concurrent_ordered_map* map, reader_record* record) noexcept : _map(map), _record(record) {}
+
+public:
+    reader(const reader& other) = delete;
+
+    reader(reader&& other) noexcept
+            : _map(other._map), _record(std::exchange(other._record, nullptr)) {}
+
+    reader& operator=(const reader& other) = delete;
+
+    reader& operator=(reader&& other) noexcept;
+
+    ~reader();
+
+public:
+    /**
+     * Pins the last published version, which stays alive until the guard is destroyed
+     * Works in O(1) complexity without locks, only one guard of the reader may be alive at once
+     */
+    read_guard pin() const { return read_guard(*_map, _record); }
+};
+
+//======================concurrent_ordered_map implementation==================================
+
+
+template <typename Key, typename Value, typename Compare, typename Allocator, typename Priority>
+concurrent_ordered_map<Key, Value, Compare, Allocator, Priority>::~concurrent_ordered_map() {
+    _retired.clear();
+    reader_record* record = _readers.load(std::memory_order_acquire);
+    while (record != nullptr) {
+        delete std::exchange(record, record->next);
+    }
+}
+
+template <typename Key, typename Value, typename Compare, typename Allocator, typename Priority>
+typename concurrent_ordered_map<Key, Value, Compare, Allocator, Priority>::reader
+concurrent_ordered_map<Key, Value, Compare, Allocator, Priority>::make_reader() {
+    return reader(this, acquire_record());
+}
+
+template <typename Key, typename Value, typename Compare, typename Allocator, typename Priority>
+bool concurrent_ordered_map<Key, Value, Compare, Allocator, Priority>::insert(const std::pair<key_type, mapped_type>& value) {
+    return modify([&](map_type& map) { return map.insert(value); });
+}
+
+template <typename Key, typename Value, typename Compare, typename Allocator, typename Priority>
+template <typename... Args>
+bool concurrent_ordered_map<Key, Value, Compare, Allocator, Priority>::emplace(const key_type& key, Args&& ... args) {
+    return modify([&](map_type& map) { return map.emplace(key, std::forward<Args>(args)...); });
+}
+
+template <typename Key, typename Value, typename Compare, typename Allocator, typename Priority>
+template <typename M>
+bool concurrent_ordered_map<Key, Value, Compare, Allocator, Priority>::insert_or_assign(const key_type& key, M&& mapped) {
+    return modify([&](map_type& map) { return map.insert_or_assign(key, std::forward<M>(mapped)); });
+}
+
+template <typename Key, typename Value, typename Compare, typename Allocator, typename Priority>
+typename concurrent_ordered_map<Key, Value, Compare, Allocator, Priority>::size_type
+concurrent_ordered_map<Key, Value, Compare, Allocator, Priority>::erase_key(const key_type& key) {
+    return modify([&](map_type& map) { return map.erase_key(key); });
+}
+
+template <typename Key, typename Value, typename Compare, typename Allocator, typename Priority>
+void concurrent_ordered_map<Key, Value, Compare, Allocator, Priority>::clear() {
+    modify([](map_type& map) {
+        map.clear();
+        return true;
+    });
+}
+
+template <typename Key, typename Value, typename Compare, typename Allocator, typename Priority>
+void concurrent_ordered_map<Key, Value, Compare, Allocator, Priority>::reclaim() {
+    std::lock_guard<std::mutex> lock(_writer_mutex);
+    reclaim_retired();
+}
+
+template <typename Key, typename Value, typename Compare, typename Allocator, typename Priority>
+template <typename Modification>
+auto concurrent_ordered_map<Key, Value, Compare, Allocator, Priority>::modify(Modification modification) {
+    std::lock_guard<std::mutex> lock(_writer_mutex);
+    // retirement must not fail after publishing, so memory is reserved beforehand
+    if (_retired.size() == _retired.capacity()) {
+        _retired.reserve(std::max(2 * _retired.size(), reclaim_threshold));
+    }
+    // previous version nodes are kept alive for the readers, which may have pinned it
+    view_type previous = _map.snapshot();
+    auto result = modification(_map);
+    node_type* root = static_cast<const view_type&>(_map)._root;
+    if (root == previous._root) {
+        return result;
+    }
+    _published.store(root, std::memory_order_seq_cst);
+    _size.store(_map.size(), std::memory_order_release);
+    // readers pinned with the later epochs see the new version
+    epoch_type epoch = _epoch.fetch_add(1, std::memory_order_seq_cst);
+    _retired.push_back({std::move(previous), epoch});
+    if (_retired.size() >= reclaim_threshold) {
+        reclaim_retired();
+    }
+    return result;
+}
+
+template <typename Key, typename Value, typename Compare, typename Allocator, typename Priority>
+void concurrent_ordered_map<Key, Value, Compare, Allocator, Priority>::reclaim_retired() {
+    epoch_type min_epoch = _epoch.load(std::memory_order_seq_cst);
+    for (reader_record* record = _readers.load(std::memory_order_acquire); record != nullptr; record = record->next) {
+        epoch_type epoch = record->epoch.load(std::memory_order_seq_cst);
+        if (epoch != 0 && epoch < min_epoch) {
+            min_epoch = epoch;
+        }
+    }
+    // versions are retired in increasing epoch order
+    auto it = _retired.begin();
+    while (it != _retired.end() && it->epoch < min_epoch) {
+        ++it;
+    }
+    _retired.erase(_retired.begin(), it);
+}
+
+template <typename Key, typename Value, typename Compare, typename Allocator, typename Priority>
+typename concurrent_ordered_map<Key, Value, Compare, Allocator, Priority>::reader_record*
+concurrent_ordered_map<Key, Value, Compare, Allocator, Priority>::acquire_record() {
+    // reuse record of the destroyed reader
+    for (reader_record* record = _readers.load(std::memory_order_acquire); record != nullptr; record = record->next) {
+        bool used = false;
+        if (!record->used.load(std::memory_order_relaxed) &&
+            record->used.compare_exchange_strong(used, true, std::memory_order_acquire)) {
+            return record;
+        }
+    }
+    auto* record = new reader_record();
+    record->used.store(true, std::memory_order_relaxed);
+    record->next = _readers.load(std::memory_order_relaxed);
+    while (!_readers.compare_exchange_weak(record->next, record, std::memory_order_release,
+                                           std::memory_order_relaxed)) {}
+    return record;
+}
+
+//======================read_guard implementation==============================================
+
+
+template <typename Key, typename Value, typename Compare, typename Allocator, typename Priority>
+concurrent_ordered_map<Key, Value, Compare, Allocator, Priority>::read_guard::read_guard(const concurrent_ordered_map& map,
+                                                                              reader_record* record)
+        : view_type(map._map.key_comp(), map._map.get_allocator()), _record(record) {
+    // epoch is announced before the root is read, so the writer doesn't release the read version
+    _record->epoch.store(map._epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+    view_type::_root = map._published.load(std::memory_order_seq_cst);
+}
+
+template <typename Key, typename Value, typename Compare, typename Allocator, typename Priority>
+concurrent_ordered_map<Key, Value, Compare, Allocator, Priority>::read_guard::~read_guard() {
+    // pinned version is not owned by the guard
+    view_type::_root = nullptr;
+    _record->epoch.store(0, std::memory_order_release);
+}
+
+//======================reader implementation==================================================
+
+
+template <typename Key, typename Value, typename Compare, typename Allocator, typename Priority>
+typename concurrent_ordered_map<Key, Value, Compare, Allocator, Priority>::reader&
+concurrent_ordered_map<Key, Value, Compare, Allocator, Priority>::reader::operator=(reader&& other) noexcept {
+    if (this != &other) {
+        reader moved(std::move(other));
+        std::swap(_map, moved._map);
+        std::swap(_record, moved._record);
+    }
+    return *this;
+}
+
+template <typename Key, typename Value, typename Compare, typename Allocator, typename Priority>
+concurrent_ordered_map<Key, Value, Compare, Allocator, Priority>::reader::~reader() {
+    if (_record != nullptr) {
+        _record->used.store(false, std::memory_order_release);
+    }
+}
+
+} // namespace nstd
+
+#endif //BASICS_CONCURRENT_ORDERED_MAP_HPP
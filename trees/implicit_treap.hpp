@@ -1,15 +1,78 @@
 #ifndef BASICS_IMPLICIT_TREAP_BASE_H
 #define BASICS_IMPLICIT_TREAP_BASE_H
 
+#include <algorithm>
+#include <type_traits>
 #include <utility>
+#include <monoid.hpp>
 #include <treap_base.hpp>
 
 namespace nstd {
 
-template <typename T>
-class implicit_treap_node : public treap_node_base<implicit_treap_node<T>> {
+/**
+ * Aggregate of the reversed subtree, which is swapped with the subtree aggregate on reversal
+ * Storage is empty for commutative monoids, since their aggregates don't depend on the element order
+ */
+template <typename Aggregate, bool Commutative>
+class implicit_treap_reversed_aggregate {
+protected:
+    Aggregate _reversed_aggregate;
+};
+
+template <typename Aggregate>
+class implicit_treap_reversed_aggregate<Aggregate, true> {
+};
+
+/**
+ * Lazy action state of implicit treap node
+ * Keeps the subtree aggregate and the action pending for the children, storage is empty, when there are no operations
+ * @tparam Operations operations class, see add_assign_operations for the required members
+ */
+template <typename Operations>
+class implicit_treap_node_actions
+        : public implicit_treap_reversed_aggregate<typename Operations::aggregate_type,
+                                                   is_commutative_monoid_v<typename Operations::monoid_type>> {
+public:
+    using operations_type = Operations;
+    using aggregate_type = typename Operations::aggregate_type;
+    using action_type = typename Operations::action_type;
+
+    static constexpr bool has_reversed_aggregate = !is_commutative_monoid_v<typename Operations::monoid_type>;
+
+    // node memory is initialized member-wise without constructor call
+    static_assert(std::is_trivially_copyable_v<aggregate_type> && std::is_trivially_copyable_v<action_type>,
+                  "Aggregate and action types must be trivially copyable");
+
+public:
+    const aggregate_type& get_aggregate() const { return _aggregate; }
+
+    /**
+     * Gives the aggregate of the subtree elements taken in reversed order
+     */
+    const aggregate_type& get_reversed_aggregate() const {
+        if constexpr (has_reversed_aggregate) {
+            return this->_reversed_aggregate;
+        } else {
+            return _aggregate;
+        }
+    }
+
+protected:
+    aggregate_type _aggregate;
+    action_type _action;
+};
+
+template <>
+class implicit_treap_node_actions<void> {
+public:
+    static constexpr bool has_reversed_aggregate = false;
+};
+
+template <typename T, typename Operations = void, typename Layout = default_treap_layout>
+class implicit_treap_node : public treap_node_base<implicit_treap_node<T, Operations, Layout>, Layout>,
+                            public implicit_treap_node_actions<Operations> {
 private:
-    using base_type = treap_node_base<implicit_treap_node<T>>;
+    using base_type = treap_node_base<implicit_treap_node<T, Operations, Layout>, Layout>;
     using typename base_type::priority_type;
     using typename base_type::size_type;
 public:
@@ -20,7 +83,10 @@ public:
                                  implicit_treap_node* left = nullptr,
                                  implicit_treap_node* right = nullptr,
                                  implicit_treap_node* parent = nullptr)
-            : base_type(priority, left, right), _value(value) {}
+            : base_type(priority, left, right), _value(value) {
+        reset_action();
+        update_aggregate();
+    }
 
     const value_type* get_value_address() const { return std::addressof(_value); }
 
@@ -30,14 +96,128 @@ public:
 
     const value_type& get_value() const { return _value; }
 
+public:
+    // reverse flag is always supported, so the node always has actions
+    static constexpr bool has_actions = true;
+
+    static constexpr bool has_operations = !std::is_void_v<Operations>;
+
+    using implicit_treap_node_actions<Operations>::has_reversed_aggregate;
+
+    /**
+     * Gives the node value converted into the aggregate
+     */
+    template <typename O = Operations>
+    typename O::aggregate_type get_own_aggregate() const { return Operations::lift(_value); }
+
+    /**
+     * Applies action to the node value and aggregate, action becomes pending for the children
+     */
+    template <typename O = Operations>
+    void apply_action(const typename O::action_type& action) {
+        Operations::apply(_value, action);
+        this->_aggregate = Operations::apply(this->_aggregate, action, base_type::size());
+        if constexpr (has_reversed_aggregate) {
+            this->_reversed_aggregate = Operations::apply(this->_reversed_aggregate, action, base_type::size());
+        }
+        this->_action = Operations::compose(this->_action, action);
+    }
+
+    /**
+     * Reverses the subtree, the children are swapped at once and their subtrees are reversed lazily
+     * Aggregate of non-commutative monoid is swapped with the reversed one, commutative aggregate is kept as is
+     */
+    void reverse() {
+        base_type::swap_children();
+        _reversed = !_reversed;
+        if constexpr (has_reversed_aggregate) {
+            std::swap(this->_aggregate, this->_reversed_aggregate);
+        }
+    }
+
+    void push() {
+        if (_reversed) {
+            if (base_type::get_left() != nullptr) {
+                base_type::get_left()->reverse();
+            }
+            if (base_type::get_right() != nullptr) {
+                base_type::get_right()->reverse();
+            }
+            _reversed = false;
+        }
+        if constexpr (has_operations) {
+            if (Operations::is_identity(this->_action)) {
+                return;
+            }
+            if (base_type::get_left() != nullptr) {
+                base_type::get_left()->apply_action(this->_action);
+            }
+            if (base_type::get_right() != nullptr) {
+                base_type::get_right()->apply_action(this->_action);
+            }
+            this->_action = Operations::identity_action();
+        }
+    }
+
+    void reset_action() {
+        _reversed = false;
+        if constexpr (has_operations) {
+            this->_action = Operations::identity_action();
+        }
+    }
+
+    /**
+     * Folds the subtree values, is called by update function, children must not have actions pending from this node
+     */
+    void update_aggregate() {
+        if constexpr (has_operations) {
+            using monoid_type = typename Operations::monoid_type;
+            auto aggregate = get_own_aggregate();
+            if (base_type::get_left() != nullptr) {
+                aggregate = monoid_type::combine(base_type::get_left()->get_aggregate(), aggregate);
+            }
+            if (base_type::get_right() != nullptr) {
+                aggregate = monoid_type::combine(aggregate, base_type::get_right()->get_aggregate());
+            }
+            this->_aggregate = aggregate;
+        }
+        if constexpr (has_reversed_aggregate) {
+            using monoid_type = typename Operations::monoid_type;
+            auto reversed_aggregate = get_own_aggregate();
+            if (base_type::get_right() != nullptr) {
+                reversed_aggregate = monoid_type::combine(base_type::get_right()->get_reversed_aggregate(),
+                                                          reversed_aggregate);
+            }
+            if (base_type::get_left() != nullptr) {
+                reversed_aggregate = monoid_type::combine(reversed_aggregate,
+                                                          base_type::get_left()->get_reversed_aggregate());
+            }
+            this->_reversed_aggregate = reversed_aggregate;
+        }
+    }
+
 private:
+    // children subtrees are pending to be reversed
+    bool _reversed;
     value_type _value;
 };
 
-template <typename T, typename Allocator>
-class implicit_treap : public treap_base<implicit_treap_node<T>, Allocator> {
-    using base_type = treap_base<implicit_treap_node<T>, Allocator>;
-    using treap_node = implicit_treap_node<T>;
+/**
+ * Implicit treap
+ * Reversals and interval actions stay pending in the subtrees, const functions (iteration, operator[], aggregate_interval)
+ * apply the pending ones on the visited nodes, so they are not thread safe after these modifications,
+ * until apply_pending is called
+ * @tparam Operations optional operations class for lazy interval actions and interval aggregates,
+ * see add_assign_operations for the required members
+ * @tparam Priority node priority generator, see treap_priority.hpp
+ * @tparam Layout node layout, see default_treap_layout and narrow_treap_layout
+ */
+template <typename T, typename Allocator, typename Operations = void, typename Priority = random_priority_generator,
+        typename Layout = default_treap_layout, typename Statistics = no_treap_statistics>
+class implicit_treap
+        : public treap_base<implicit_treap_node<T, Operations, Layout>, Allocator, Priority, Statistics> {
+    using base_type = treap_base<implicit_treap_node<T, Operations, Layout>, Allocator, Priority, Statistics>;
+    using treap_node = implicit_treap_node<T, Operations, Layout>;
 public:
     using typename base_type::value_type;
     using typename base_type::allocator_type;
@@ -45,6 +225,7 @@ public:
 
 private:
     using typename base_type::node_holder;
+    using typename base_type::tree_builder;
 
 private:
     using base_type::_end;
@@ -61,6 +242,15 @@ public:
 public:
     explicit implicit_treap(const allocator_type& allocator = allocator_type());
 
+    /**
+     * Constructs the tree from the range in O(range size) complexity
+     * @param begin range begin
+     * @param end range end
+     * @param allocator allocator
+     */
+    template <typename InputIterator>
+    implicit_treap(InputIterator begin, InputIterator end, const allocator_type& allocator = allocator_type());
+
     implicit_treap(const implicit_treap& other);
 
     implicit_treap(implicit_treap&& other) noexcept;
@@ -84,6 +274,17 @@ private:
      */
     iterator insert_tree_at(treap_node* tree, size_type index);
 
+    /**
+     * Builds standalone tree from the range in O(range size) complexity
+     * Nodes are appended to the right spine in their order, so no split or merge is needed
+     * If value construction throws, already built nodes are destroyed
+     * @param begin range begin
+     * @param end range end
+     * @return root of the built tree, nullptr for empty range
+     */
+    template <typename InputIterator>
+    treap_node* build_tree(InputIterator begin, InputIterator end);
+
 public:
     iterator insert(size_type index, const value_type& value);
 
@@ -93,6 +294,16 @@ public:
 
     iterator insert(const_iterator position, value_type&& value);
 
+    /**
+     * Inserts range values before the index
+     * Working complexity is O(range size + log size)
+     * If index > size, function will change it with size
+     * Provides strong exception safety
+     * @param index index
+     * @param begin range begin
+     * @param end range end
+     * @return iterator pointing the first inserted element, or the element at index, when range is empty
+     */
     template <typename InputIterator>
     iterator insert(size_type index, InputIterator begin, InputIterator end);
 
@@ -103,6 +314,28 @@ public:
 
     iterator insert(const_iterator position, std::initializer_list<value_type> il);
 
+    /**
+     * Replaces the content with the range values
+     * Working complexity is O(range size + size)
+     * Provides strong exception safety
+     * @param begin range begin
+     * @param end range end
+     */
+    template <typename InputIterator>
+    void assign(InputIterator begin, InputIterator end);
+
+    void assign(std::initializer_list<value_type> il);
+
+    /**
+     * Replaces the content with the data written by save function
+     * Working complexity is O(stream size + size)
+     * Stored priorities are used when they are present, so the tree gets the saved shape
+     * Provides strong exception safety
+     * @param stream input stream
+     * Throws serialization_error, when the stream data is invalid
+     */
+    void load(std::istream& stream);
+
     template <typename... Args>
     iterator emplace(size_type index, Args&& ... args);
 
@@ -234,30 +467,145 @@ public:
      */
     void reverse_shift_interval(const_iterator begin, const_iterator end, size_type count = 1) noexcept;
 
+    /**
+     * Reverses vector content
+     * Works in O (log size) complexity, reversal stays pending in the subtrees until their nodes are visited
+     * Interval aggregates keep the element order after reversal, non-commutative monoids are supported
+     * by keeping the reversed aggregate in each node, see is_commutative_monoid
+     */
+    void reverse() noexcept;
+
+    /**
+     * Reverses vector interval content
+     * Works in O (log size) complexity non-depending on interval size
+     * If end > size, function will change it with size
+     * If begin >= end nothing happens
+     * Iterators to the interval elements taken before the call keep showing the same elements and have proper order,
+     * but they must be taken again before moving
+     * Interval aggregates keep the element order after reversal as in reverse function
+     * @param begin interval begin (inclusive endpoint)
+     * @param end interval end (exclusive endpoint)
+     */
+    void reverse_interval(size_type begin, size_type end) noexcept;
+
+    /**
+     * Calls reverse_interval for indexes
+     * Passed iterators remain showing at the same elements, which they were showing before function call
+     * @param begin begin
+     * @param end end
+     */
+    void reverse_interval(const_iterator begin, const_iterator end) noexcept;
+
+    /**
+     * Applies all the pending reversals and interval actions in O (size) complexity
+     * Afterwards const functions don't modify the tree until the next reversal or interval action,
+     * so they may be called concurrently
+     */
+    void apply_pending() noexcept;
+
+public:
+    /**
+     * Applies the action to all the elements of the interval
+     * Works in O (log size) complexity, action stays pending in the interval subtree until its nodes are visited
+     * If end > size, function will change it with size
+     * If begin >= end nothing happens
+     * Iterators taken before the call may show not updated values of the interval elements
+     * Is available only for trees with operations
+     * @param begin begin (inclusive endpoint)
+     * @param end end (exclusive endpoint)
+     * @param action action
+     */
+    template <typename O = Operations>
+    void apply_interval(size_type begin, size_type end, const typename O::action_type& action);
+
+    template <typename O = Operations>
+    void apply_interval(const_iterator begin, const_iterator end, const typename O::action_type& action);
+
+    /**
+     * Adds delta to all the elements of the interval in O (log size) complexity
+     * Is available only for operations providing add action
+     */
+    template <typename O = Operations>
+    void add_interval(size_type begin, size_type end, const value_type& delta) {
+        apply_interval(begin, end, O::add(delta));
+    }
+
+    template <typename O = Operations>
+    void add_interval(const_iterator begin, const_iterator end, const value_type& delta) {
+        apply_interval(begin, end, O::add(delta));
+    }
+
+    /**
+     * Assigns value to all the elements of the interval in O (log size) complexity
+     * Is available only for operations providing assign action
+     */
+    template <typename O = Operations>
+    void assign_interval(size_type begin, size_type end, const value_type& value) {
+        apply_interval(begin, end, O::assign(value));
+    }
+
+    template <typename O = Operations>
+    void assign_interval(const_iterator begin, const_iterator end, const value_type& value) {
+        apply_interval(begin, end, O::assign(value));
+    }
+
+    /**
+     * Folds the elements of the interval in their order
+     * Works in O (log size) complexity without changing the tree structure
+     * If end > size, function will change it with size
+     * Is available only for trees with operations
+     * @param begin begin (inclusive endpoint)
+     * @param end end (exclusive endpoint)
+     * @return aggregate, monoid identity for the empty interval
+     */
+    template <typename O = Operations>
+    typename O::aggregate_type aggregate_interval(size_type begin, size_type end) const;
+
+    template <typename O = Operations>
+    typename O::aggregate_type aggregate_interval(const_iterator begin, const_iterator end) const {
+        return aggregate_interval(begin.order(), end.order());
+    }
+
+    /**
+     * Gives aggregate of all the elements in O (1) complexity
+     */
+    template <typename O = Operations>
+    typename O::aggregate_type aggregate() const {
+        return (root() != nullptr ? root()->get_aggregate() : O::monoid_type::identity());
+    }
+
 public:
     using base_type::size;
     using base_type::empty;
 };
 
-template <typename Node, typename Allocator>
-implicit_treap<Node, Allocator>::implicit_treap(const allocator_type& allocator)
+template <typename Node, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+implicit_treap<Node, Allocator, Operations, Priority, Layout, Statistics>::implicit_treap(const allocator_type& allocator)
         : base_type(allocator) {}
 
-template <typename Node, typename Allocator>
-implicit_treap<Node, Allocator>::implicit_treap(const implicit_treap& other)
+template <typename Node, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+template <typename InputIterator>
+implicit_treap<Node, Allocator, Operations, Priority, Layout, Statistics>::implicit_treap(InputIterator begin, InputIterator end,
+                                                            const allocator_type& allocator)
+        : base_type(allocator) {
+    set_root(build_tree(begin, end));
+    base_type::adjust_begin();
+}
+
+template <typename Node, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+implicit_treap<Node, Allocator, Operations, Priority, Layout, Statistics>::implicit_treap(const implicit_treap& other)
         : base_type(other) {
-    for (auto it = other.begin(); it != other.end(); ++it) {
-        emplace_back(*it);
-    }
+    set_root(build_tree(other.begin(), other.end()));
+    base_type::adjust_begin();
 }
 
-template <typename Node, typename Allocator>
-implicit_treap<Node, Allocator>::implicit_treap(implicit_treap&& other) noexcept
+template <typename Node, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+implicit_treap<Node, Allocator, Operations, Priority, Layout, Statistics>::implicit_treap(implicit_treap&& other) noexcept
         : base_type(std::move(other)) {}
 
-template <typename Node, typename Allocator>
-implicit_treap<Node, Allocator>&
-implicit_treap<Node, Allocator>::operator=(const implicit_treap& other) {
+template <typename Node, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+implicit_treap<Node, Allocator, Operations, Priority, Layout, Statistics>&
+implicit_treap<Node, Allocator, Operations, Priority, Layout, Statistics>::operator=(const implicit_treap& other) {
     if (this != &other) {
         implicit_treap copied(other);
         this->swap(copied);
@@ -265,9 +613,9 @@ implicit_treap<Node, Allocator>::operator=(const implicit_treap& other) {
     return *this;
 }
 
-template <typename Node, typename Allocator>
-implicit_treap<Node, Allocator>&
-implicit_treap<Node, Allocator>::operator=(implicit_treap&& other) noexcept {
+template <typename Node, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+implicit_treap<Node, Allocator, Operations, Priority, Layout, Statistics>&
+implicit_treap<Node, Allocator, Operations, Priority, Layout, Statistics>::operator=(implicit_treap&& other) noexcept {
     if (this != &other) {
         implicit_treap moved(std::move(other));
         this->swap(moved);
@@ -275,9 +623,9 @@ implicit_treap<Node, Allocator>::operator=(implicit_treap&& other) noexcept {
     return *this;
 }
 
-template <typename T, typename Allocator>
-typename implicit_treap<T, Allocator>::iterator
-implicit_treap<T, Allocator>::insert_tree_at(treap_node* tree, size_type index) {
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+typename implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::iterator
+implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::insert_tree_at(treap_node* tree, size_type index) {
     if (tree == nullptr) {
         return base_type::end();
     }
@@ -291,64 +639,103 @@ implicit_treap<T, Allocator>::insert_tree_at(treap_node* tree, size_type index)
     return {tree_begin};
 }
 
-template <typename T, typename Allocator>
-typename implicit_treap<T, Allocator>::iterator
-implicit_treap<T, Allocator>::insert(size_type index, const value_type& value) {
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+template <typename InputIterator>
+typename implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::treap_node*
+implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::build_tree(InputIterator begin, InputIterator end) {
+    tree_builder builder;
+    try {
+        for (; begin != end; ++begin) {
+            builder.push_back(base_type::construct_node(*begin).release());
+        }
+    } catch (...) {
+        base_type::destroy_tree(builder.release());
+        throw;
+    }
+    return builder.release();
+}
+
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+typename implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::iterator
+implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::insert(size_type index, const value_type& value) {
     return emplace(index, value);
 }
 
-template <typename T, typename Allocator>
-typename implicit_treap<T, Allocator>::iterator
-implicit_treap<T, Allocator>::insert(const_iterator position, const value_type& value) {
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+typename implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::iterator
+implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::insert(const_iterator position, const value_type& value) {
     return emplace(position.order(), value);
 }
 
-template <typename T, typename Allocator>
-typename implicit_treap<T, Allocator>::iterator
-implicit_treap<T, Allocator>::insert(size_type index, value_type&& value) {
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+typename implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::iterator
+implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::insert(size_type index, value_type&& value) {
     return emplace(index, std::move(value));
 }
 
-template <typename T, typename Allocator>
-typename implicit_treap<T, Allocator>::iterator
-implicit_treap<T, Allocator>::insert(const_iterator position, value_type&& value) {
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+typename implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::iterator
+implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::insert(const_iterator position, value_type&& value) {
     return emplace(position.order(), std::move(value));
 }
 
-template <typename T, typename Allocator>
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
 template <typename InputIterator>
-typename implicit_treap<T, Allocator>::iterator
-implicit_treap<T, Allocator>::insert(size_type index, InputIterator begin, InputIterator end) {
-    iterator result = base_type::begin() + index;
-    for (; begin != end; ++begin, ++index) {
-        result = emplace(index, *begin);
+typename implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::iterator
+implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::insert(size_type index, InputIterator begin, InputIterator end) {
+    index = std::min(index, size());
+    treap_node* tree = build_tree(begin, end);
+    if (tree == nullptr) {
+        return base_type::begin() + index;
     }
-    return result;
+    return insert_tree_at(tree, index);
 }
 
-template <typename T, typename Allocator>
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
 template <typename InputIterator>
-typename implicit_treap<T, Allocator>::iterator
-implicit_treap<T, Allocator>::insert(const_iterator position, InputIterator begin, InputIterator end) {
+typename implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::iterator
+implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::insert(const_iterator position, InputIterator begin, InputIterator end) {
     return insert(position.order(), begin, end);
 }
 
-template <typename T, typename Allocator>
-typename implicit_treap<T, Allocator>::iterator
-implicit_treap<T, Allocator>::insert(size_type index, std::initializer_list<value_type> il) {
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+typename implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::iterator
+implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::insert(size_type index, std::initializer_list<value_type> il) {
     return insert(index, il.begin(), il.end());
 }
 
-template <typename T, typename Allocator>
-typename implicit_treap<T, Allocator>::iterator
-implicit_treap<T, Allocator>::insert(const_iterator position, std::initializer_list<value_type> il) {
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+typename implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::iterator
+implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::insert(const_iterator position, std::initializer_list<value_type> il) {
     return insert(position.order(), il.begin(), il.end());
 }
 
-template <typename T, typename Allocator>
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+template <typename InputIterator>
+void implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::assign(InputIterator begin, InputIterator end) {
+    treap_node* tree = build_tree(begin, end);
+    base_type::destroy_tree(root());
+    set_root(tree);
+    base_type::adjust_begin();
+}
+
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+void implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::assign(std::initializer_list<value_type> il) {
+    assign(il.begin(), il.end());
+}
+
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+void implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::load(std::istream& stream) {
+    treap_node* tree = base_type::read_tree(stream, [](const treap_node*, const treap_node*) { return true; });
+    base_type::destroy_tree(root());
+    set_root(tree);
+    base_type::adjust_begin();
+}
+
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
 template <typename ...Args>
-typename implicit_treap<T, Allocator>::iterator
-implicit_treap<T, Allocator>::emplace(size_type index, Args&& ...args) {
+typename implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::iterator
+implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::emplace(size_type index, Args&& ...args) {
     if (index > size()) {
         index = size();
     }
@@ -361,68 +748,72 @@ implicit_treap<T, Allocator>::emplace(size_type index, Args&& ...args) {
     return it;
 }
 
-template <typename T, typename Allocator>
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
 template <typename ...Args>
-typename implicit_treap<T, Allocator>::iterator
-implicit_treap<T, Allocator>::emplace(const_iterator position, Args&& ...args) {
+typename implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::iterator
+implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::emplace(const_iterator position, Args&& ...args) {
     return emplace(position.order(), std::forward<Args>(args)...);
 }
 
-template <typename T, typename Allocator>
-void implicit_treap<T, Allocator>::push_back(const value_type& value) {
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+void implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::push_back(const value_type& value) {
     emplace_back(value);
 }
 
-template <typename T, typename Allocator>
-void implicit_treap<T, Allocator>::push_back(value_type&& value) {
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+void implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::push_back(value_type&& value) {
     emplace_back(std::move(value));
 }
 
-template <typename T, typename Allocator>
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
 template <typename ...Args>
-typename implicit_treap<T, Allocator>::value_type& implicit_treap<T, Allocator>::emplace_back(Args&& ...args) {
+typename implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::value_type& implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::emplace_back(Args&& ...args) {
     return *emplace(size(), std::forward<Args>(args)...);
 }
 
-template <typename T, typename Allocator>
-void implicit_treap<T, Allocator>::push_front(const value_type& value) {
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+void implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::push_front(const value_type& value) {
     return emplace_front(value);
 }
 
-template <typename T, typename Allocator>
-void implicit_treap<T, Allocator>::push_front(value_type&& value) {
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+void implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::push_front(value_type&& value) {
     emplace_front(std::move(value));
 }
 
-template <typename T, typename Allocator>
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
 template <typename ...Args>
-typename implicit_treap<T, Allocator>::value_type& implicit_treap<T, Allocator>::emplace_front(Args&& ...args) {
+typename implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::value_type& implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::emplace_front(Args&& ...args) {
     return *emplace(0, std::forward<Args>(args)...);
 }
 
-template <typename T, typename Allocator>
-void implicit_treap<T, Allocator>::pop_back() {
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+void implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::pop_back() {
     erase_index(size() - 1);
 }
 
-template <typename T, typename Allocator>
-void implicit_treap<T, Allocator>::pop_front() {
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+void implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::pop_front() {
     erase_index(0);
 }
 
-template <typename T, typename Allocator>
-typename implicit_treap<T, Allocator>::value_type& implicit_treap<T, Allocator>::operator[](size_type index) {
-    return *(base_type::begin() + index);
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+typename implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::value_type& implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::operator[](size_type index) {
+    auto it = base_type::begin() + index;
+    base_type::count_path(base_type::iterator_node(it));
+    return *it;
 }
 
-template <typename T, typename Allocator>
-const typename implicit_treap<T, Allocator>::value_type&
-implicit_treap<T, Allocator>::operator[](size_type index) const {
-    return *(base_type::cbegin() + index);
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+const typename implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::value_type&
+implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::operator[](size_type index) const {
+    auto it = base_type::cbegin() + index;
+    base_type::count_path(base_type::iterator_node(it));
+    return *it;
 }
 
-template <typename T, typename Allocator>
-void implicit_treap<T, Allocator>::exchange_intervals(size_type begin1, size_type end1,
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+void implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::exchange_intervals(size_type begin1, size_type end1,
                                                       size_type begin2, size_type end2) noexcept {
     end1 = std::min(end1, size());
     end2 = std::min(end2, size());
@@ -448,36 +839,36 @@ void implicit_treap<T, Allocator>::exchange_intervals(size_type begin1, size_typ
     insert_tree_at(interval1, begin2 + (end2 - begin2) - (end1 - begin1));
 }
 
-template <typename T, typename Allocator>
-void implicit_treap<T, Allocator>::exchange_intervals(const_iterator begin1, const_iterator end1,
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+void implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::exchange_intervals(const_iterator begin1, const_iterator end1,
                                                       const_iterator begin2, const_iterator end2) noexcept {
     exchange_intervals(begin1.order(), end1.order(), begin2.order(), end2.order());
 }
 
-template <typename T, typename Allocator>
-void implicit_treap<T, Allocator>::move_interval_to_index(size_type begin, size_type end, size_type index) noexcept {
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+void implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::move_interval_to_index(size_type begin, size_type end, size_type index) noexcept {
     exchange_intervals(begin, end, index, index);
 }
 
-template <typename T, typename Allocator>
-void implicit_treap<T, Allocator>::move_interval_to_index(const_iterator begin, const_iterator end,
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+void implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::move_interval_to_index(const_iterator begin, const_iterator end,
                                                           const_iterator it) noexcept {
     exchange_intervals(begin, end, it, it);
 }
 
-template <typename T, typename Allocator>
-void implicit_treap<T, Allocator>::shift(size_type count) noexcept {
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+void implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::shift(size_type count) noexcept {
     shift_interval(0, size(), count);
 }
 
-template <typename T, typename Allocator>
-implicit_treap<T, Allocator>& implicit_treap<T, Allocator>::operator>>=(size_type count) noexcept {
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>& implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::operator>>=(size_type count) noexcept {
     shift(count);
     return *this;
 }
 
-template <typename T, typename Allocator>
-void implicit_treap<T, Allocator>::shift_interval(size_type begin, size_type end, size_type count) noexcept {
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+void implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::shift_interval(size_type begin, size_type end, size_type count) noexcept {
     if (begin >= end) {
         return;
     }
@@ -488,24 +879,24 @@ void implicit_treap<T, Allocator>::shift_interval(size_type begin, size_type end
     exchange_intervals(begin, end - count, end - count, end);
 }
 
-template <typename T, typename Allocator>
-void implicit_treap<T, Allocator>::shift_interval(const_iterator begin, const_iterator end, size_type count) noexcept {
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+void implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::shift_interval(const_iterator begin, const_iterator end, size_type count) noexcept {
     shift_interval(begin.order(), end.order(), count);
 }
 
-template <typename T, typename Allocator>
-void implicit_treap<T, Allocator>::reverse_shift(size_type count) noexcept {
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+void implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::reverse_shift(size_type count) noexcept {
     reverse_shift_interval(0, size(), count);
 }
 
-template <typename T, typename Allocator>
-implicit_treap<T, Allocator>& implicit_treap<T, Allocator>::operator<<=(size_type count) noexcept {
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>& implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::operator<<=(size_type count) noexcept {
     reverse_shift(count);
     return *this;
 }
 
-template <typename T, typename Allocator>
-void implicit_treap<T, Allocator>::reverse_shift_interval(size_type begin, size_type end, size_type count) noexcept {
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+void implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::reverse_shift_interval(size_type begin, size_type end, size_type count) noexcept {
     if (begin >= end) {
         return;
     }
@@ -516,12 +907,155 @@ void implicit_treap<T, Allocator>::reverse_shift_interval(size_type begin, size_
     exchange_intervals(begin, begin + count, begin + count, end);
 }
 
-template <typename T, typename Allocator>
-void implicit_treap<T, Allocator>::reverse_shift_interval(const_iterator begin, const_iterator end,
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+void implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::reverse_shift_interval(const_iterator begin, const_iterator end,
                                                           size_type count) noexcept {
     reverse_shift_interval(begin.order(), end.order(), count);
 }
 
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+void implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::reverse() noexcept {
+    reverse_interval(0, size());
+}
+
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+void implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::reverse_interval(size_type begin, size_type end) noexcept {
+    end = std::min(end, size());
+    if (begin >= end) {
+        return;
+    }
+    auto [left, included_begin] = split_with_index(root(), begin);
+    auto [interval, right] = split_with_index(included_begin, end - begin);
+    interval->reverse();
+    set_root(merge_with_index(merge_with_index(left, interval), right));
+    if (begin == 0) {
+        base_type::adjust_begin();
+    }
+}
+
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+void implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::reverse_interval(const_iterator begin, const_iterator end) noexcept {
+    reverse_interval(begin.order(), end.order());
+    // passed iterators stay movable
+    base_type::clean_path(begin);
+    base_type::clean_path(end);
+}
+
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+template <typename O>
+void implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::apply_interval(size_type begin, size_type end,
+                                                              const typename O::action_type& action) {
+    end = std::min(end, size());
+    if (begin >= end) {
+        return;
+    }
+    auto [left, included_begin] = split_with_index(root(), begin);
+    auto [interval, right] = split_with_index(included_begin, end - begin);
+    interval->apply_action(action);
+    set_root(merge_with_index(merge_with_index(left, interval), right));
+    if (begin == 0) {
+        // the path to the first node must not have pending actions
+        base_type::adjust_begin();
+    }
+}
+
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+template <typename O>
+void implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::apply_interval(const_iterator begin, const_iterator end,
+                                                              const typename O::action_type& action) {
+    apply_interval(begin.order(), end.order(), action);
+}
+
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+void implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::apply_pending() noexcept {
+    treap_node* node = root();
+    if (node == nullptr) {
+        return;
+    }
+    // preorder traversal over parent links, each node is pushed before visiting its children
+    node->push();
+    while (true) {
+        if (node->get_left() != nullptr || node->get_right() != nullptr) {
+            node = (node->get_left() != nullptr ? node->get_left() : node->get_right());
+            node->push();
+            continue;
+        }
+        // climb to the nearest ancestor having not visited right subtree
+        while (true) {
+            if (node == root()) {
+                return;
+            }
+            treap_node* child = node;
+            node = node->get_parent();
+            if (child == node->get_left() && node->get_right() != nullptr) {
+                node = node->get_right();
+                node->push();
+                break;
+            }
+        }
+    }
+}
+
+template <typename T, typename Allocator, typename Operations, typename Priority, typename Layout, typename Statistics>
+template <typename O>
+typename O::aggregate_type
+implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>::aggregate_interval(size_type begin, size_type end) const {
+    using monoid_type = typename O::monoid_type;
+    end = std::min(end, size());
+    // find the highest node lying in the interval, it separates the interval into suffix and prefix parts
+    auto* node = const_cast<treap_node*>(root());
+    size_type offset = 0;
+    while (node != nullptr) {
+        node->push();
+        size_type index = offset + node->left_size();
+        if (index < begin) {
+            offset = index + 1;
+            node = node->get_right();
+        } else if (index >= end) {
+            node = node->get_left();
+        } else {
+            break;
+        }
+    }
+    if (node == nullptr) {
+        return monoid_type::identity();
+    }
+    auto result = node->get_own_aggregate();
+    // the left subtree suffix is folded from right to left
+    size_type left_offset = offset;
+    for (treap_node* left = node->get_left(); left != nullptr;) {
+        left->push();
+        size_type index = left_offset + left->left_size();
+        if (index < begin) {
+            left_offset = index + 1;
+            left = left->get_right();
+            continue;
+        }
+        if (left->get_right() != nullptr) {
+            result = monoid_type::combine(left->get_right()->get_aggregate(), result);
+        }
+        result = monoid_type::combine(left->get_own_aggregate(), result);
+        left = left->get_left();
+    }
+    // the right subtree prefix is folded from left to right
+    size_type right_offset = offset + node->left_size() + 1;
+    for (treap_node* right = node->get_right(); right != nullptr;) {
+        right->push();
+        size_type index = right_offset + right->left_size();
+        if (index >= end) {
+            right = right->get_left();
+            continue;
+        }
+        if (right->get_left() != nullptr) {
+            result = monoid_type::combine(result, right->get_left()->get_aggregate());
+        }
+        result = monoid_type::combine(result, right->get_own_aggregate());
+        right_offset = index + 1;
+        right = right->get_right();
+    }
+    return result;
+}
+
 } // namespace nstd
 
-#endif // BASICS_IMPLICIT_TREAP_BASE_H
\ No newline at end of file
+#endif // BASICS_IMPLICIT_TREAP_BASE_H
@@ -0,0 +1,137 @@
+#ifndef BASICS_MONOID_HPP
+#define BASICS_MONOID_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+
+namespace nstd {
+
+/**
+ * Monoids for tree aggregates
+ * Monoid provides value_type, identity element and associative combine operation
+ * Combine operation doesn't have to be commutative, tree aggregates keep the element order
+ * Commutative monoids declare commutative member, reversible trees keep the reversed aggregates for the other ones
+ */
+
+template <typename T>
+struct sum_monoid {
+    using value_type = T;
+
+    static constexpr bool commutative = true;
+
+    static value_type identity() { return value_type(); }
+
+    static value_type combine(const value_type& left, const value_type& right) { return left + right; }
+};
+
+template <typename T>
+struct min_monoid {
+    using value_type = T;
+
+    static constexpr bool commutative = true;
+
+    static value_type identity() { return std::numeric_limits<value_type>::max(); }
+
+    static value_type combine(const value_type& left, const value_type& right) { return std::min(left, right); }
+};
+
+template <typename T>
+struct max_monoid {
+    using value_type = T;
+
+    static constexpr bool commutative = true;
+
+    static value_type identity() { return std::numeric_limits<value_type>::lowest(); }
+
+    static value_type combine(const value_type& left, const value_type& right) { return std::max(left, right); }
+};
+
+template <typename Monoid, typename = void>
+struct is_commutative_monoid : std::false_type {
+};
+
+template <typename Monoid>
+struct is_commutative_monoid<Monoid, std::void_t<decltype(Monoid::commutative)>>
+        : std::bool_constant<Monoid::commutative> {
+};
+
+template <typename Monoid>
+inline constexpr bool is_commutative_monoid_v = is_commutative_monoid<Monoid>::value;
+
+/**
+ * Add and assign action
+ * Assignment is applied before addition, so composition of such actions keeps the same form
+ */
+template <typename T>
+struct add_assign_action {
+    bool assign = false;
+    T assigned = T();
+    T added = T();
+};
+
+/**
+ * Operations for lazy interval actions of implicit treap
+ * Elements are folded with Monoid and updated with add and assign actions
+ * Custom operations must provide the same members except add and assign factories, which are optional
+ * Aggregate action must not depend on the element order, it is applied to the reversed aggregates either
+ * @tparam T element type
+ * @tparam Monoid sum_monoid, min_monoid or max_monoid of T
+ */
+template <typename T, typename Monoid>
+struct add_assign_operations {
+    using monoid_type = Monoid;
+    using aggregate_type = typename Monoid::value_type;
+    using action_type = add_assign_action<T>;
+
+    static aggregate_type lift(const T& value) { return aggregate_type(value); }
+
+    static action_type identity_action() { return action_type(); }
+
+    static bool is_identity(const action_type& action) { return !action.assign && action.added == T(); }
+
+    /**
+     * @return action equal to applying the first action and then the second one
+     */
+    static action_type compose(const action_type& first, const action_type& second) {
+        if (second.assign) {
+            return second;
+        }
+        return {first.assign, first.assigned, first.added + second.added};
+    }
+
+    static void apply(T& value, const action_type& action) {
+        if (action.assign) {
+            value = action.assigned;
+        }
+        value += action.added;
+    }
+
+    /**
+     * Applies action to the aggregate of count elements
+     */
+    static aggregate_type apply(const aggregate_type& aggregate, const action_type& action, size_t count) {
+        // sum depends on the count of elements, min and max don't
+        T multiplier = (std::is_same_v<Monoid, sum_monoid<T>> ? static_cast<T>(count) : T(1));
+        aggregate_type result = (action.assign ? action.assigned * multiplier : aggregate);
+        return result + action.added * multiplier;
+    }
+
+    static action_type add(const T& delta) { return {false, T(), delta}; }
+
+    static action_type assign(const T& value) { return {true, value, T()}; }
+};
+
+template <typename T>
+using range_sum_operations = add_assign_operations<T, sum_monoid<T>>;
+
+template <typename T>
+using range_min_operations = add_assign_operations<T, min_monoid<T>>;
+
+template <typename T>
+using range_max_operations = add_assign_operations<T, max_monoid<T>>;
+
+} // namespace nstd
+
+#endif //BASICS_MONOID_HPP
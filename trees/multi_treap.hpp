@@ -0,0 +1,684 @@
+#ifndef BASICS_MULTI_TREAP_HPP
+#define BASICS_MULTI_TREAP_HPP
+
+#include <functional>
+#include <initializer_list>
+#include <istream>
+#include <stdexcept>
+#include <utility>
+#include <treap_base.hpp>
+
+namespace nstd {
+
+/**
+ * Treap keeping equal keys
+ * Equal keys are kept in the insertion order, each new one is placed after the present equal keys
+ * Counting and ranking functions use subtree sizes, so they work in O(log size) complexity
+ * regardless of the equal keys count
+ */
+template <typename Node, typename Compare, typename Allocator, typename Priority = random_priority_generator,
+        typename Statistics = no_treap_statistics>
+class multi_treap : public treap_base<Node, Allocator, Priority, Statistics> {
+    using base_type = treap_base<Node, Allocator, Priority, Statistics>;
+    using treap_node = Node;
+    using node_holder = typename base_type::node_holder;
+    using tree_builder = typename base_type::tree_builder;
+    using split_collector = typename base_type::split_collector;
+
+public:
+    using key_type = typename treap_node::raw_key_type;
+    using value_type = typename base_type::value_type;
+    using key_compare = Compare;
+    using allocator_type = typename base_type::allocator_type;
+    using size_type = typename base_type::size_type;
+
+public:
+    using iterator = typename base_type::iterator;
+    using const_iterator = typename base_type::const_iterator;
+    using reverse_iterator = typename base_type::reverse_iterator;
+    using const_reverse_iterator = typename base_type::const_reverse_iterator;
+
+private:
+    using base_type::_begin;
+    key_compare _comparator;
+
+private:
+    using base_type::end_node;
+    using base_type::root;
+    using base_type::set_root;
+    using base_type::adjust_begin;
+
+public:
+    explicit multi_treap(const key_compare& comparator = key_compare(),
+                         const allocator_type& allocator = allocator_type());
+
+    multi_treap(const multi_treap& other);
+
+    multi_treap(multi_treap&& other) noexcept;
+
+    multi_treap& operator=(const multi_treap& other);
+
+    multi_treap& operator=(multi_treap&& other) noexcept;
+
+    ~multi_treap() = default;
+
+private:
+    /**
+     * Splits passed node into the nodes having less (not greater, when KeyIncluded is true) keys and the rest
+     * Works top-down in O(log size) complexity
+     * If comparator throws exception, already split nodes are merged back
+     */
+    template <bool KeyIncluded = false>
+    std::pair<treap_node*, treap_node*> split(treap_node* node, const key_type& key);
+
+    /**
+     * Links the detached node after all the nodes having not greater keys
+     * Node place is found in one descent, then only the replaced subtree is split
+     * @param node detached node with the drawn priority
+     * @return node iterator
+     */
+    iterator link_node(treap_node* node);
+
+    /**
+     * Detaches the nodes having keys in the interval
+     * @tparam EndIncluded determines is end key included into the interval or not
+     * @return detached tree, nullptr if the interval is empty
+     */
+    template <bool EndIncluded = false>
+    treap_node* detach_key_interval(const key_type& begin_key, const key_type& end_key);
+
+    /**
+     * Builds tree from the passed range in O(range size) complexity
+     * Keys, which are less than the previous built key, are skipped
+     */
+    template <typename InputIterator>
+    treap_node* build_sorted(InputIterator begin, InputIterator end);
+
+    /**
+     * Counts the keys, which are less (not greater, when KeyIncluded is true) than the passed key
+     * Works in O(log size) complexity
+     */
+    template <bool KeyIncluded = false>
+    size_type count_before(const key_type& key) const;
+
+    const treap_node* lower_bound_node(const key_type& key) const;
+
+    const treap_node* upper_bound_node(const key_type& key) const;
+
+    /**
+     * Finds the lower bound (upper bound, when KeyIncluded is true) of the key starting from the hint
+     */
+    template <bool KeyIncluded>
+    const treap_node* bound_node_from(const_iterator hint, const key_type& key) const;
+
+public:
+    void swap(multi_treap& other) noexcept;
+
+    iterator insert(const value_type& value) { return emplace(value); }
+
+    iterator insert(value_type&& value) { return emplace(std::move(value)); }
+
+    /**
+     * Inserts all the range elements
+     * Works in O(range size * log size) complexity
+     */
+    template <typename InputIterator>
+    void insert(InputIterator begin, InputIterator end);
+
+    void insert(std::initializer_list<value_type> il) { insert(il.begin(), il.end()); }
+
+    /**
+     * Inserts a node with the value constructed with passed arguments after the equal keys
+     * Working complexity is O(log size)
+     * Provides strong exception safety
+     * @return inserted iterator
+     */
+    template <typename... Args>
+    iterator emplace(Args&& ... args);
+
+    /**
+     * Replaces tree content with the passed sorted range elements
+     * Working complexity is O(range size)
+     * Keys, which are less than the previous one, are skipped
+     * Provides strong exception safety
+     */
+    template <typename InputIterator>
+    void assign_sorted(InputIterator begin, InputIterator end);
+
+    /**
+     * Replaces tree content with the data written by save function
+     * Working complexity is O(stream size + size)
+     * Throws serialization_error, when the stream data is invalid or its keys are decreasing
+     */
+    void load(std::istream& stream);
+
+public:
+    /**
+     * Erases all the elements having the passed key
+     * Works in O(count + log size) complexity
+     * @return count of erased elements
+     */
+    size_type erase_key(const key_type& key);
+
+    /**
+     * Erases the first element having the passed key
+     * Works in O(log size) complexity
+     * @return iterator pointing on the element after erased one, lower bound of the key, if there is no such key
+     */
+    iterator erase_one(const key_type& key);
+
+    /**
+     * Erases the elements having keys in [begin_key, end_key) interval
+     * Works in O(end - begin + log size) complexity
+     * @return iterator pointing on the first element after interval
+     */
+    iterator erase_key_interval(const key_type& begin_key, const key_type& end_key);
+
+    /**
+     * Erases the elements having keys in [begin_key, end_key] interval
+     */
+    iterator erase_key_interval_with_end(const key_type& begin_key, const key_type& end_key);
+
+    using base_type::erase;
+
+public:
+    bool contains(const key_type& key) const;
+
+    /**
+     * Returns iterator pointing on the first element having the passed key, end iterator if there is no such key
+     */
+    iterator find(const key_type& key);
+
+    const_iterator find(const key_type& key) const;
+
+    /**
+     * Counts the elements having the passed key
+     * Works in O(log size) complexity
+     */
+    size_type count(const key_type& key) const;
+
+    /**
+     * Returns the range of the elements having the passed key
+     * Works in O(log size) complexity
+     */
+    std::pair<iterator, iterator> equal_range(const key_type& key);
+
+    std::pair<const_iterator, const_iterator> equal_range(const key_type& key) const;
+
+    iterator lower_bound(const key_type& key);
+
+    const_iterator lower_bound(const key_type& key) const;
+
+    iterator upper_bound(const key_type& key);
+
+    const_iterator upper_bound(const key_type& key) const;
+
+    /**
+     * Returns the key, which is located in the passed index
+     * Works in O (log size) complexity
+     * Throws std::out_of_range exception, when index >= size
+     */
+    const key_type& key_of_order(size_type index) const;
+
+    /**
+     * Returns index of the first element having the passed key
+     * Works in O (log size) complexity
+     * @return proper index, when the tree has the key, size() otherwise
+     */
+    size_type order_of_key(const key_type& key) const;
+
+    /**
+     * Finger search versions of the lookups above, the search starts from the hint instead of the root
+     * Work in O(log d) expected complexity, where d is the order distance between the hint and the result
+     * Any iterator of the tree including end is a valid hint
+     */
+    iterator find(const_iterator hint, const key_type& key);
+
+    const_iterator find(const_iterator hint, const key_type& key) const;
+
+    iterator lower_bound(const_iterator hint, const key_type& key);
+
+    const_iterator lower_bound(const_iterator hint, const key_type& key) const;
+
+    iterator upper_bound(const_iterator hint, const key_type& key);
+
+    const_iterator upper_bound(const_iterator hint, const key_type& key) const;
+
+    /**
+     * The key is found by finger search, then its order is counted on the way to the root without key comparisons
+     */
+    size_type order_of_key(const_iterator hint, const key_type& key) const;
+
+    key_compare key_comp() const { return _comparator; }
+
+    using base_type::size;
+
+    using base_type::empty;
+
+public:
+    using base_type::begin;
+
+    using base_type::cbegin;
+
+    using base_type::rbegin;
+
+    using base_type::crbegin;
+
+    using base_type::end;
+
+    using base_type::cend;
+
+    using base_type::rend;
+
+    using base_type::crend;
+};
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+multi_treap<Node, Compare, Allocator, Priority, Statistics>::multi_treap(const key_compare& comparator, const allocator_type& allocator)
+        : base_type(allocator), _comparator(comparator) {}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+multi_treap<Node, Compare, Allocator, Priority, Statistics>::multi_treap(const multi_treap& other)
+        : base_type(other), _comparator(other._comparator) {
+    assign_sorted(other.begin(), other.end());
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+multi_treap<Node, Compare, Allocator, Priority, Statistics>::multi_treap(multi_treap&& other) noexcept
+        : base_type(std::move(other)), _comparator(std::move(other._comparator)) {}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+multi_treap<Node, Compare, Allocator, Priority, Statistics>&
+multi_treap<Node, Compare, Allocator, Priority, Statistics>::operator=(const multi_treap& other) {
+    if (this != &other) {
+        multi_treap copied(other);
+        this->swap(copied);
+    }
+    return *this;
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+multi_treap<Node, Compare, Allocator, Priority, Statistics>&
+multi_treap<Node, Compare, Allocator, Priority, Statistics>::operator=(multi_treap&& other) noexcept {
+    if (this != &other) {
+        multi_treap moved(std::move(other));
+        this->swap(moved);
+    }
+    return *this;
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <bool KeyIncluded>
+auto multi_treap<Node, Compare, Allocator, Priority, Statistics>::split(treap_node* node, const key_type& key)
+-> std::pair<treap_node*, treap_node*> {
+    base_type::_statistics.count_split();
+    split_collector collector;
+    try {
+        while (node != nullptr) {
+            bool compare = (KeyIncluded ? !_comparator(key, node->get_key()) : _comparator(node->get_key(), key));
+            if (compare) {
+                collector.push_left(node);
+                node = node->get_right();
+                continue;
+            }
+            collector.push_right(node);
+            node = node->get_left();
+        }
+    } catch (...) {
+        auto [left, right] = collector.release();
+        base_type::merge_with_index(base_type::merge_with_index(left, node), right);
+        throw;
+    }
+    return collector.release();
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename multi_treap<Node, Compare, Allocator, Priority, Statistics>::iterator
+multi_treap<Node, Compare, Allocator, Priority, Statistics>::link_node(treap_node* node) {
+    const key_type& key = node->get_key();
+    treap_node* parent = end_node();
+    treap_node* subtree = root();
+    bool left = true;
+    bool leftmost = true;
+    // the node replaces the topmost node on the key path having less priority
+    while (subtree != nullptr && !(subtree->get_priority() < node->get_priority())) {
+        parent = subtree;
+        left = _comparator(key, subtree->get_key());
+        leftmost = leftmost && left;
+        subtree = (left ? subtree->get_left() : subtree->get_right());
+    }
+    auto [less, greater] = split<true>(subtree, key);
+    node->set_left(less);
+    node->set_right(greater);
+    if (parent == end_node()) {
+        set_root(node);
+    } else {
+        if (left) {
+            parent->set_left(node);
+        } else {
+            parent->set_right(node);
+        }
+        base_type::update_path(parent, root());
+    }
+    if (leftmost && less == nullptr) {
+        _begin = node;
+    }
+    return {node};
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <bool EndIncluded>
+typename multi_treap<Node, Compare, Allocator, Priority, Statistics>::treap_node*
+multi_treap<Node, Compare, Allocator, Priority, Statistics>::detach_key_interval(const key_type& begin_key, const key_type& end_key) {
+    auto [left, begin_included_tree] = split(root(), begin_key);
+    std::pair<treap_node*, treap_node*> rest;
+    try {
+        rest = split<EndIncluded>(begin_included_tree, end_key);
+    } catch (...) {
+        set_root(base_type::merge_with_index(left, begin_included_tree));
+        throw;
+    }
+    auto [interval, right] = rest;
+    set_root(base_type::merge_with_index(left, right));
+    if (left == nullptr && interval != nullptr) {
+        adjust_begin();
+    }
+    return interval;
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <typename InputIterator>
+typename multi_treap<Node, Compare, Allocator, Priority, Statistics>::treap_node*
+multi_treap<Node, Compare, Allocator, Priority, Statistics>::build_sorted(InputIterator begin, InputIterator end) {
+    tree_builder builder;
+    try {
+        for (; begin != end; ++begin) {
+            node_holder holder = base_type::construct_node(*begin);
+            treap_node* last = builder.last();
+            if (last == nullptr || !_comparator(holder->get_key(), last->get_key())) {
+                builder.push_back(holder.release());
+            }
+        }
+    } catch (...) {
+        base_type::destroy_tree(builder.release());
+        throw;
+    }
+    return builder.release();
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <bool KeyIncluded>
+typename multi_treap<Node, Compare, Allocator, Priority, Statistics>::size_type
+multi_treap<Node, Compare, Allocator, Priority, Statistics>::count_before(const key_type& key) const {
+    size_type count = 0;
+    size_type visited = 0;
+    for (const treap_node* node = root(); node != nullptr; ++visited) {
+        bool before = (KeyIncluded ? !_comparator(key, node->get_key()) : _comparator(node->get_key(), key));
+        if (before) {
+            count += node->left_size() + 1;
+            node = node->get_right();
+        } else {
+            node = node->get_left();
+        }
+    }
+    base_type::_statistics.count_lookup(visited);
+    return count;
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+const typename multi_treap<Node, Compare, Allocator, Priority, Statistics>::treap_node*
+multi_treap<Node, Compare, Allocator, Priority, Statistics>::lower_bound_node(const key_type& key) const {
+    const treap_node* node = root();
+    const treap_node* result = end_node();
+    size_type visited = 0;
+    for (; node != nullptr; ++visited) {
+        if (_comparator(node->get_key(), key)) {
+            node = node->get_right();
+            continue;
+        }
+        result = node;
+        node = node->get_left();
+    }
+    base_type::_statistics.count_lookup(visited);
+    return result;
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+const typename multi_treap<Node, Compare, Allocator, Priority, Statistics>::treap_node*
+multi_treap<Node, Compare, Allocator, Priority, Statistics>::upper_bound_node(const key_type& key) const {
+    const treap_node* node = root();
+    const treap_node* result = end_node();
+    size_type visited = 0;
+    for (; node != nullptr; ++visited) {
+        if (_comparator(key, node->get_key())) {
+            result = node;
+            node = node->get_left();
+            continue;
+        }
+        node = node->get_right();
+    }
+    base_type::_statistics.count_lookup(visited);
+    return result;
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+void multi_treap<Node, Compare, Allocator, Priority, Statistics>::swap(multi_treap& other) noexcept {
+    base_type::swap(other);
+    std::swap(_comparator, other._comparator);
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <typename InputIterator>
+void multi_treap<Node, Compare, Allocator, Priority, Statistics>::insert(InputIterator begin, InputIterator end) {
+    for (; begin != end; ++begin) {
+        emplace(*begin);
+    }
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <typename... Args>
+typename multi_treap<Node, Compare, Allocator, Priority, Statistics>::iterator
+multi_treap<Node, Compare, Allocator, Priority, Statistics>::emplace(Args&& ... args) {
+    node_holder holder = base_type::construct_node(std::forward<Args>(args)...);
+    auto it = link_node(holder.get());
+    holder.release();
+    return it;
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <typename InputIterator>
+void multi_treap<Node, Compare, Allocator, Priority, Statistics>::assign_sorted(InputIterator begin, InputIterator end) {
+    treap_node* tree = build_sorted(begin, end);
+    base_type::destroy_tree(root());
+    set_root(tree);
+    adjust_begin();
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+void multi_treap<Node, Compare, Allocator, Priority, Statistics>::load(std::istream& stream) {
+    treap_node* tree = base_type::read_tree(stream, [this](const treap_node* previous, const treap_node* node) {
+        return previous == nullptr || !_comparator(node->get_key(), previous->get_key());
+    });
+    base_type::destroy_tree(root());
+    set_root(tree);
+    adjust_begin();
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename multi_treap<Node, Compare, Allocator, Priority, Statistics>::size_type
+multi_treap<Node, Compare, Allocator, Priority, Statistics>::erase_key(const key_type& key) {
+    treap_node* interval = detach_key_interval<true>(key, key);
+    size_type count = (interval != nullptr ? interval->size() : 0);
+    base_type::retire_tree(interval);
+    return count;
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename multi_treap<Node, Compare, Allocator, Priority, Statistics>::iterator
+multi_treap<Node, Compare, Allocator, Priority, Statistics>::erase_one(const key_type& key) {
+    treap_node* node = const_cast<treap_node*>(lower_bound_node(key));
+    if (node == end_node() || _comparator(key, node->get_key())) {
+        return {node};
+    }
+    return base_type::erase(const_iterator(node));
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename multi_treap<Node, Compare, Allocator, Priority, Statistics>::iterator
+multi_treap<Node, Compare, Allocator, Priority, Statistics>::erase_key_interval(const key_type& begin_key, const key_type& end_key) {
+    auto it = lower_bound(end_key);
+    base_type::retire_tree(detach_key_interval(begin_key, end_key));
+    return it;
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename multi_treap<Node, Compare, Allocator, Priority, Statistics>::iterator
+multi_treap<Node, Compare, Allocator, Priority, Statistics>::erase_key_interval_with_end(const key_type& begin_key,
+                                                                            const key_type& end_key) {
+    auto it = upper_bound(end_key);
+    base_type::retire_tree(detach_key_interval<true>(begin_key, end_key));
+    return it;
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+bool multi_treap<Node, Compare, Allocator, Priority, Statistics>::contains(const key_type& key) const {
+    return find(key) != end();
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename multi_treap<Node, Compare, Allocator, Priority, Statistics>::iterator
+multi_treap<Node, Compare, Allocator, Priority, Statistics>::find(const key_type& key) {
+    return base_type::iterator_node(std::as_const(*this).find(key));
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename multi_treap<Node, Compare, Allocator, Priority, Statistics>::const_iterator
+multi_treap<Node, Compare, Allocator, Priority, Statistics>::find(const key_type& key) const {
+    const treap_node* node = lower_bound_node(key);
+    if (node != end_node() && !_comparator(key, node->get_key())) {
+        return {node};
+    }
+    return end();
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename multi_treap<Node, Compare, Allocator, Priority, Statistics>::size_type
+multi_treap<Node, Compare, Allocator, Priority, Statistics>::count(const key_type& key) const {
+    return count_before<true>(key) - count_before(key);
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+std::pair<typename multi_treap<Node, Compare, Allocator, Priority, Statistics>::iterator,
+        typename multi_treap<Node, Compare, Allocator, Priority, Statistics>::iterator>
+multi_treap<Node, Compare, Allocator, Priority, Statistics>::equal_range(const key_type& key) {
+    return {lower_bound(key), upper_bound(key)};
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+std::pair<typename multi_treap<Node, Compare, Allocator, Priority, Statistics>::const_iterator,
+        typename multi_treap<Node, Compare, Allocator, Priority, Statistics>::const_iterator>
+multi_treap<Node, Compare, Allocator, Priority, Statistics>::equal_range(const key_type& key) const {
+    return {lower_bound(key), upper_bound(key)};
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename multi_treap<Node, Compare, Allocator, Priority, Statistics>::iterator
+multi_treap<Node, Compare, Allocator, Priority, Statistics>::lower_bound(const key_type& key) {
+    return {const_cast<treap_node*>(lower_bound_node(key))};
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename multi_treap<Node, Compare, Allocator, Priority, Statistics>::const_iterator
+multi_treap<Node, Compare, Allocator, Priority, Statistics>::lower_bound(const key_type& key) const {
+    return {lower_bound_node(key)};
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename multi_treap<Node, Compare, Allocator, Priority, Statistics>::iterator
+multi_treap<Node, Compare, Allocator, Priority, Statistics>::upper_bound(const key_type& key) {
+    return {const_cast<treap_node*>(upper_bound_node(key))};
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename multi_treap<Node, Compare, Allocator, Priority, Statistics>::const_iterator
+multi_treap<Node, Compare, Allocator, Priority, Statistics>::upper_bound(const key_type& key) const {
+    return {upper_bound_node(key)};
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+const typename multi_treap<Node, Compare, Allocator, Priority, Statistics>::key_type&
+multi_treap<Node, Compare, Allocator, Priority, Statistics>::key_of_order(size_type index) const {
+    if (index >= size()) {
+        throw std::out_of_range("Index is out of bounds");
+    }
+    return root()->node_of_order(index)->get_key();
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename multi_treap<Node, Compare, Allocator, Priority, Statistics>::size_type
+multi_treap<Node, Compare, Allocator, Priority, Statistics>::order_of_key(const key_type& key) const {
+    const treap_node* node = lower_bound_node(key);
+    if (node == end_node() || _comparator(key, node->get_key())) {
+        return size();
+    }
+    return node->order();
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <bool KeyIncluded>
+const typename multi_treap<Node, Compare, Allocator, Priority, Statistics>::treap_node*
+multi_treap<Node, Compare, Allocator, Priority, Statistics>::bound_node_from(const_iterator hint, const key_type& key) const {
+    return base_type::bound_node_from(base_type::iterator_node(hint), [this, &key](const treap_node* node) {
+        return (KeyIncluded ? !_comparator(key, node->get_key()) : _comparator(node->get_key(), key));
+    });
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename multi_treap<Node, Compare, Allocator, Priority, Statistics>::iterator
+multi_treap<Node, Compare, Allocator, Priority, Statistics>::find(const_iterator hint, const key_type& key) {
+    return base_type::iterator_node(std::as_const(*this).find(hint, key));
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename multi_treap<Node, Compare, Allocator, Priority, Statistics>::const_iterator
+multi_treap<Node, Compare, Allocator, Priority, Statistics>::find(const_iterator hint, const key_type& key) const {
+    const treap_node* node = bound_node_from<false>(hint, key);
+    if (node != end_node() && !_comparator(key, node->get_key())) {
+        return {node};
+    }
+    return end();
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename multi_treap<Node, Compare, Allocator, Priority, Statistics>::iterator
+multi_treap<Node, Compare, Allocator, Priority, Statistics>::lower_bound(const_iterator hint, const key_type& key) {
+    return {const_cast<treap_node*>(bound_node_from<false>(hint, key))};
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename multi_treap<Node, Compare, Allocator, Priority, Statistics>::const_iterator
+multi_treap<Node, Compare, Allocator, Priority, Statistics>::lower_bound(const_iterator hint, const key_type& key) const {
+    return {bound_node_from<false>(hint, key)};
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename multi_treap<Node, Compare, Allocator, Priority, Statistics>::iterator
+multi_treap<Node, Compare, Allocator, Priority, Statistics>::upper_bound(const_iterator hint, const key_type& key) {
+    return {const_cast<treap_node*>(bound_node_from<true>(hint, key))};
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename multi_treap<Node, Compare, Allocator, Priority, Statistics>::const_iterator
+multi_treap<Node, Compare, Allocator, Priority, Statistics>::upper_bound(const_iterator hint, const key_type& key) const {
+    return {bound_node_from<true>(hint, key)};
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename multi_treap<Node, Compare, Allocator, Priority, Statistics>::size_type
+multi_treap<Node, Compare, Allocator, Priority, Statistics>::order_of_key(const_iterator hint, const key_type& key) const {
+    return find(hint, key).order();
+}
+
+} // namespace nstd
+
+#endif //BASICS_MULTI_TREAP_HPP
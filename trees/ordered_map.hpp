@@ -1,13 +1,44 @@
 #ifndef BASICS_ORDERED_MAP_HPP
 #define BASICS_ORDERED_MAP_HPP
 
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <treap.hpp>
+#include <monoid.hpp>
 
 namespace nstd {
 
-template <typename Key, typename Value>
-class ordered_map_node : public treap_node_base<ordered_map_node<Key, Value>> {
-    using base_type = treap_node_base<ordered_map_node<Key, Value>>;
+/**
+ * Subtree aggregate of ordered map node
+ * Aggregate folds mapped values of the subtree nodes in key order using Monoid
+ * Storage is empty, when there is no monoid
+ * @tparam Monoid monoid class, mapped values are converted into its value type
+ */
+template <typename Monoid>
+class ordered_map_aggregate {
+public:
+    using monoid_type = Monoid;
+    using aggregate_type = typename Monoid::value_type;
+
+    // node memory is initialized member-wise without constructor call
+    static_assert(std::is_trivially_copyable_v<aggregate_type>, "Aggregate type must be trivially copyable");
+
+public:
+    const aggregate_type& get_aggregate() const { return _aggregate; }
+
+protected:
+    aggregate_type _aggregate;
+};
+
+template <>
+class ordered_map_aggregate<void> {
+};
+
+template <typename Key, typename Value, typename Monoid = void, typename Layout = default_treap_layout>
+class ordered_map_node : public treap_node_base<ordered_map_node<Key, Value, Monoid, Layout>, Layout>,
+                         public ordered_map_aggregate<Monoid> {
+    using base_type = treap_node_base<ordered_map_node<Key, Value, Monoid, Layout>, Layout>;
     using typename base_type::priority_type;
 public:
     using key_type = const Key;
@@ -17,7 +48,7 @@ public:
 public:
     explicit ordered_map_node(const value_type& value, priority_type priority = 0, ordered_map_node* left = nullptr,
                               ordered_map_node* right = nullptr)
-            : base_type(priority, left, right), _value(value) {}
+            : base_type(priority, left, right), _value(value) { update_aggregate(); }
 
     const value_type* get_value_address() const { return std::addressof(_value); }
 
@@ -29,17 +60,54 @@ public:
 
     value_type& get_value() { return _value; }
 
+    /**
+     * Gives the node mapped value converted into the monoid value
+     */
+    template <typename M = Monoid>
+    typename M::value_type get_own_aggregate() const { return typename M::value_type(_value.second); }
+
+    /**
+     * Folds the subtree mapped values, is called by update function
+     */
+    void update_aggregate() {
+        if constexpr (!std::is_void_v<Monoid>) {
+            auto aggregate = get_own_aggregate();
+            if (base_type::get_left() != nullptr) {
+                aggregate = Monoid::combine(base_type::get_left()->get_aggregate(), aggregate);
+            }
+            if (base_type::get_right() != nullptr) {
+                aggregate = Monoid::combine(aggregate, base_type::get_right()->get_aggregate());
+            }
+            this->_aggregate = aggregate;
+        }
+    }
+
 public:
     static const key_type& get_key(const value_type& value) { return value.first; }
 
+    static const key_type& get_key(const raw_value_type& value) { return value.first; }
+
 private:
     value_type _value;
 };
 
-template <typename Key, typename Value, typename Compare = std::less<Key>, typename Allocator = std::allocator<Key>>
-class ordered_map : public treap<ordered_map_node<Key, Value>, Compare, Allocator> {
+/**
+ * Ordered map based on treap
+ * @tparam Monoid optional monoid class, when it's given, each node keeps the aggregate of its subtree mapped values,
+ * so range_aggregate works in O(log size) complexity
+ * Mapped values changed through iterators or operator[] must be refreshed, insert_or_assign refreshes them itself
+ * @tparam Priority node priority generator, random_priority_generator by default,
+ * seeded_priority_generator gives reproducible tree shapes
+ * @tparam Layout node layout, narrow_treap_layout narrows node priority and size counters to 32 bits
+ * @tparam Statistics statistics policy, no_treap_statistics by default, treap_operation_counters counts operations
+ */
+template <typename Key, typename Value, typename Compare = std::less<Key>, typename Allocator = std::allocator<Key>,
+        typename Monoid = void, typename Priority = random_priority_generator, typename Layout = default_treap_layout,
+        typename Statistics = no_treap_statistics>
+class ordered_map
+        : public treap<ordered_map_node<Key, Value, Monoid, Layout>, Compare, Allocator, Priority, Statistics> {
 private:
-    using base_type = treap<ordered_map_node<Key, Value>, Compare, Allocator>;
+    using base_type = treap<ordered_map_node<Key, Value, Monoid, Layout>, Compare, Allocator, Priority, Statistics>;
 
 public:
     using key_type = Key;
@@ -59,28 +127,118 @@ public:
 
     using base_type::find;
     using base_type::end;
+    using base_type::refresh;
 
     ordered_map(std::initializer_list<std::pair<key_type, value_type>> il,
                 const key_compare& comparator = key_compare(),
                 const allocator_type& allocator = allocator_type())
             : base_type(comparator, allocator) {
-        for (const auto& p: il) {
-            base_type::insert(p);
-        }
+        base_type::insert(il.begin(), il.end());
     }
 
-public:
-    value_type& operator[](const key_type& key) {
-        auto it = base_type::find(key);
-        if (it == base_type::end()) {
-            return base_type::emplace(key, value_type()).first->second;
-        }
-        return it->second;
+    /**
+     * Builds container from the range sorted by comparator in O(range size) complexity
+     * Keys, which are not greater than the previous one, are skipped
+     * @param begin range begin
+     * @param end range end
+     * @return built container
+     */
+    template <typename InputIterator>
+    static ordered_map from_sorted(InputIterator begin, InputIterator end,
+                                   const key_compare& comparator = key_compare(),
+                                   const allocator_type& allocator = allocator_type()) {
+        ordered_map result(comparator, allocator);
+        result.assign_sorted(begin, end);
+        return result;
     }
 
+public:
+    /**
+     * Gives mapped value of the key, inserts default constructed one, when the key is absent
+     * Works in one descent in O(log size) complexity
+     */
+    value_type& operator[](const key_type& key) { return try_emplace(key).first->second; }
+
+    value_type& operator[](key_type&& key) { return try_emplace(std::move(key)).first->second; }
+
     const value_type& operator[](const key_type& key) const {
         return base_type::find(key)->second;
     }
+
+    /**
+     * Inserts value or assigns mapped value of the existing key
+     * Aggregates of the nodes lying on the key path are updated in O(log size) complexity
+     * @return iterator pointing on the key and true, if the value was inserted
+     */
+    template <typename M>
+    std::pair<iterator, bool> insert_or_assign(const key_type& key, M&& mapped) {
+        auto result = base_type::emplace_with_key(key, key, std::forward<M>(mapped));
+        if (!result.second) {
+            // mapped is forwarded only, when the value is constructed
+            result.first->second = std::forward<M>(mapped);
+            base_type::refresh(result.first);
+        }
+        return result;
+    }
+
+    template <typename M>
+    std::pair<iterator, bool> insert_or_assign(key_type&& key, M&& mapped) {
+        auto result = base_type::emplace_with_key(key, std::move(key), std::forward<M>(mapped));
+        if (!result.second) {
+            result.first->second = std::forward<M>(mapped);
+            base_type::refresh(result.first);
+        }
+        return result;
+    }
+
+    /**
+     * Inserts the value constructed from the key and the mapped value arguments, when the key is absent
+     * Finds the key place in one descent in O(log size) complexity, the arguments are left untouched, when the key is present
+     * @return iterator pointing on the key and true, if the value was inserted
+     */
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const key_type& key, Args&& ... args) {
+        return base_type::emplace_with_key(key, std::piecewise_construct, std::forward_as_tuple(key),
+                                           std::forward_as_tuple(std::forward<Args>(args)...));
+    }
+
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(key_type&& key, Args&& ... args) {
+        return base_type::emplace_with_key(key, std::piecewise_construct, std::forward_as_tuple(std::move(key)),
+                                           std::forward_as_tuple(std::forward<Args>(args)...));
+    }
+
+    /**
+     * Folds mapped values of the keys in [begin_key, end_key) interval in key order
+     * Works in O(log size) complexity, is available only for maps with monoid
+     * @param begin_key begin key (inclusive endpoint)
+     * @param end_key end key (exclusive endpoint)
+     * @return aggregate, monoid identity for the empty interval
+     */
+    template <typename M = Monoid>
+    typename M::value_type range_aggregate(const key_type& begin_key, const key_type& end_key) const {
+        return base_type::template key_interval_aggregate<false>(begin_key, end_key);
+    }
+
+    /**
+     * Folds mapped values of the keys in [begin_key, end_key] interval in key order
+     * Works in O(log size) complexity, is available only for maps with monoid
+     * @param begin_key begin key (inclusive endpoint)
+     * @param end_key end key (inclusive endpoint)
+     * @return aggregate, monoid identity for the empty interval
+     */
+    template <typename M = Monoid>
+    typename M::value_type range_aggregate_with_end(const key_type& begin_key, const key_type& end_key) const {
+        return base_type::template key_interval_aggregate<true>(begin_key, end_key);
+    }
+
+    /**
+     * Gives aggregate of all the mapped values in O(1) complexity
+     */
+    template <typename M = Monoid>
+    typename M::value_type aggregate() const {
+        return base_type::tree_aggregate();
+    }
 };
 
 } // namespace nstd
@@ -0,0 +1,67 @@
+#ifndef BASICS_ORDERED_MULTIMAP_HPP
+#define BASICS_ORDERED_MULTIMAP_HPP
+
+#include <multi_treap.hpp>
+#include <ordered_map.hpp>
+
+namespace nstd {
+
+/**
+ * Ordered multimap based on treap
+ * Values of equal keys are kept in the insertion order, count, equal_range and order_of_key work in O(log size) complexity
+ * @tparam Priority node priority generator, random_priority_generator by default,
+ * seeded_priority_generator gives reproducible tree shapes
+ * @tparam Layout node layout, narrow_treap_layout narrows node priority and size counters to 32 bits
+ * @tparam Statistics statistics policy, no_treap_statistics by default, treap_operation_counters counts operations
+ */
+template <typename Key, typename Value, typename Compare = std::less<Key>, typename Allocator = std::allocator<Key>,
+        typename Priority = random_priority_generator, typename Layout = default_treap_layout,
+        typename Statistics = no_treap_statistics>
+class ordered_multimap
+        : public multi_treap<ordered_map_node<Key, Value, void, Layout>, Compare, Allocator, Priority, Statistics> {
+private:
+    using base_type = multi_treap<ordered_map_node<Key, Value, void, Layout>, Compare, Allocator, Priority, Statistics>;
+
+public:
+    using key_type = Key;
+    using value_type = Value;
+    using typename base_type::key_compare;
+    using typename base_type::allocator_type;
+    using typename base_type::size_type;
+
+public:
+    using typename base_type::iterator;
+    using typename base_type::const_iterator;
+    using typename base_type::reverse_iterator;
+    using typename base_type::const_reverse_iterator;
+
+public:
+    using base_type::base_type;
+
+    ordered_multimap(std::initializer_list<std::pair<key_type, value_type>> il,
+                     const key_compare& comparator = key_compare(),
+                     const allocator_type& allocator = allocator_type())
+            : base_type(comparator, allocator) {
+        base_type::insert(il.begin(), il.end());
+    }
+
+    /**
+     * Builds container from the range sorted by comparator in O(range size) complexity
+     * Keys, which are less than the previous one, are skipped
+     * @param begin range begin
+     * @param end range end
+     * @return built container
+     */
+    template <typename InputIterator>
+    static ordered_multimap from_sorted(InputIterator begin, InputIterator end,
+                                        const key_compare& comparator = key_compare(),
+                                        const allocator_type& allocator = allocator_type()) {
+        ordered_multimap result(comparator, allocator);
+        result.assign_sorted(begin, end);
+        return result;
+    }
+};
+
+} // namespace nstd
+
+#endif //BASICS_ORDERED_MULTIMAP_HPP
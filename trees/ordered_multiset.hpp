@@ -0,0 +1,66 @@
+#ifndef BASICS_ORDERED_MULTISET_HPP
+#define BASICS_ORDERED_MULTISET_HPP
+
+#include <multi_treap.hpp>
+#include <ordered_set.hpp>
+
+namespace nstd {
+
+/**
+ * Ordered multiset based on treap
+ * Equal keys are kept in the insertion order, count, equal_range and order_of_key work in O(log size) complexity
+ * @tparam Priority node priority generator, random_priority_generator by default,
+ * seeded_priority_generator gives reproducible tree shapes
+ * @tparam Layout node layout, narrow_treap_layout narrows node priority and size counters to 32 bits
+ * @tparam Statistics statistics policy, no_treap_statistics by default, treap_operation_counters counts operations
+ */
+template <typename Key, typename Compare = std::less<Key>, typename Allocator = std::allocator<Key>,
+        typename Priority = random_priority_generator, typename Layout = default_treap_layout,
+        typename Statistics = no_treap_statistics>
+class ordered_multiset
+        : public multi_treap<ordered_set_node<Key, Layout>, Compare, Allocator, Priority, Statistics> {
+    using base_type = multi_treap<ordered_set_node<Key, Layout>, Compare, Allocator, Priority, Statistics>;
+
+public:
+    using key_type = Key;
+    using value_type = Key;
+    using typename base_type::key_compare;
+    using typename base_type::allocator_type;
+    using typename base_type::size_type;
+
+public:
+    using const_iterator = typename base_type::const_iterator;
+    using iterator = typename base_type::iterator;
+    using const_reverse_iterator = typename base_type::const_reverse_iterator;
+    using reverse_iterator = typename base_type::reverse_iterator;
+
+public:
+    using base_type::base_type;
+
+    ordered_multiset(std::initializer_list<key_type> il,
+                     const key_compare& comparator = key_compare(),
+                     const allocator_type& allocator = allocator_type())
+            : base_type(comparator, allocator) {
+        base_type::insert(il.begin(), il.end());
+    }
+
+    /**
+     * Builds container from the range sorted by comparator in O(range size) complexity
+     * Keys, which are less than the previous one, are skipped
+     * @param begin range begin
+     * @param end range end
+     * @return built container
+     */
+    template <typename InputIterator>
+    static ordered_multiset from_sorted(InputIterator begin, InputIterator end,
+                                        const key_compare& comparator = key_compare(),
+                                        const allocator_type& allocator = allocator_type()) {
+        ordered_multiset result(comparator, allocator);
+        result.assign_sorted(begin, end);
+        return result;
+    }
+};
+
+} // namespace nstd
+
+#endif //BASICS_ORDERED_MULTISET_HPP
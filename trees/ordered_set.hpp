@@ -5,10 +5,10 @@
 
 namespace nstd {
 
-template <typename Key>
-class ordered_set_node : public treap_node_base<ordered_set_node<Key>> {
+template <typename Key, typename Layout = default_treap_layout>
+class ordered_set_node : public treap_node_base<ordered_set_node<Key, Layout>, Layout> {
 private:
-    using base_type = treap_node_base<ordered_set_node<Key>>;
+    using base_type = treap_node_base<ordered_set_node<Key, Layout>, Layout>;
     using typename base_type::priority_type;
 public:
     using key_type = const Key;
@@ -35,9 +35,18 @@ private:
     key_type _key;
 };
 
-template <typename Key, typename Compare = std::less<Key>, typename Allocator = std::allocator<Key>>
-class ordered_set : public treap<ordered_set_node<Key>, Compare, Allocator> {
-    using base_type = treap<ordered_set_node<Key>, Compare, Allocator>;
+/**
+ * Ordered set based on treap
+ * @tparam Priority node priority generator, random_priority_generator by default,
+ * seeded_priority_generator gives reproducible tree shapes
+ * @tparam Layout node layout, narrow_treap_layout narrows node priority and size counters to 32 bits
+ * @tparam Statistics statistics policy, no_treap_statistics by default, treap_operation_counters counts operations
+ */
+template <typename Key, typename Compare = std::less<Key>, typename Allocator = std::allocator<Key>,
+        typename Priority = random_priority_generator, typename Layout = default_treap_layout,
+        typename Statistics = no_treap_statistics>
+class ordered_set : public treap<ordered_set_node<Key, Layout>, Compare, Allocator, Priority, Statistics> {
+    using base_type = treap<ordered_set_node<Key, Layout>, Compare, Allocator, Priority, Statistics>;
 
 public:
     using key_type = Key;
@@ -59,9 +68,23 @@ public:
                 const key_compare& comparator = key_compare(),
                 const allocator_type& allocator = allocator_type())
             : base_type(comparator, allocator) {
-        for (const auto& key: il) {
-            base_type::insert(key);
-        }
+        base_type::insert(il.begin(), il.end());
+    }
+
+    /**
+     * Builds container from the range sorted by comparator in O(range size) complexity
+     * Keys, which are not greater than the previous one, are skipped
+     * @param begin range begin
+     * @param end range end
+     * @return built container
+     */
+    template <typename InputIterator>
+    static ordered_set from_sorted(InputIterator begin, InputIterator end,
+                                   const key_compare& comparator = key_compare(),
+                                   const allocator_type& allocator = allocator_type()) {
+        ordered_set result(comparator, allocator);
+        result.assign_sorted(begin, end);
+        return result;
     }
 };
 
@@ -0,0 +1,760 @@
+#ifndef BASICS_PERSISTENT_ORDERED_MAP_HPP
+#define BASICS_PERSISTENT_ORDERED_MAP_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <treap_priority.hpp>
+
+namespace nstd {
+
+/**
+ * Persistent ordered map node
+ * Node is immutable after construction, so it may be shared between several map versions
+ * Node has no parent link, as shared node may have several parents
+ * Reference counter counts parent nodes and version handles pointing on the node
+ */
+template <typename Key, typename Value>
+class persistent_ordered_map_node {
+public:
+    using key_type = const Key;
+    using value_type = std::pair<key_type, Value>;
+    using size_type = size_t;
+    using priority_type = unsigned long long;
+
+private:
+    value_type _value;
+    priority_type _priority;
+    // size showing how many nodes are lying under tree with root of this node
+    size_type _size;
+    // child nodes, references on them are owned by this node
+    persistent_ordered_map_node* _left;
+    persistent_ordered_map_node* _right;
+    mutable std::atomic<size_type> _references;
+
+public:
+    template <typename... Args>
+    explicit persistent_ordered_map_node(priority_type priority, Args&& ... args)
+            : _value(std::forward<Args>(args)...), _priority(priority), _size(1), _left(nullptr), _right(nullptr),
+              _references(1) {}
+
+public:
+    const key_type& get_key() const { return _value.first; }
+
+    const value_type& get_value() const { return _value; }
+
+    priority_type get_priority() const { return _priority; }
+
+    const persistent_ordered_map_node* get_left() const { return _left; }
+
+    const persistent_ordered_map_node* get_right() const { return _right; }
+
+    size_type size() const { return _size; }
+
+    size_type left_size() const { return (_left != nullptr ? _left->_size : 0); }
+
+    /**
+     * Attaches children to the node, which is not shared yet
+     * References on the children are passed to the node
+     */
+    void set_children(persistent_ordered_map_node* left, persistent_ordered_map_node* right) {
+        _left = left;
+        _right = right;
+        _size = 1 + left_size() + (_right != nullptr ? _right->_size : 0);
+    }
+
+    persistent_ordered_map_node* take_left() { return std::exchange(_left, nullptr); }
+
+    persistent_ordered_map_node* take_right() { return std::exchange(_right, nullptr); }
+
+    void acquire() const { _references.fetch_add(1, std::memory_order_relaxed); }
+
+    /**
+     * Releases one reference on the node
+     * @return true, if it was the last reference, so node must be destroyed
+     */
+    bool release() { return _references.fetch_sub(1, std::memory_order_acq_rel) == 1; }
+};
+
+template <typename Key, typename Value, typename Compare, typename Allocator, typename Priority>
+class concurrent_ordered_map;
+
+/**
+ * Immutable version of persistent ordered map
+ * Shares nodes with the map and other versions, so it's copied in O(1) complexity
+ * Version stays unchanged, while the map is modified, and may be read by any thread
+ * Node references are counted atomically, so versions may be released by any thread, if allocator is thread safe
+ * @tparam Key key type
+ * @tparam Value mapped value type
+ * @tparam Compare comparator type
+ * @tparam Allocator allocator type
+ */
+template <typename Key, typename Value, typename Compare = std::less<Key>,
+        typename Allocator = std::allocator<std::pair<const Key, Value>>>
+class persistent_ordered_map_view {
+    template <typename, typename, typename, typename, typename>
+    friend class concurrent_ordered_map;
+
+protected:
+    using node_type = persistent_ordered_map_node<Key, Value>;
+    using node_allocator_type = typename std::allocator_traits<Allocator>::template rebind_alloc<node_type>;
+    using node_traits = std::allocator_traits<node_allocator_type>;
+
+public:
+    using key_type = Key;
+    using mapped_type = Value;
+    using value_type = typename node_type::value_type;
+    using key_compare = Compare;
+    using allocator_type = Allocator;
+    using size_type = size_t;
+    using difference_type = ptrdiff_t;
+
+    class const_iterator;
+
+    using iterator = const_iterator;
+
+protected:
+    node_type* _root;
+    key_compare _comparator;
+    node_allocator_type _allocator;
+
+public:
+    explicit persistent_ordered_map_view(const key_compare& comparator = key_compare(),
+                                         const allocator_type& allocator = allocator_type())
+            : _root(nullptr), _comparator(comparator), _allocator(allocator) {}
+
+    persistent_ordered_map_view(const persistent_ordered_map_view& other) noexcept;
+
+    persistent_ordered_map_view(persistent_ordered_map_view&& other) noexcept;
+
+    persistent_ordered_map_view& operator=(const persistent_ordered_map_view& other) noexcept;
+
+    persistent_ordered_map_view& operator=(persistent_ordered_map_view&& other) noexcept;
+
+    ~persistent_ordered_map_view() { release(_root); }
+
+public:
+    key_compare key_comp() const { return _comparator; }
+
+    allocator_type get_allocator() const { return allocator_type(_allocator); }
+
+    size_type size() const noexcept { return (_root != nullptr ? _root->size() : 0); }
+
+    bool empty() const noexcept { return _root == nullptr; }
+
+    const_iterator begin() const;
+
+    const_iterator end() const noexcept { return const_iterator(this, nullptr); }
+
+    const_iterator cbegin() const { return begin(); }
+
+    const_iterator cend() const noexcept { return end(); }
+
+    bool contains(const key_type& key) const;
+
+    /**
+     * Finds the passed key in O(log size) complexity
+     * @return iterator pointing on the key, end() if there is no such key
+     */
+    const_iterator find(const key_type& key) const;
+
+    const_iterator lower_bound(const key_type& key) const;
+
+    const_iterator upper_bound(const key_type& key) const;
+
+    /**
+     * Returns the key, which is located in the passed index
+     * Works in O (log size) complexity
+     * @param index index
+     * @return proper key when index < size
+     * Throws std::out_of_range exception otherwise
+     */
+    const key_type& key_of_order(size_type index) const;
+
+    /**
+     * Returns index of the passed key
+     * Works in O (log size) complexity
+     * @param key key
+     * @return proper index, when the tree has the key, size() otherwise
+     */
+    size_type order_of_key(const key_type& key) const;
+
+    void swap(persistent_ordered_map_view& other) noexcept;
+
+protected:
+    /**
+     * Finds the first node, which key is not less (greater when upper is true) than the passed key
+     */
+    template <bool upper>
+    const node_type* find_bound(const key_type& key) const;
+
+    /**
+     * Releases one reference on the passed tree, nodes not referenced anymore are destroyed
+     */
+    void release(node_type* node) noexcept;
+};
+
+/**
+ * Forward iterator over version elements
+ * Iterator keeps ancestors, which are visited after the current node, so increment works in O(1) amortized complexity
+ * Iterators given by find functions restore ancestors lazily with the first increment
+ * Iterator is valid while the version, which gave it, is alive and unchanged
+ */
+template <typename Key, typename Value, typename Compare, typename Allocator>
+class persistent_ordered_map_view<Key, Value, Compare, Allocator>::const_iterator {
+    friend class persistent_ordered_map_view;
+
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = typename persistent_ordered_map_view::value_type;
+    using difference_type = ptrdiff_t;
+    using pointer = const value_type*;
+    using reference = const value_type&;
+
+private:
+    const persistent_ordered_map_view* _view;
+    const node_type* _node;
+    // ancestors having the current node in the left subtree, the nearest one is the last
+    std::vector<const node_type*> _ancestors;
+    bool _ancestors_known;
+
+    const_iterator(const persistent_ordered_map_view* view, const node_type* node, bool ancestors_known = false)
+            : _view(view), _node(node), _ancestors(), _ancestors_known(ancestors_known) {}
+
+public:
+    const_iterator() : const_iterator(nullptr, nullptr) {}
+
+    reference operator*() const { return _node->get_value(); }
+
+    pointer operator->() const { return std::addressof(_node->get_value()); }
+
+    const_iterator& operator++();
+
+    const_iterator operator++(int) {
+        const_iterator copy = *this;
+        ++*this;
+        return copy;
+    }
+
+    bool operator==(const const_iterator& other) const { return _node == other._node; }
+
+    bool operator!=(const const_iterator& other) const { return _node != other._node; }
+
+private:
+    void descend_left(const node_type* node);
+};
+
+/**
+ * Persistent ordered map
+ * Modifications copy only the nodes lying on the touched path, all the other nodes are shared with previous versions
+ * snapshot function gives immutable version handle in O(1) complexity
+ * insert, insert_or_assign, erase_key functions work in O(log size) complexity and perform O(log size) allocations
+ * Modifications give strong exception safety, as the current version is not changed until the new one is built
+ * Iterators are invalidated by modifications, while snapshot iterators stay valid
+ * Values must be copy constructible, as copied path nodes copy their values
+ * @tparam Key key type
+ * @tparam Value mapped value type
+ * @tparam Compare comparator type
+ * @tparam Allocator allocator type
+ * @tparam Priority node priority generator, see treap_priority.hpp
+ */
+template <typename Key, typename Value, typename Compare = std::less<Key>,
+        typename Allocator = std::allocator<std::pair<const Key, Value>>, typename Priority = random_priority_generator>
+class persistent_ordered_map : public persistent_ordered_map_view<Key, Value, Compare, Allocator> {
+private:
+    using base_type = persistent_ordered_map_view<Key, Value, Compare, Allocator>;
+    using typename base_type::node_type;
+    using typename base_type::node_traits;
+    using priority_type = typename node_type::priority_type;
+    using base_type::_root;
+    using base_type::_comparator;
+    using base_type::_allocator;
+
+public:
+    using typename base_type::key_type;
+    using typename base_type::mapped_type;
+    using typename base_type::value_type;
+    using typename base_type::key_compare;
+    using typename base_type::allocator_type;
+    using typename base_type::size_type;
+    using typename base_type::const_iterator;
+    using typename base_type::iterator;
+    using snapshot_type = base_type;
+
+private:
+    /**
+     * Owning reference on the node, which releases it when an exception interrupts building of the new version
+     */
+    class node_reference {
+    private:
+        node_type* _node;
+        persistent_ordered_map* _map;
+
+    public:
+        explicit node_reference(persistent_ordered_map* map, node_type* node = nullptr) noexcept
+                : _node(node), _map(map) {}
+
+        node_reference(const node_reference& other) = delete;
+
+        node_reference(node_reference&& other) noexcept
+                : _node(std::exchange(other._node, nullptr)), _map(other._map) {}
+
+        node_reference& operator=(const node_reference& other) = delete;
+
+        node_reference& operator=(node_reference&& other) = delete;
+
+        ~node_reference() { _map->release(_node); }
+
+        node_type* get() const noexcept { return _node; }
+
+        node_type* operator->() const noexcept { return _node; }
+
+        node_type* release() noexcept { return std::exchange(_node, nullptr); }
+    };
+
+public:
+    using base_type::base_type;
+
+    persistent_ordered_map(std::initializer_list<std::pair<key_type, mapped_type>> il,
+                           const key_compare& comparator = key_compare(),
+                           const allocator_type& allocator = allocator_type())
+            : base_type(comparator, allocator) {
+        for (const auto& value: il) {
+            insert(value);
+        }
+    }
+
+public:
+    /**
+     * Gives immutable handle of the current version in O(1) complexity
+     * Handle shares all the nodes with the map, later modifications of the map don't affect it
+     */
+    snapshot_type snapshot() const noexcept { return snapshot_type(*this); }
+
+    /**
+     * Inserts value, if there is no value with the same key
+     * @return true, if the value was inserted
+     */
+    bool insert(const std::pair<key_type, mapped_type>& value);
+
+    template <typename... Args>
+    bool emplace(const key_type& key, Args&& ... args);
+
+    /**
+     * Inserts value or replaces mapped value of the existing key
+     * @return true, if the value was inserted, false if assigned
+     */
+    template <typename M>
+    bool insert_or_assign(const key_type& key, M&& mapped);
+
+    /**
+     * Erases the passed key
+     * @return count of erased elements
+     */
+    size_type erase_key(const key_type& key);
+
+    void clear() noexcept;
+
+private:
+    /**
+     * Creates new version of the tree and publishes it as the current one
+     */
+    void publish(node_reference&& root) noexcept;
+
+    template <typename... Args>
+    node_reference create_node(priority_type priority, Args&& ... args);
+
+    node_reference share(const node_type* node) noexcept;
+
+    /**
+     * Copies the passed node with the new children
+     */
+    node_reference copy_node(const node_type* node, node_reference&& left, node_reference&& right);
+
+    /**
+     * Persistent split, copies nodes on the split path
+     * @return trees with keys less than the passed key and not less than the passed key
+     */
+    std::pair<node_reference, node_reference> split(const node_type* node, const key_type& key);
+
+    /**
+     * Persistent merge, copies nodes on the merge path
+     */
+    node_reference merge(const node_type* node1, const node_type* node2);
+
+    node_reference insert_node(const node_type* node, node_reference&& inserted);
+
+    template <typename M>
+    node_reference assign_node(const node_type* node, const key_type& key, M&& mapped);
+
+    node_reference erase_node(const node_type* node, const key_type& key);
+
+private:
+    Priority _priority_generator;
+};
+
+//======================persistent_ordered_map_view implementation==============================
+
+
+template <typename Key, typename Value, typename Compare, typename Allocator>
+persistent_ordered_map_view<Key, Value, Compare, Allocator>::persistent_ordered_map_view(
+        const persistent_ordered_map_view& other) noexcept
+        : _root(other._root), _comparator(other._comparator), _allocator(other._allocator) {
+    if (_root != nullptr) {
+        _root->acquire();
+    }
+}
+
+template <typename Key, typename Value, typename Compare, typename Allocator>
+persistent_ordered_map_view<Key, Value, Compare, Allocator>::persistent_ordered_map_view(
+        persistent_ordered_map_view&& other) noexcept
+        : _root(std::exchange(other._root, nullptr)), _comparator(other._comparator), _allocator(other._allocator) {}
+
+template <typename Key, typename Value, typename Compare, typename Allocator>
+persistent_ordered_map_view<Key, Value, Compare, Allocator>&
+persistent_ordered_map_view<Key, Value, Compare, Allocator>::operator=(
+        const persistent_ordered_map_view& other) noexcept {
+    if (this != &other) {
+        persistent_ordered_map_view copy(other);
+        swap(copy);
+    }
+    return *this;
+}
+
+template <typename Key, typename Value, typename Compare, typename Allocator>
+persistent_ordered_map_view<Key, Value, Compare, Allocator>&
+persistent_ordered_map_view<Key, Value, Compare, Allocator>::operator=(persistent_ordered_map_view&& other) noexcept {
+    if (this != &other) {
+        persistent_ordered_map_view moved(std::move(other));
+        swap(moved);
+    }
+    return *this;
+}
+
+template <typename Key, typename Value, typename Compare, typename Allocator>
+typename persistent_ordered_map_view<Key, Value, Compare, Allocator>::const_iterator
+persistent_ordered_map_view<Key, Value, Compare, Allocator>::begin() const {
+    const_iterator it(this, nullptr, true);
+    it.descend_left(_root);
+    return it;
+}
+
+template <typename Key, typename Value, typename Compare, typename Allocator>
+bool persistent_ordered_map_view<Key, Value, Compare, Allocator>::contains(const key_type& key) const {
+    return find(key) != end();
+}
+
+template <typename Key, typename Value, typename Compare, typename Allocator>
+typename persistent_ordered_map_view<Key, Value, Compare, Allocator>::const_iterator
+persistent_ordered_map_view<Key, Value, Compare, Allocator>::find(const key_type& key) const {
+    const node_type* node = find_bound<false>(key);
+    if (node == nullptr || _comparator(key, node->get_key())) {
+        return end();
+    }
+    return const_iterator(this, node);
+}
+
+template <typename Key, typename Value, typename Compare, typename Allocator>
+typename persistent_ordered_map_view<Key, Value, Compare, Allocator>::const_iterator
+persistent_ordered_map_view<Key, Value, Compare, Allocator>::lower_bound(const key_type& key) const {
+    return const_iterator(this, find_bound<false>(key));
+}
+
+template <typename Key, typename Value, typename Compare, typename Allocator>
+typename persistent_ordered_map_view<Key, Value, Compare, Allocator>::const_iterator
+persistent_ordered_map_view<Key, Value, Compare, Allocator>::upper_bound(const key_type& key) const {
+    return const_iterator(this, find_bound<true>(key));
+}
+
+template <typename Key, typename Value, typename Compare, typename Allocator>
+const typename persistent_ordered_map_view<Key, Value, Compare, Allocator>::key_type&
+persistent_ordered_map_view<Key, Value, Compare, Allocator>::key_of_order(size_type index) const {
+    if (index >= size()) {
+        throw std::out_of_range("Index is out of bounds");
+    }
+    const node_type* node = _root;
+    while (index != node->left_size()) {
+        if (index < node->left_size()) {
+            node = node->get_left();
+        } else {
+            index -= node->left_size() + 1;
+            node = node->get_right();
+        }
+    }
+    return node->get_key();
+}
+
+template <typename Key, typename Value, typename Compare, typename Allocator>
+typename persistent_ordered_map_view<Key, Value, Compare, Allocator>::size_type
+persistent_ordered_map_view<Key, Value, Compare, Allocator>::order_of_key(const key_type& key) const {
+    size_type order = 0;
+    const node_type* node = _root;
+    while (node != nullptr) {
+        if (_comparator(key, node->get_key())) {
+            node = node->get_left();
+        } else if (_comparator(node->get_key(), key)) {
+            order += node->left_size() + 1;
+            node = node->get_right();
+        } else {
+            return order + node->left_size();
+        }
+    }
+    return size();
+}
+
+template <typename Key, typename Value, typename Compare, typename Allocator>
+void persistent_ordered_map_view<Key, Value, Compare, Allocator>::swap(persistent_ordered_map_view& other) noexcept {
+    std::swap(_root, other._root);
+    std::swap(_comparator, other._comparator);
+    std::swap(_allocator, other._allocator);
+}
+
+template <typename Key, typename Value, typename Compare, typename Allocator>
+template <bool upper>
+const typename persistent_ordered_map_view<Key, Value, Compare, Allocator>::node_type*
+persistent_ordered_map_view<Key, Value, Compare, Allocator>::find_bound(const key_type& key) const {
+    const node_type* result = nullptr;
+    const node_type* node = _root;
+    while (node != nullptr) {
+        bool go_left = (upper ? _comparator(key, node->get_key()) : !_comparator(node->get_key(), key));
+        if (go_left) {
+            result = node;
+            node = node->get_left();
+        } else {
+            node = node->get_right();
+        }
+    }
+    return result;
+}
+
+template <typename Key, typename Value, typename Compare, typename Allocator>
+void persistent_ordered_map_view<Key, Value, Compare, Allocator>::release(node_type* node) noexcept {
+    while (node != nullptr && node->release()) {
+        node_type* left = node->take_left();
+        node_type* right = node->take_right();
+        node_traits::destroy(_allocator, node);
+        node_traits::deallocate(_allocator, node, 1);
+        release(left);
+        // the right subtree is released iteratively
+        node = right;
+    }
+}
+
+//======================const_iterator implementation==========================================
+
+
+template <typename Key, typename Value, typename Compare, typename Allocator>
+typename persistent_ordered_map_view<Key, Value, Compare, Allocator>::const_iterator&
+persistent_ordered_map_view<Key, Value, Compare, Allocator>::const_iterator::operator++() {
+    if (!_ancestors_known) {
+        // restore ancestors by searching the current node key
+        const node_type* node = _view->_root;
+        while (node != _node) {
+            if (_view->_comparator(_node->get_key(), node->get_key())) {
+                _ancestors.push_back(node);
+                node = node->get_left();
+            } else {
+                node = node->get_right();
+            }
+        }
+        _ancestors_known = true;
+    }
+    if (_node->get_right() != nullptr) {
+        descend_left(_node->get_right());
+        return *this;
+    }
+    if (_ancestors.empty()) {
+        _node = nullptr;
+    } else {
+        _node = _ancestors.back();
+        _ancestors.pop_back();
+    }
+    return *this;
+}
+
+template <typename Key, typename Value, typename Compare, typename Allocator>
+void persistent_ordered_map_view<Key, Value, Compare, Allocator>::const_iterator::descend_left(const node_type* node) {
+    _node = node;
+    if (_node == nullptr) {
+        return;
+    }
+    while (_node->get_left() != nullptr) {
+        _ancestors.push_back(_node);
+        _node = _node->get_left();
+    }
+}
+
+//======================persistent_ordered_map implementation==================================
+
+
+template <typename Key, typename Value, typename Compare, typename Allocator, typename Priority>
+bool persistent_ordered_map<Key, Value, Compare, Allocator, Priority>::insert(const std::pair<key_type, mapped_type>& value) {
+    return emplace(value.first, value.second);
+}
+
+template <typename Key, typename Value, typename Compare, typename Allocator, typename Priority>
+template <typename... Args>
+bool persistent_ordered_map<Key, Value, Compare, Allocator, Priority>::emplace(const key_type& key, Args&& ... args) {
+    if (base_type::contains(key)) {
+        return false;
+    }
+    node_reference node = create_node(_priority_generator(), std::piecewise_construct, std::forward_as_tuple(key),
+                                      std::forward_as_tuple(std::forward<Args>(args)...));
+    publish(insert_node(_root, std::move(node)));
+    return true;
+}
+
+template <typename Key, typename Value, typename Compare, typename Allocator, typename Priority>
+template <typename M>
+bool persistent_ordered_map<Key, Value, Compare, Allocator, Priority>::insert_or_assign(const key_type& key, M&& mapped) {
+    if (!base_type::contains(key)) {
+        return emplace(key, std::forward<M>(mapped));
+    }
+    publish(assign_node(_root, key, std::forward<M>(mapped)));
+    return false;
+}
+
+template <typename Key, typename Value, typename Compare, typename Allocator, typename Priority>
+typename persistent_ordered_map<Key, Value, Compare, Allocator, Priority>::size_type
+persistent_ordered_map<Key, Value, Compare, Allocator, Priority>::erase_key(const key_type& key) {
+    if (!base_type::contains(key)) {
+        return 0;
+    }
+    publish(erase_node(_root, key));
+    return 1;
+}
+
+template <typename Key, typename Value, typename Compare, typename Allocator, typename Priority>
+void persistent_ordered_map<Key, Value, Compare, Allocator, Priority>::clear() noexcept {
+    publish(node_reference(this));
+}
+
+template <typename Key, typename Value, typename Compare, typename Allocator, typename Priority>
+void persistent_ordered_map<Key, Value, Compare, Allocator, Priority>::publish(node_reference&& root) noexcept {
+    // the previous version nodes, which are not shared with the new one and snapshots, are destroyed
+    base_type::release(std::exchange(_root, root.release()));
+}
+
+template <typename Key, typename Value, typename Compare, typename Allocator, typename Priority>
+template <typename... Args>
+typename persistent_ordered_map<Key, Value, Compare, Allocator, Priority>::node_reference
+persistent_ordered_map<Key, Value, Compare, Allocator, Priority>::create_node(priority_type priority, Args&& ... args) {
+    node_type* node = node_traits::allocate(_allocator, 1);
+    try {
+        node_traits::construct(_allocator, node, priority, std::forward<Args>(args)...);
+    } catch (...) {
+        node_traits::deallocate(_allocator, node, 1);
+        throw;
+    }
+    return node_reference(this, node);
+}
+
+template <typename Key, typename Value, typename Compare, typename Allocator, typename Priority>
+typename persistent_ordered_map<Key, Value, Compare, Allocator, Priority>::node_reference
+persistent_ordered_map<Key, Value, Compare, Allocator, Priority>::share(const node_type* node) noexcept {
+    if (node != nullptr) {
+        node->acquire();
+    }
+    return node_reference(this, const_cast<node_type*>(node));
+}
+
+template <typename Key, typename Value, typename Compare, typename Allocator, typename Priority>
+typename persistent_ordered_map<Key, Value, Compare, Allocator, Priority>::node_reference
+persistent_ordered_map<Key, Value, Compare, Allocator, Priority>::copy_node(const node_type* node, node_reference&& left,
+                                                                  node_reference&& right) {
+    node_reference copy = create_node(node->get_priority(), node->get_value());
+    copy->set_children(left.release(), right.release());
+    return copy;
+}
+
+template <typename Key, typename Value, typename Compare, typename Allocator, typename Priority>
+auto persistent_ordered_map<Key, Value, Compare, Allocator, Priority>::split(const node_type* node, const key_type& key)
+-> std::pair<node_reference, node_reference> {
+    if (node == nullptr) {
+        return {node_reference(this), node_reference(this)};
+    }
+    if (_comparator(node->get_key(), key)) {
+        auto [left, right] = split(node->get_right(), key);
+        return {copy_node(node, share(node->get_left()), std::move(left)), std::move(right)};
+    }
+    auto [left, right] = split(node->get_left(), key);
+    return {std::move(left), copy_node(node, std::move(right), share(node->get_right()))};
+}
+
+template <typename Key, typename Value, typename Compare, typename Allocator, typename Priority>
+typename persistent_ordered_map<Key, Value, Compare, Allocator, Priority>::node_reference
+persistent_ordered_map<Key, Value, Compare, Allocator, Priority>::merge(const node_type* node1, const node_type* node2) {
+    if (node1 == nullptr) {
+        return share(node2);
+    }
+    if (node2 == nullptr) {
+        return share(node1);
+    }
+    if (node1->get_priority() >= node2->get_priority()) {
+        return copy_node(node1, share(node1->get_left()), merge(node1->get_right(), node2));
+    }
+    return copy_node(node2, merge(node1, node2->get_left()), share(node2->get_right()));
+}
+
+template <typename Key, typename Value, typename Compare, typename Allocator, typename Priority>
+typename persistent_ordered_map<Key, Value, Compare, Allocator, Priority>::node_reference
+persistent_ordered_map<Key, Value, Compare, Allocator, Priority>::insert_node(const node_type* node, node_reference&& inserted) {
+    if (node == nullptr) {
+        return std::move(inserted);
+    }
+    if (inserted->get_priority() > node->get_priority()) {
+        // inserted node becomes the root of this subtree, it's not shared yet, so it's linked without copying
+        auto [left, right] = split(node, inserted->get_key());
+        inserted->set_children(left.release(), right.release());
+        return std::move(inserted);
+    }
+    if (_comparator(inserted->get_key(), node->get_key())) {
+        node_reference left = insert_node(node->get_left(), std::move(inserted));
+        return copy_node(node, std::move(left), share(node->get_right()));
+    }
+    node_reference right = insert_node(node->get_right(), std::move(inserted));
+    return copy_node(node, share(node->get_left()), std::move(right));
+}
+
+template <typename Key, typename Value, typename Compare, typename Allocator, typename Priority>
+template <typename M>
+typename persistent_ordered_map<Key, Value, Compare, Allocator, Priority>::node_reference
+persistent_ordered_map<Key, Value, Compare, Allocator, Priority>::assign_node(const node_type* node, const key_type& key,
+                                                                    M&& mapped) {
+    if (_comparator(key, node->get_key())) {
+        node_reference left = assign_node(node->get_left(), key, std::forward<M>(mapped));
+        return copy_node(node, std::move(left), share(node->get_right()));
+    }
+    if (_comparator(node->get_key(), key)) {
+        node_reference right = assign_node(node->get_right(), key, std::forward<M>(mapped));
+        return copy_node(node, share(node->get_left()), std::move(right));
+    }
+    node_reference copy = create_node(node->get_priority(), node->get_key(), std::forward<M>(mapped));
+    copy->set_children(share(node->get_left()).release(), share(node->get_right()).release());
+    return copy;
+}
+
+template <typename Key, typename Value, typename Compare, typename Allocator, typename Priority>
+typename persistent_ordered_map<Key, Value, Compare, Allocator, Priority>::node_reference
+persistent_ordered_map<Key, Value, Compare, Allocator, Priority>::erase_node(const node_type* node, const key_type& key) {
+    if (_comparator(key, node->get_key())) {
+        node_reference left = erase_node(node->get_left(), key);
+        return copy_node(node, std::move(left), share(node->get_right()));
+    }
+    if (_comparator(node->get_key(), key)) {
+        node_reference right = erase_node(node->get_right(), key);
+        return copy_node(node, share(node->get_left()), std::move(right));
+    }
+    return merge(node->get_left(), node->get_right());
+}
+
+} // namespace nstd
+
+#endif //BASICS_PERSISTENT_ORDERED_MAP_HPP
@@ -1,20 +1,42 @@
 #ifndef BASICS_TREAP_HPP
 #define BASICS_TREAP_HPP
 
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <future>
+#include <tuple>
 #include <utility>
 #include <memory>
 #include <chrono>
 #include <random>
-#include <stack>
 #include <treap_base.hpp>
 
 namespace nstd {
 
-template <typename Node, typename Compare, typename Allocator>
-class treap : public treap_base<Node, Allocator> {
-    using base_type = treap_base<Node, Allocator>;
+/**
+ * Execution policy of treap set operations
+ * Set operations recurse into two independent subproblems, which are forked into separate threads
+ * until the thread budget is exhausted or subproblems become smaller than grain size
+ */
+struct set_operation_policy {
+    // count of threads, which may work simultaneously, 1 means sequential execution
+    size_t threads = 1;
+    // subproblems having less total size are solved sequentially
+    size_t grain_size = 1 << 16;
+};
+
+template <typename Node, typename Compare, typename Allocator, typename Priority = random_priority_generator,
+        typename Statistics = no_treap_statistics>
+class treap : public treap_base<Node, Allocator, Priority, Statistics> {
+    using base_type = treap_base<Node, Allocator, Priority, Statistics>;
     using treap_node = Node;
     using node_holder = typename base_type::node_holder;
+    using node_destructor = typename base_type::node_destructor;
+    using tree_builder = typename base_type::tree_builder;
+    using split_collector = typename base_type::split_collector;
+    using tree_list = typename base_type::tree_list;
+    using priority_type = typename base_type::priority_type;
 
 public:
     using key_type = typename treap_node::raw_key_type;
@@ -28,6 +50,16 @@ public:
     using const_iterator = typename base_type::const_iterator;
     using reverse_iterator = typename base_type::reverse_iterator;
     using const_reverse_iterator = typename base_type::const_reverse_iterator;
+    using node_type = typename base_type::node_type;
+
+    /**
+     * Result of node handle insertion, node keeps the handle, when the key was already present
+     */
+    struct insert_return_type {
+        iterator position;
+        bool inserted;
+        node_type node;
+    };
 
 private:
     using base_type::_end;
@@ -58,7 +90,7 @@ private:
 
     /**
      * Merges two nodes into one node
-     * Working complexity is O(log size)
+     * Working complexity is O(log size), works top-down without any extra memory
      * Provides strong exception safety
      * @param node1 node1
      * @param node2 node2
@@ -68,8 +100,8 @@ private:
 
     /**
      * Splits passed node into two nodes with the given key
-     * Working complexity is O(log size)
-     * Provides strong exception safety
+     * Working complexity is O(log size), works top-down without any extra memory
+     * Provides strong exception safety, if comparator throws exception, already split nodes are merged back
      *
      * @tparam KeyIncluded In case of KeyIncluded parameter is true, node having passed key will be in left tree, in the right otherwise
      * @param node splittable node
@@ -78,8 +110,27 @@ private:
      *         And the second tree will consist of nodes, where key is greater than passed key
      *         The node having passed key will be one of this two trees depending on KeyIncluded template parameter
      */
-    template <bool KeyIncluded = false>
-    std::pair<treap_node*, treap_node*> split(treap_node* node, const key_type& key);
+    template <bool KeyIncluded = false, typename K>
+    std::pair<treap_node*, treap_node*> split(treap_node* node, const K& key);
+
+protected:
+    /**
+     * Folds aggregates of the nodes lying in the key interval in key order
+     * Works in O(log size) complexity without tree modification, node must provide monoid aggregate
+     * @tparam EndIncluded determines is end key included into the interval or not
+     * @param begin_key begin key (inclusive endpoint)
+     * @param end_key end key
+     * @return interval aggregate, monoid identity for the empty interval
+     */
+    template <bool EndIncluded>
+    auto key_interval_aggregate(const key_type& begin_key, const key_type& end_key) const;
+
+    /**
+     * Gives aggregate of the whole tree in O(1) complexity
+     */
+    auto tree_aggregate() const;
+
+private:
 
     /**
      * Using split and merge functions
@@ -89,6 +140,43 @@ private:
      */
     iterator insert_node(treap_node* node);
 
+    /**
+     * Place of the key found by one descent
+     * found is the node having the key, if there is no such node, new node with the given priority takes the place
+     * of subtree (the topmost node on the key path having less priority, nullptr for the leaf place) under parent
+     */
+    struct insert_position {
+        treap_node* found = nullptr;
+        treap_node* subtree = nullptr;
+        treap_node* parent = nullptr;
+        bool left = true;
+        // the key is less than all the tree keys
+        bool leftmost = true;
+    };
+
+    /**
+     * Finds the key place for new node with the passed priority in one top-down descent
+     * Works in O(log size) complexity without tree modification
+     */
+    template <typename K>
+    insert_position find_insert_position(const K& key, priority_type priority);
+
+    /**
+     * Finds the key place starting from the hint, which should be the key successor
+     * Walks up from the leaf place adjacent to the hint, so it works in O(1) expected complexity plus hint validation
+     * @return false, when the hint isn't the key successor or the key is present
+     */
+    bool find_hint_position(const_iterator hint, const key_type& key, priority_type priority, insert_position& position);
+
+    /**
+     * Links the node into the place found for its key
+     * The replaced subtree is split by the node key in O(1) expected complexity, then sizes are updated up to the root
+     * @param node detached node having the priority, which the position was found for
+     * @param position key place, the key must be absent
+     * @return node iterator
+     */
+    iterator link_node(treap_node* node, const insert_position& position);
+
 
     /**
      * Returns tree including all the nodes, which has key between passed key interval
@@ -100,8 +188,8 @@ private:
      * @param end_key interval end key (inclusive or exclusive endpoint depend on EndIncluded parameter
      * @return proper tree if there exists any node between interval, nullptr otherwise
      */
-    template <bool EndIncluded = false>
-    treap_node* detach_node_key_interval(const key_type& begin_key, const key_type& end_key);
+    template <bool EndIncluded = false, typename K>
+    treap_node* detach_node_key_interval(const K& begin_key, const K& end_key);
 
     /**
      * Returns node with the passed key
@@ -111,7 +199,123 @@ private:
      * @param key key
      * @return proper node if there exists node with the passed key, nullptr otherwise
      */
-    treap_node* detach_node_with_key(const key_type& key);
+    template <typename K>
+    treap_node* detach_node_with_key(const K& key);
+
+    /**
+     * Inserts all the nodes of the passed tree, which keys are absent in the main tree
+     * Nodes having already existing keys are destroyed
+     * Works in O(log size) complexity, when all the passed tree keys are greater than main tree keys,
+     * in O(tree size * log size) otherwise
+     * @param tree tree, which keys are strictly increasing in in-order sequence
+     */
+    void insert_tree(treap_node* tree);
+
+    /**
+     * Inserts passed tree nodes one by one
+     * @param tree tree to be dismantled
+     */
+    void insert_tree_nodes(treap_node* tree);
+
+    /**
+     * Builds tree from the passed range in O(range size) complexity
+     * Keys, which are not greater than the previous built key, are skipped
+     * @return root of the built tree
+     */
+    template <typename InputIterator>
+    treap_node* build_sorted(InputIterator begin, InputIterator end);
+
+    /**
+     * Splits passed node into nodes having less and greater keys than passed key and detaches the node having the key
+     * Working complexity is O(log size)
+     * If comparator throws exception, the tree is restored and the passed node is set to its root
+     * @param node splittable node
+     * @param key key to be separated with
+     * @return less keys tree, detached node having the key (nullptr if there is no such node) and greater keys tree
+     */
+    std::tuple<treap_node*, treap_node*, treap_node*> split_out(treap_node*& node, const key_type& key);
+
+    /**
+     * Detaches other tree nodes and moves their memory to this tree node pool
+     * If allocators are not equal, nodes are copied to this tree pool and other tree is cleared
+     * @param other other tree
+     * @return root of the detached tree
+     */
+    treap_node* take_tree(treap& other);
+
+    /**
+     * State of set operation recursion branch
+     */
+    struct set_operation_context {
+        // count of threads, which may be used by this branch
+        size_type threads;
+        size_type grain_size;
+        // nodes dropped by this branch, they are destroyed after all the branches are joined
+        tree_list dropped;
+    };
+
+    using set_operation = treap_node* (treap::*)(treap_node*, treap_node*, set_operation_context&);
+
+    /**
+     * Applies set operation to this tree and the passed detached tree, and destroys dropped nodes
+     * @param tree other tree part, which nodes are already in this tree pool
+     * @param policy execution policy
+     * @param operation set operation
+     */
+    void apply_set_operation(treap_node* tree, const set_operation_policy& policy, set_operation operation);
+
+    /**
+     * Solves two independent subproblems of set operation
+     * The left one is solved in a separate thread, when the context has more than one thread
+     * and the subproblems total size is not less than grain size
+     * If a subproblem throws exception, the result of the other one is dropped before rethrowing
+     * @param context current branch context, which thread budget is shared between subproblems
+     * @param size subproblems total size
+     * @return left and right subproblem results
+     */
+    template <typename LeftTask, typename RightTask>
+    std::pair<treap_node*, treap_node*> fork(set_operation_context& context, size_type size,
+                                             LeftTask left_task, RightTask right_task);
+
+    /**
+     * Detaches the passed node children and drops it
+     */
+    static void drop_node(treap_node* node, set_operation_context& context) noexcept;
+
+    /**
+     * Replaces node having the same key in the tree structure with the passed node
+     * Passed node takes the replaced node priority and children, replaced node is dropped
+     * @return passed node
+     */
+    static treap_node* replace_node(treap_node* replaced, treap_node* node, set_operation_context& context) noexcept;
+
+    /**
+     * Drops the pieces of the branch, which caught exception, so no nodes are left unreachable
+     * @param root branch root, its children are detached
+     * @param trees pieces, which were not passed to the subproblems
+     */
+    static void drop_pieces(set_operation_context& context, treap_node* root,
+                            std::initializer_list<treap_node*> trees) noexcept;
+
+    /**
+     * Set operations on the detached trees
+     * Working complexity is O(m log(n / m + 1)), where m and n are the sizes of smaller and greater trees
+     * The first tree nodes belong to this tree, so when keys are equal, the first tree node is kept
+     * Not kept nodes are dropped, all the kept nodes are relinked without reallocation
+     * If comparator throws exception, all the nodes of the passed trees are dropped
+     * Pieces are passed to the subproblems only when they start, so each piece is dropped by one branch
+     * @param node1 this tree part
+     * @param node2 other tree part
+     * @param context recursion branch context
+     * @return resulting tree
+     */
+    treap_node* unite(treap_node* node1, treap_node* node2, set_operation_context& context);
+
+    treap_node* intersect(treap_node* node1, treap_node* node2, set_operation_context& context);
+
+    treap_node* subtract(treap_node* node1, treap_node* node2, set_operation_context& context);
+
+    treap_node* subtract_symmetric(treap_node* node1, treap_node* node2, set_operation_context& context);
 
 public:
     void swap(treap& other) noexcept;
@@ -120,11 +324,41 @@ public:
 
     std::pair<iterator, bool> insert(value_type&& value);
 
+    /**
+     * Inserts range elements, which keys are absent in the tree
+     * Strictly increasing runs of the range are built in linear time and then inserted in the tree at once,
+     * so for sorted range working complexity is O(range size) when the tree is empty
+     * or all the range keys are greater than the tree keys
+     * Otherwise works in O(range size * log size) complexity
+     * @param begin range begin
+     * @param end range end
+     */
     template <typename InputIterator>
     void insert(InputIterator begin, InputIterator end);
 
     void insert(std::initializer_list<value_type> il);
 
+    /**
+     * Replaces tree content with the passed sorted range elements
+     * Working complexity is O(range size)
+     * Keys, which are not greater than the previous one, are skipped, so for unsorted range only its sorted subsequence is kept
+     * Provides strong exception safety
+     * @param begin range begin
+     * @param end range end
+     */
+    template <typename InputIterator>
+    void assign_sorted(InputIterator begin, InputIterator end);
+
+    /**
+     * Replaces tree content with the data written by save function
+     * Working complexity is O(stream size + size), nodes are linked without comparisons against the tree
+     * Stored priorities are used when they are present, so the tree gets the saved shape
+     * Provides strong exception safety
+     * @param stream input stream
+     * Throws serialization_error, when the stream data is invalid or its keys aren't strictly increasing
+     */
+    void load(std::istream& stream);
+
     /**
      * Inserts a node in the tree with the value constructed with passed arguments
      * If the key already exists, nothing happens
@@ -136,7 +370,25 @@ public:
     template <typename... Args>
     std::pair<iterator, bool> emplace(Args&& ... args);
 
-private:
+    /**
+     * Inserts a node with the value constructed with passed arguments, when its key is absent
+     * When the hint is the key successor, works in O(1) expected complexity plus sizes update on the path to the root,
+     * otherwise works like emplace
+     * @param hint iterator pointing on the element, before which the new one would be inserted
+     * @param args args
+     * @return iterator of the inserted element or the element with the same key
+     */
+    template <typename... Args>
+    iterator emplace_hint(const_iterator hint, Args&& ... args);
+
+protected:
+    /**
+     * Inserts a node with the value constructed with passed arguments, when the key is absent
+     * Key place is found in one descent and the value is constructed only, when the key is absent
+     * @param key key of the constructed value
+     * @param args args
+     * @return pair of the key iterator and boolean showing whether the key was inserted or not
+     */
     template <typename... Args>
     std::pair<iterator, bool> emplace_with_key(const key_type& key, Args&& ... args);
 
@@ -171,8 +423,81 @@ public:
      */
     iterator erase_key(const key_type& key);
 
+    /**
+     * Heterogeneous overload of erase_key, is available only for transparent comparators
+     */
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    iterator erase_key(const K& key);
+
     using base_type::erase;
 
+public:
+    /**
+     * Detaches the node from the tree and gives it in node handle
+     * Value isn't copied or moved, node memory stays valid after the tree destruction
+     * Works in O(log size) complexity
+     * @param position iterator of the extracted node, must be dereferenceable
+     * @return node handle
+     */
+    node_type extract(const_iterator position);
+
+    /**
+     * Extracts the node with the passed key
+     * @param key key
+     * @return node handle, empty if the tree doesn't have the key
+     */
+    node_type extract(const key_type& key);
+
+    /**
+     * Links the handle node into the tree, when its key is absent
+     * Works in O(log size) complexity without allocations of tree nodes,
+     * when handle allocator isn't equal to the tree allocator, new node is constructed from the moved value
+     * @param handle node handle
+     * @return inserted or found node iterator, insertion flag and the handle, when the node wasn't inserted
+     */
+    insert_return_type insert(node_type&& handle);
+
+    /**
+     * Moves to this tree the other tree nodes, which keys are absent in this tree
+     * Nodes are relinked without copying their values, other tree keeps the nodes having present keys
+     * Works in O(other size * log (size + other size)) complexity
+     * @param other other tree ordered with the equivalent comparator
+     */
+    void merge(treap& other);
+
+    void merge(treap&& other);
+
+public:
+    /**
+     * Set operations, which replace tree content with the result of operation with the passed tree
+     * Rvalue overloads steal other tree nodes, so surviving nodes are relinked without reallocation and other tree becomes empty
+     * Const reference overloads copy other tree nodes in O(other size) complexity before the operation
+     * Working complexity is O(m log(n / m + 1)), where m and n are the sizes of smaller and greater trees
+     * When keys are equal, this tree element is kept
+     * Other tree is supposed to be ordered with the equivalent comparator
+     * With parallel policy subproblems are solved by fork-join over policy threads, so comparator must be thread safe
+     * If comparator throws exception, this tree becomes empty and rvalue other tree is empty either,
+     * const reference overloads keep this tree unchanged, if exception is thrown while copying other tree
+     * @param other other tree
+     * @param policy execution policy, sequential by default
+     */
+    void set_union(treap&& other, const set_operation_policy& policy = set_operation_policy());
+
+    void set_union(const treap& other, const set_operation_policy& policy = set_operation_policy());
+
+    void set_intersection(treap&& other, const set_operation_policy& policy = set_operation_policy());
+
+    void set_intersection(const treap& other, const set_operation_policy& policy = set_operation_policy());
+
+    void set_difference(treap&& other, const set_operation_policy& policy = set_operation_policy());
+
+    void set_difference(const treap& other, const set_operation_policy& policy = set_operation_policy());
+
+    void set_symmetric_difference(treap&& other, const set_operation_policy& policy = set_operation_policy());
+
+    void set_symmetric_difference(const treap& other, const set_operation_policy& policy = set_operation_policy());
+
+public:
     bool contains(const key_type& key) const;
 
     /**
@@ -220,6 +545,109 @@ public:
      */
     size_type order_of_key(const key_type& key) const;
 
+    /**
+     * Heterogeneous overloads of the key searching functions above
+     * Are available only for transparent comparators (having is_transparent member type), e.g. std::less<>
+     * The passed key is compared with the tree keys directly, so no temporary key_type object is constructed
+     * @tparam K any type comparable with key_type by the comparator
+     */
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    bool contains(const K& key) const;
+
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    iterator find(const K& key);
+
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    const_iterator find(const K& key) const;
+
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    iterator lower_bound(const K& key);
+
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    const_iterator lower_bound(const K& key) const;
+
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    iterator upper_bound(const K& key);
+
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    const_iterator upper_bound(const K& key) const;
+
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    size_type order_of_key(const K& key) const;
+
+    /**
+     * Finger search versions of the lookups above, the search starts from the hint instead of the root
+     * Work in O(log d) expected complexity, where d is the order distance between the hint and the result,
+     * so lookups of keys close to the previous one, e.g. in merge joins, don't descend from the root
+     * Any iterator of the tree including end is a valid hint, far hints cost O(log size) like plain lookups
+     */
+    iterator find(const_iterator hint, const key_type& key);
+
+    const_iterator find(const_iterator hint, const key_type& key) const;
+
+    iterator lower_bound(const_iterator hint, const key_type& key);
+
+    const_iterator lower_bound(const_iterator hint, const key_type& key) const;
+
+    iterator upper_bound(const_iterator hint, const key_type& key);
+
+    const_iterator upper_bound(const_iterator hint, const key_type& key) const;
+
+    /**
+     * The key is found by finger search, then its order is counted on the way to the root
+     * The count takes O(log size) steps, but doesn't compare keys
+     */
+    size_type order_of_key(const_iterator hint, const key_type& key) const;
+
+    /**
+     * Batched versions of the lookups above
+     * Keys must be sorted by the tree comparator, duplicates are allowed
+     * All the keys are resolved in one coordinated descent, which visits every node at most once
+     * Works in O (m log (size / m)) expected complexity for m keys instead of O (m log size)
+     * Results are written to the output iterator in the keys order
+     * @param begin begin of the sorted keys range
+     * @param end end of the sorted keys range
+     * @param out output iterator
+     * @return output iterator past the last written result
+     */
+    template <typename ForwardIterator, typename OutputIterator>
+    OutputIterator find_many(ForwardIterator begin, ForwardIterator end, OutputIterator out);
+
+    template <typename ForwardIterator, typename OutputIterator>
+    OutputIterator find_many(ForwardIterator begin, ForwardIterator end, OutputIterator out) const;
+
+    template <typename ForwardIterator, typename OutputIterator>
+    OutputIterator contains_many(ForwardIterator begin, ForwardIterator end, OutputIterator out) const;
+
+    template <typename ForwardIterator, typename OutputIterator>
+    OutputIterator lower_bound_many(ForwardIterator begin, ForwardIterator end, OutputIterator out);
+
+    template <typename ForwardIterator, typename OutputIterator>
+    OutputIterator lower_bound_many(ForwardIterator begin, ForwardIterator end, OutputIterator out) const;
+
+    /**
+     * Batched order_of_key, writes size() for the keys the tree doesn't have
+     */
+    template <typename ForwardIterator, typename OutputIterator>
+    OutputIterator order_of_keys(ForwardIterator begin, ForwardIterator end, OutputIterator out) const;
+
+    /**
+     * Batched find for unsorted keys
+     * Keeps batch_lookup_lanes independent descents in flight, moves each of them one level per pass
+     * and prefetches the next nodes, so cache misses of different keys overlap
+     * Gives a speedup over plain find loop, when the tree doesn't fit in cache
+     * Works in O (m log size) complexity, results are written to the output iterator in the keys order
+     * @param begin begin of the keys range
+     * @param end end of the keys range
+     * @param out output iterator
+     * @return output iterator past the last written result
+     */
+    template <typename ForwardIterator, typename OutputIterator>
+    OutputIterator find_batch(ForwardIterator begin, ForwardIterator end, OutputIterator out);
+
+    template <typename ForwardIterator, typename OutputIterator>
+    OutputIterator find_batch(ForwardIterator begin, ForwardIterator end, OutputIterator out) const;
+
     using base_type::size;
 
     using base_type::empty;
@@ -231,17 +659,57 @@ private:
      * @param key key
      * @return proper ndoe, when the tree has the key, end node otherwise
      */
-    treap_node* node_of_key(const key_type& key);
+    template <typename K>
+    treap_node* node_of_key(const K& key);
+
+    template <typename K>
+    const treap_node* node_of_key(const K& key) const;
+
+    template <typename K>
+    treap_node* lower_bound_node(const K& key);
+
+    template <typename K>
+    const treap_node* lower_bound_node(const K& key) const;
 
-    const treap_node* node_of_key(const key_type& key) const;
+    template <typename K>
+    treap_node* upper_bound_node(const K& key);
 
-    treap_node* lower_bound_node(const key_type& key);
+    template <typename K>
+    const treap_node* upper_bound_node(const K& key) const;
 
-    const treap_node* lower_bound_node(const key_type& key) const;
+    /**
+     * Finds the lower bound (upper bound, when KeyIncluded is true) of the key starting from the hint
+     */
+    template <bool KeyIncluded>
+    const treap_node* bound_node_from(const_iterator hint, const key_type& key) const;
 
-    treap_node* upper_bound_node(const key_type& key);
+    /**
+     * Resolves the sorted keys range in the subtree of the node
+     * Reports each run of keys with the same lower bound node as handler(begin, end, lower bound, its order, found)
+     * found is true, when the keys are equal to the lower bound node key
+     * Runs are reported in the keys order
+     * @param node subtree root
+     * @param begin begin of the sorted keys range
+     * @param end end of the sorted keys range
+     * @param bound lower bound node of the keys greater than all the subtree keys
+     * @param offset count of the tree keys less than all the subtree keys
+     * @param handler run handler
+     */
+    template <typename ForwardIterator, typename Handler>
+    void resolve_sorted(const treap_node* node, ForwardIterator begin, ForwardIterator end, const treap_node* bound,
+                        size_type offset, Handler& handler) const;
 
-    const treap_node* upper_bound_node(const key_type& key) const;
+    // count of the descents interleaved by find_batch
+    static constexpr size_type batch_lookup_lanes = 16;
+
+    /**
+     * Finds the keys by interleaved descents, reports each found node or end node as handler(node) in the keys order
+     * @param begin begin of the keys range
+     * @param end end of the keys range
+     * @param handler result handler
+     */
+    template <typename ForwardIterator, typename Handler>
+    void resolve_batch(ForwardIterator begin, ForwardIterator end, Handler& handler) const;
 
 public:
     using base_type::begin;
@@ -262,25 +730,23 @@ public:
 
 };
 
-template <typename Node, typename Compare, typename Allocator>
-treap<Node, Compare, Allocator>::treap(const key_compare& comparator, const allocator_type& allocator)
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+treap<Node, Compare, Allocator, Priority, Statistics>::treap(const key_compare& comparator, const allocator_type& allocator)
         : base_type(allocator), _comparator(comparator) {}
 
-template <typename Node, typename Compare, typename Allocator>
-treap<Node, Compare, Allocator>::treap(const treap& other)
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+treap<Node, Compare, Allocator, Priority, Statistics>::treap(const treap& other)
         : base_type(other), _comparator(other._comparator) {
-    for (auto it = other.begin(); it != other.end(); ++it) {
-        insert(*it);
-    }
+    assign_sorted(other.begin(), other.end());
 }
 
-template <typename Node, typename Compare, typename Allocator>
-treap<Node, Compare, Allocator>::treap(treap&& other) noexcept
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+treap<Node, Compare, Allocator, Priority, Statistics>::treap(treap&& other) noexcept
         : base_type(std::move(other)), _comparator(std::move(other._comparator)) {}
 
-template <typename Node, typename Compare, typename Allocator>
-treap<Node, Compare, Allocator>&
-treap<Node, Compare, Allocator>::operator=(const treap& other) {
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+treap<Node, Compare, Allocator, Priority, Statistics>&
+treap<Node, Compare, Allocator, Priority, Statistics>::operator=(const treap& other) {
     if (this != &other) {
         treap copied(other);
         this->swap(copied);
@@ -288,9 +754,9 @@ treap<Node, Compare, Allocator>::operator=(const treap& other) {
     return *this;
 }
 
-template <typename Node, typename Compare, typename Allocator>
-treap<Node, Compare, Allocator>&
-treap<Node, Compare, Allocator>::operator=(treap&& other) noexcept {
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+treap<Node, Compare, Allocator, Priority, Statistics>&
+treap<Node, Compare, Allocator, Priority, Statistics>::operator=(treap&& other) noexcept {
     if (this != &other) {
         treap moved(std::move(other));
         this->swap(moved);
@@ -298,101 +764,109 @@ treap<Node, Compare, Allocator>::operator=(treap&& other) noexcept {
     return *this;
 }
 
-template <typename Node, typename Compare, typename Allocator>
-typename treap<Node, Compare, Allocator>::treap_node*
-treap<Node, Compare, Allocator>::merge(treap_node* node1, treap_node* node2) {
-    // return nullptr when both values are null pointers
-    if (node1 == nullptr && node2 == nullptr) {
-        return nullptr;
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::treap_node*
+treap<Node, Compare, Allocator, Priority, Statistics>::merge(treap_node* node1, treap_node* node2) {
+    if (node1 == nullptr) {
+        return node2;
+    }
+    if (node2 == nullptr) {
+        return node1;
+    }
+    // after this operator we can suppose that node1 keys are less than node2 keys
+    // this is the only comparison, so exception can be thrown only before any modification
+    if (_comparator(node2->get_key(), node1->get_key())) {
+        std::swap(node1, node2);
     }
+    return base_type::merge_with_index(node1, node2);
+}
 
-    // stack for collecting node values
-    std::stack<treap_node*> nodes;
-    // stack for collecting priority comparisons
-    std::stack<bool> compares;
-    while (node1 != nullptr && node2 != nullptr) {
-        // after this operator we can suppose that node1.key <= node2.key
-        if (_comparator(node2->get_key(), node1->get_key())) {
-            std::swap(node1, node2);
-        }
-        // save comparison result in stack
-        bool compare = node1->get_priority() > node2->get_priority();
-        compares.push(compare);
-        // save corresponding node and update node1 and node2
-        if (compare) {
-            nodes.push(node1);
-            node1 = node1->get_right();
-            continue;
-        }
-        nodes.push(node2);
-        node2 = node2->get_left();
-    }
-    // child will be non-null node among node1 and node2
-    treap_node* child = (node1 == nullptr ? node2 : node1);
-    // child will be the last merge result
-    while (!compares.empty()) {
-        // parent of the child node
-        treap_node* parent_node = nodes.top();
-        nodes.pop();
-        // comparison result
-        bool compare = compares.top();
-        compares.pop();
-        // merge parent_node with child
-        if (compare) {
-            parent_node->set_right(child);
-            child = parent_node;
-            continue;
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <bool KeyIncluded, typename K>
+auto
+treap<Node, Compare, Allocator, Priority, Statistics>::split(treap_node* node,
+                                       const K& key) -> std::pair<treap_node*, treap_node*> {
+    base_type::_statistics.count_split();
+    split_collector collector;
+    try {
+        while (node != nullptr) {
+            bool compare = (KeyIncluded ? !_comparator(key, node->get_key()) : _comparator(node->get_key(), key));
+            if (compare) {
+                collector.push_left(node);
+                node = node->get_right();
+                continue;
+            }
+            collector.push_right(node);
+            node = node->get_left();
         }
-        parent_node->set_left(child);
-        child = parent_node;
+    } catch (...) {
+        // all the left tree nodes go before the non-split subtree and all the right tree nodes go after it,
+        // so merging them back restores the tree
+        auto [left, right] = collector.release();
+        base_type::merge_with_index(base_type::merge_with_index(left, node), right);
+        throw;
     }
-    return child;
+    return collector.release();
 }
 
-template <typename Node, typename Compare, typename Allocator>
-template <bool KeyIncluded>
-auto
-treap<Node, Compare, Allocator>::split(treap_node* node,
-                                       const key_type& key) -> std::pair<treap_node*, treap_node*> {
-    std::stack<treap_node*> nodes;
-    std::stack<bool> compares;
-    // gather all splittable nodes in stack
-    nodes.push(node);
-    while (nodes.top() != nullptr) {
-        auto* top = nodes.top();
-        bool compare = (KeyIncluded ? !_comparator(key, top->get_key()) : _comparator(top->get_key(), key));
-        nodes.push(compare ? top->get_right() : top->get_left());
-        // store comparison results in separate stack
-        compares.push(compare);
-    }
-    // here we need two null pointers at the top of the stack
-    nodes.push(nullptr);
-    // in this point nodes count is greater comparison count by 2
-    // so when the compares stack is empty, in nodes stack will be left two nodes, which are split results
-    while (!compares.empty()) {
-        bool compare = compares.top();
-        auto* second = nodes.top();
-        compares.pop(), nodes.pop();
-        auto* first = nodes.top();
-        nodes.pop();
-        if (compare) {
-            nodes.top()->set_right(first);
-            nodes.push(second);
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <bool EndIncluded>
+auto treap<Node, Compare, Allocator, Priority, Statistics>::key_interval_aggregate(const key_type& begin_key, const key_type& end_key) const {
+    using monoid_type = typename treap_node::monoid_type;
+    using aggregate_type = typename treap_node::aggregate_type;
+    auto before_end = [this, &end_key](const treap_node* node) {
+        return EndIncluded ? !_comparator(end_key, node->get_key()) : _comparator(node->get_key(), end_key);
+    };
+    // find the highest node lying in the interval, it separates the interval into suffix and prefix parts
+    const treap_node* node = root();
+    while (node != nullptr) {
+        if (_comparator(node->get_key(), begin_key)) {
+            node = node->get_right();
+        } else if (!before_end(node)) {
+            node = node->get_left();
+        } else {
+            break;
+        }
+    }
+    if (node == nullptr) {
+        return monoid_type::identity();
+    }
+    aggregate_type result = node->get_own_aggregate();
+    // the left subtree part, which keys are not less than begin key, is folded from right to left
+    for (const treap_node* left = node->get_left(); left != nullptr;) {
+        if (_comparator(left->get_key(), begin_key)) {
+            left = left->get_right();
+            continue;
+        }
+        if (left->get_right() != nullptr) {
+            result = monoid_type::combine(left->get_right()->get_aggregate(), result);
+        }
+        result = monoid_type::combine(left->get_own_aggregate(), result);
+        left = left->get_left();
+    }
+    // the right subtree part, which keys are before end key, is folded from left to right
+    for (const treap_node* right = node->get_right(); right != nullptr;) {
+        if (!before_end(right)) {
+            right = right->get_left();
             continue;
         }
-        nodes.top()->set_left(second);
-        std::swap(nodes.top(), first);
-        nodes.push(first);
+        if (right->get_left() != nullptr) {
+            result = monoid_type::combine(result, right->get_left()->get_aggregate());
+        }
+        result = monoid_type::combine(result, right->get_own_aggregate());
+        right = right->get_right();
     }
-    // return last two nodes in nodes stack
-    auto* second = nodes.top();
-    nodes.pop();
-    auto* first = nodes.top();
-    return {first, second};
+    return result;
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+auto treap<Node, Compare, Allocator, Priority, Statistics>::tree_aggregate() const {
+    using monoid_type = typename treap_node::monoid_type;
+    return (root() != nullptr ? root()->get_aggregate() : monoid_type::identity());
 }
 
-template <typename Node, typename Compare, typename Allocator>
-typename treap<Node, Compare, Allocator>::iterator treap<Node, Compare, Allocator>::insert_node(treap_node* node) {
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::iterator treap<Node, Compare, Allocator, Priority, Statistics>::insert_node(treap_node* node) {
     auto [left, right] = split(root(), node->get_key());
     treap_node* root = merge(merge(left, node), right);
     set_root(root);
@@ -402,10 +876,10 @@ typename treap<Node, Compare, Allocator>::iterator treap<Node, Compare, Allocato
     return {node};
 }
 
-template <typename Node, typename Compare, typename Allocator>
-template <bool EndIncluded>
-typename treap<Node, Compare, Allocator>::treap_node*
-treap<Node, Compare, Allocator>::detach_node_key_interval(const key_type& begin_key, const key_type& end_key) {
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <bool EndIncluded, typename K>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::treap_node*
+treap<Node, Compare, Allocator, Priority, Statistics>::detach_node_key_interval(const K& begin_key, const K& end_key) {
     auto [left, begin_included_tree] = split(root(), begin_key);
     auto [interval, right] = split<EndIncluded>(begin_included_tree, end_key);
     treap_node* root = merge(left, right);
@@ -416,112 +890,783 @@ treap<Node, Compare, Allocator>::detach_node_key_interval(const key_type& begin_
     return interval;
 }
 
-template <typename Node, typename Compare, typename Allocator>
-typename treap<Node, Compare, Allocator>::treap_node*
-treap<Node, Compare, Allocator>::detach_node_with_key(const key_type& key) {
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <typename K>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::treap_node*
+treap<Node, Compare, Allocator, Priority, Statistics>::detach_node_with_key(const K& key) {
     return detach_node_key_interval<true>(key, key);
 }
 
-template <typename Node, typename Compare, typename Allocator>
-void treap<Node, Compare, Allocator>::swap(treap<Node, Compare, Allocator>& other) noexcept {
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+void treap<Node, Compare, Allocator, Priority, Statistics>::insert_tree(treap_node* tree) {
+    if (tree == nullptr) {
+        return;
+    }
+    if (root() == nullptr) {
+        set_root(tree);
+        adjust_begin();
+        return;
+    }
+    const treap_node* last = root();
+    while (last->get_right() != nullptr) {
+        last = last->get_right();
+    }
+    bool appendable;
+    try {
+        appendable = _comparator(last->get_key(), tree->find_begin()->get_key());
+    } catch (...) {
+        base_type::destroy_tree(tree);
+        throw;
+    }
+    if (appendable) {
+        set_root(merge(root(), tree));
+        return;
+    }
+    insert_tree_nodes(tree);
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+void treap<Node, Compare, Allocator, Priority, Statistics>::insert_tree_nodes(treap_node* tree) {
+    if (tree == nullptr) {
+        return;
+    }
+    treap_node* left = tree->get_left();
+    treap_node* right = tree->get_right();
+    // detach tree root and take the ownership
+    tree->set_members(tree->get_priority());
+    node_holder holder(tree, node_destructor(base_type::_node_pool, true));
+    try {
+        insert_tree_nodes(left);
+    } catch (...) {
+        base_type::destroy_tree(right);
+        throw;
+    }
+    insert_tree_nodes(right);
+    if (node_of_key(holder->get_key()) == end_node()) {
+        insert_node(holder.get());
+        holder.release();
+    }
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <typename InputIterator>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::treap_node*
+treap<Node, Compare, Allocator, Priority, Statistics>::build_sorted(InputIterator begin, InputIterator end) {
+    tree_builder builder;
+    try {
+        for (; begin != end; ++begin) {
+            node_holder holder = base_type::construct_node(*begin);
+            treap_node* last = builder.last();
+            if (last == nullptr || _comparator(last->get_key(), holder->get_key())) {
+                builder.push_back(holder.release());
+            }
+        }
+    } catch (...) {
+        base_type::destroy_tree(builder.release());
+        throw;
+    }
+    return builder.release();
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+auto treap<Node, Compare, Allocator, Priority, Statistics>::split_out(treap_node*& tree, const key_type& key)
+-> std::tuple<treap_node*, treap_node*, treap_node*> {
+    base_type::_statistics.count_split();
+    split_collector collector;
+    treap_node* node = tree;
+    try {
+        while (node != nullptr) {
+            if (_comparator(node->get_key(), key)) {
+                collector.push_left(node);
+                node = node->get_right();
+                continue;
+            }
+            if (_comparator(key, node->get_key())) {
+                collector.push_right(node);
+                node = node->get_left();
+                continue;
+            }
+            // node children complete the split trees
+            auto [left, right] = collector.release(node->get_left(), node->get_right());
+            node->set_members(node->get_priority());
+            return {left, node, right};
+        }
+    } catch (...) {
+        // the same rollback as in split, merging may choose another root for equal priorities
+        auto [left, right] = collector.release();
+        tree = base_type::merge_with_index(base_type::merge_with_index(left, node), right);
+        throw;
+    }
+    auto [left, right] = collector.release();
+    return {left, nullptr, right};
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::treap_node* treap<Node, Compare, Allocator, Priority, Statistics>::take_tree(treap& other) {
+    if (!base_type::splice_pool(other)) {
+        treap_node* tree = build_sorted(other.begin(), other.end());
+        other.clear();
+        return tree;
+    }
+    treap_node* tree = other.root();
+    other.set_root(nullptr);
+    other.adjust_begin();
+    return tree;
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+void treap<Node, Compare, Allocator, Priority, Statistics>::apply_set_operation(treap_node* tree, const set_operation_policy& policy,
+                                                          set_operation operation) {
+    set_operation_context context{std::max<size_type>(policy.threads, 1), policy.grain_size, {}};
+    try {
+        set_root((this->*operation)(root(), tree, context));
+    } catch (...) {
+        // the failed operation has dropped all the nodes of both trees
+        set_root(nullptr);
+        adjust_begin();
+        base_type::destroy_trees(context.dropped);
+        throw;
+    }
+    adjust_begin();
+    base_type::destroy_trees(context.dropped);
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <typename LeftTask, typename RightTask>
+auto treap<Node, Compare, Allocator, Priority, Statistics>::fork(set_operation_context& context, size_type size,
+                                           LeftTask left_task, RightTask right_task)
+-> std::pair<treap_node*, treap_node*> {
+    if (context.threads <= 1 || size < context.grain_size) {
+        treap_node* left = left_task(context);
+        try {
+            return {left, right_task(context)};
+        } catch (...) {
+            // the solved branch is dropped, so its nodes are destroyed with the other dropped ones
+            context.dropped.push(left);
+            throw;
+        }
+    }
+    // thread budget is shared between the branches
+    set_operation_context left_context{context.threads / 2, context.grain_size, {}};
+    set_operation_context right_context{context.threads - left_context.threads, context.grain_size, {}};
+    auto left_future = std::async(std::launch::async, left_task, std::ref(left_context));
+    treap_node* left = nullptr;
+    treap_node* right = nullptr;
+    std::exception_ptr exception;
+    try {
+        right = right_task(right_context);
+    } catch (...) {
+        exception = std::current_exception();
+    }
+    try {
+        left = left_future.get();
+    } catch (...) {
+        exception = std::current_exception();
+    }
+    // dropped nodes are destroyed by the calling thread
+    context.dropped.splice(left_context.dropped);
+    context.dropped.splice(right_context.dropped);
+    if (exception) {
+        context.dropped.push(left);
+        context.dropped.push(right);
+        std::rethrow_exception(exception);
+    }
+    return {left, right};
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+void treap<Node, Compare, Allocator, Priority, Statistics>::drop_node(treap_node* node, set_operation_context& context) noexcept {
+    node->set_members(node->get_priority());
+    context.dropped.push(node);
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::treap_node*
+treap<Node, Compare, Allocator, Priority, Statistics>::replace_node(treap_node* replaced, treap_node* node,
+                                              set_operation_context& context) noexcept {
+    treap_node* left = replaced->get_left();
+    treap_node* right = replaced->get_right();
+    node->set_members(replaced->get_priority());
+    node->set_left(left);
+    node->set_right(right);
+    drop_node(replaced, context);
+    return node;
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+void treap<Node, Compare, Allocator, Priority, Statistics>::drop_pieces(set_operation_context& context, treap_node* root,
+                                                  std::initializer_list<treap_node*> trees) noexcept {
+    drop_node(root, context);
+    for (treap_node* tree: trees) {
+        context.dropped.push(tree);
+    }
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::treap_node*
+treap<Node, Compare, Allocator, Priority, Statistics>::unite(treap_node* node1, treap_node* node2, set_operation_context& context) {
+    if (node1 == nullptr) {
+        return node2;
+    }
+    if (node2 == nullptr) {
+        return node1;
+    }
+    size_type size = node1->size() + node2->size();
+    // the root with the greater priority stays, the other tree is split by its key
+    bool first_root = node1->get_priority() >= node2->get_priority();
+    treap_node* root = (first_root ? node1 : node2);
+    treap_node* other = (first_root ? node2 : node1);
+    treap_node* root_left = root->get_left();
+    treap_node* root_right = root->get_right();
+    treap_node* left = nullptr;
+    treap_node* right = nullptr;
+    try {
+        treap_node* equal;
+        std::tie(left, equal, right) = split_out(other, root->get_key());
+        other = nullptr;
+        if (equal != nullptr) {
+            if (first_root) {
+                drop_node(equal, context);
+            } else {
+                // this tree node is kept in the node2 place
+                root = replace_node(root, equal, context);
+            }
+        }
+        // keep this tree parts as the first arguments, subproblems take their pieces, when they start
+        auto [result_left, result_right] = fork(
+                context, size,
+                [&](set_operation_context& branch) {
+                    treap_node* part = std::exchange(left, nullptr);
+                    treap_node* root_part = std::exchange(root_left, nullptr);
+                    return first_root ? unite(root_part, part, branch) : unite(part, root_part, branch);
+                },
+                [&](set_operation_context& branch) {
+                    treap_node* part = std::exchange(right, nullptr);
+                    treap_node* root_part = std::exchange(root_right, nullptr);
+                    return first_root ? unite(root_part, part, branch) : unite(part, root_part, branch);
+                });
+        root->set_left(result_left);
+        root->set_right(result_right);
+        return root;
+    } catch (...) {
+        drop_pieces(context, root, {other, root_left, root_right, left, right});
+        throw;
+    }
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::treap_node*
+treap<Node, Compare, Allocator, Priority, Statistics>::intersect(treap_node* node1, treap_node* node2, set_operation_context& context) {
+    if (node1 == nullptr || node2 == nullptr) {
+        context.dropped.push(node1);
+        context.dropped.push(node2);
+        return nullptr;
+    }
+    size_type size = node1->size() + node2->size();
+    bool first_root = node1->get_priority() >= node2->get_priority();
+    treap_node* root = (first_root ? node1 : node2);
+    treap_node* other = (first_root ? node2 : node1);
+    treap_node* root_left = root->get_left();
+    treap_node* root_right = root->get_right();
+    treap_node* left = nullptr;
+    treap_node* right = nullptr;
+    try {
+        treap_node* equal;
+        std::tie(left, equal, right) = split_out(other, root->get_key());
+        other = nullptr;
+        if (equal != nullptr) {
+            if (first_root) {
+                drop_node(equal, context);
+            } else {
+                // this tree node is kept in the root place
+                root = replace_node(root, equal, context);
+            }
+        }
+        // keep this tree parts as the first arguments
+        auto [result_left, result_right] = fork(
+                context, size,
+                [&](set_operation_context& branch) {
+                    treap_node* part = std::exchange(left, nullptr);
+                    treap_node* root_part = std::exchange(root_left, nullptr);
+                    return first_root ? intersect(root_part, part, branch) : intersect(part, root_part, branch);
+                },
+                [&](set_operation_context& branch) {
+                    treap_node* part = std::exchange(right, nullptr);
+                    treap_node* root_part = std::exchange(root_right, nullptr);
+                    return first_root ? intersect(root_part, part, branch) : intersect(part, root_part, branch);
+                });
+        if (equal == nullptr) {
+            drop_node(root, context);
+            return base_type::merge_with_index(result_left, result_right);
+        }
+        root->set_left(result_left);
+        root->set_right(result_right);
+        return root;
+    } catch (...) {
+        drop_pieces(context, root, {other, root_left, root_right, left, right});
+        throw;
+    }
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::treap_node*
+treap<Node, Compare, Allocator, Priority, Statistics>::subtract(treap_node* node1, treap_node* node2, set_operation_context& context) {
+    if (node1 == nullptr) {
+        context.dropped.push(node2);
+        return nullptr;
+    }
+    if (node2 == nullptr) {
+        return node1;
+    }
+    size_type size = node1->size() + node2->size();
+    // node1 subtrees lose nodes, but node1 priority remains the greatest one
+    treap_node* other = node2;
+    treap_node* root_left = node1->get_left();
+    treap_node* root_right = node1->get_right();
+    treap_node* left = nullptr;
+    treap_node* right = nullptr;
+    try {
+        treap_node* equal;
+        std::tie(left, equal, right) = split_out(other, node1->get_key());
+        other = nullptr;
+        if (equal != nullptr) {
+            drop_node(equal, context);
+        }
+        auto [result_left, result_right] = fork(
+                context, size,
+                [&](set_operation_context& branch) {
+                    treap_node* part = std::exchange(left, nullptr);
+                    return subtract(std::exchange(root_left, nullptr), part, branch);
+                },
+                [&](set_operation_context& branch) {
+                    treap_node* part = std::exchange(right, nullptr);
+                    return subtract(std::exchange(root_right, nullptr), part, branch);
+                });
+        if (equal != nullptr) {
+            drop_node(node1, context);
+            return base_type::merge_with_index(result_left, result_right);
+        }
+        node1->set_left(result_left);
+        node1->set_right(result_right);
+        return node1;
+    } catch (...) {
+        drop_pieces(context, node1, {other, root_left, root_right, left, right});
+        throw;
+    }
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::treap_node*
+treap<Node, Compare, Allocator, Priority, Statistics>::subtract_symmetric(treap_node* node1, treap_node* node2,
+                                                    set_operation_context& context) {
+    if (node1 == nullptr) {
+        return node2;
+    }
+    if (node2 == nullptr) {
+        return node1;
+    }
+    size_type size = node1->size() + node2->size();
+    bool first_root = node1->get_priority() >= node2->get_priority();
+    treap_node* root = (first_root ? node1 : node2);
+    treap_node* other = (first_root ? node2 : node1);
+    treap_node* root_left = root->get_left();
+    treap_node* root_right = root->get_right();
+    treap_node* left = nullptr;
+    treap_node* right = nullptr;
+    try {
+        treap_node* equal;
+        std::tie(left, equal, right) = split_out(other, root->get_key());
+        other = nullptr;
+        if (equal != nullptr) {
+            drop_node(equal, context);
+        }
+        auto [result_left, result_right] = fork(
+                context, size,
+                [&](set_operation_context& branch) {
+                    treap_node* part = std::exchange(left, nullptr);
+                    return subtract_symmetric(std::exchange(root_left, nullptr), part, branch);
+                },
+                [&](set_operation_context& branch) {
+                    treap_node* part = std::exchange(right, nullptr);
+                    return subtract_symmetric(std::exchange(root_right, nullptr), part, branch);
+                });
+        if (equal != nullptr) {
+            drop_node(root, context);
+            return base_type::merge_with_index(result_left, result_right);
+        }
+        root->set_left(result_left);
+        root->set_right(result_right);
+        return root;
+    } catch (...) {
+        drop_pieces(context, root, {other, root_left, root_right, left, right});
+        throw;
+    }
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+void treap<Node, Compare, Allocator, Priority, Statistics>::set_union(treap&& other, const set_operation_policy& policy) {
+    if (this == &other) {
+        return;
+    }
+    apply_set_operation(take_tree(other), policy, &treap::unite);
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+void treap<Node, Compare, Allocator, Priority, Statistics>::set_union(const treap& other, const set_operation_policy& policy) {
+    if (this == &other) {
+        return;
+    }
+    apply_set_operation(build_sorted(other.begin(), other.end()), policy, &treap::unite);
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+void treap<Node, Compare, Allocator, Priority, Statistics>::set_intersection(treap&& other, const set_operation_policy& policy) {
+    if (this == &other) {
+        return;
+    }
+    apply_set_operation(take_tree(other), policy, &treap::intersect);
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+void treap<Node, Compare, Allocator, Priority, Statistics>::set_intersection(const treap& other, const set_operation_policy& policy) {
+    if (this == &other) {
+        return;
+    }
+    apply_set_operation(build_sorted(other.begin(), other.end()), policy, &treap::intersect);
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+void treap<Node, Compare, Allocator, Priority, Statistics>::set_difference(treap&& other, const set_operation_policy& policy) {
+    if (this == &other) {
+        base_type::clear();
+        return;
+    }
+    apply_set_operation(take_tree(other), policy, &treap::subtract);
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+void treap<Node, Compare, Allocator, Priority, Statistics>::set_difference(const treap& other, const set_operation_policy& policy) {
+    if (this == &other) {
+        base_type::clear();
+        return;
+    }
+    apply_set_operation(build_sorted(other.begin(), other.end()), policy, &treap::subtract);
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+void treap<Node, Compare, Allocator, Priority, Statistics>::set_symmetric_difference(treap&& other, const set_operation_policy& policy) {
+    if (this == &other) {
+        base_type::clear();
+        return;
+    }
+    apply_set_operation(take_tree(other), policy, &treap::subtract_symmetric);
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+void treap<Node, Compare, Allocator, Priority, Statistics>::set_symmetric_difference(const treap& other, const set_operation_policy& policy) {
+    if (this == &other) {
+        base_type::clear();
+        return;
+    }
+    apply_set_operation(build_sorted(other.begin(), other.end()), policy, &treap::subtract_symmetric);
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+void treap<Node, Compare, Allocator, Priority, Statistics>::swap(treap<Node, Compare, Allocator, Priority, Statistics>& other) noexcept {
     base_type::swap(other);
     std::swap(_comparator, other._comparator);
 }
 
-template <typename Node, typename Compare, typename Allocator>
-std::pair<typename treap<Node, Compare, Allocator>::iterator, bool>
-treap<Node, Compare, Allocator>::insert(const value_type& value) {
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+std::pair<typename treap<Node, Compare, Allocator, Priority, Statistics>::iterator, bool>
+treap<Node, Compare, Allocator, Priority, Statistics>::insert(const value_type& value) {
     return emplace_with_key(treap_node::get_key(value), value);
 }
 
-template <typename Node, typename Compare, typename Allocator>
-std::pair<typename treap<Node, Compare, Allocator>::iterator, bool>
-treap<Node, Compare, Allocator>::insert(value_type&& value) {
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+std::pair<typename treap<Node, Compare, Allocator, Priority, Statistics>::iterator, bool>
+treap<Node, Compare, Allocator, Priority, Statistics>::insert(value_type&& value) {
     return emplace_with_key(treap_node::get_key(value), std::move(value));
 }
 
-template <typename Node, typename Compare, typename Allocator>
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
 template <typename InputIterator>
-void treap<Node, Compare, Allocator>::insert(InputIterator begin, InputIterator end) {
-    for (; begin != end; ++begin) {
-        emplace(*begin);
+void treap<Node, Compare, Allocator, Priority, Statistics>::insert(InputIterator begin, InputIterator end) {
+    // builder collects strictly increasing run of the range
+    tree_builder builder;
+    try {
+        for (; begin != end; ++begin) {
+            node_holder holder = base_type::construct_node(*begin);
+            treap_node* last = builder.last();
+            if (last != nullptr && !_comparator(last->get_key(), holder->get_key())) {
+                if (!_comparator(holder->get_key(), last->get_key())) {
+                    // the key is equal to the previous one, node holder will destroy the node
+                    continue;
+                }
+                // the run is over, so insert it in the tree
+                insert_tree(builder.release());
+            }
+            builder.push_back(holder.release());
+        }
+    } catch (...) {
+        base_type::destroy_tree(builder.release());
+        throw;
     }
+    insert_tree(builder.release());
 }
 
-template <typename Node, typename Compare, typename Allocator>
-void treap<Node, Compare, Allocator>::insert(std::initializer_list<value_type> il) {
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+void treap<Node, Compare, Allocator, Priority, Statistics>::insert(std::initializer_list<value_type> il) {
     insert(il.begin(), il.end());
 }
 
-template <typename Node, typename Compare, typename Allocator>
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <typename InputIterator>
+void treap<Node, Compare, Allocator, Priority, Statistics>::assign_sorted(InputIterator begin, InputIterator end) {
+    treap_node* tree = build_sorted(begin, end);
+    base_type::destroy_tree(root());
+    set_root(tree);
+    adjust_begin();
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+void treap<Node, Compare, Allocator, Priority, Statistics>::load(std::istream& stream) {
+    treap_node* tree = base_type::read_tree(stream, [this](const treap_node* previous, const treap_node* node) {
+        return previous == nullptr || _comparator(previous->get_key(), node->get_key());
+    });
+    base_type::destroy_tree(root());
+    set_root(tree);
+    adjust_begin();
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
 template <typename... Args>
-std::pair<typename treap<Node, Compare, Allocator>::iterator, bool>
-treap<Node, Compare, Allocator>::emplace(Args&& ... args) {
+std::pair<typename treap<Node, Compare, Allocator, Priority, Statistics>::iterator, bool>
+treap<Node, Compare, Allocator, Priority, Statistics>::emplace(Args&& ... args) {
     // allocate memory for node and construct value
     node_holder holder = base_type::construct_node(std::forward<Args>(args)...);
     // if the tree already contains key, then just return
-    auto it = find(holder->get_key());
-    if (it != end()) {
+    auto position = find_insert_position(holder->get_key(), holder->get_priority());
+    if (position.found != nullptr) {
         // node holder will automatically deallocate memory and destroy value
-        return {it, false};
+        return {{position.found}, false};
     }
-    // insert new constructed node into tree and get iterator
-    it = insert_node(holder.get());
-    // release node holder, as insertion completed successfully
+    // link new constructed node into the found place and release node holder
+    auto it = link_node(holder.get(), position);
     holder.release();
     return {it, true};
 }
 
-template <typename Node, typename Compare, typename Allocator>
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
 template <typename... Args>
-std::pair<typename treap<Node, Compare, Allocator>::iterator, bool>
-treap<Node, Compare, Allocator>::emplace_with_key(const key_type& key, Args&& ... args) {
-    // if the tree already contains key, then just return
+typename treap<Node, Compare, Allocator, Priority, Statistics>::iterator
+treap<Node, Compare, Allocator, Priority, Statistics>::emplace_hint(const_iterator hint, Args&& ... args) {
+    node_holder holder = base_type::construct_node(std::forward<Args>(args)...);
+    insert_position position;
+    if (!find_hint_position(hint, holder->get_key(), holder->get_priority(), position)) {
+        position = find_insert_position(holder->get_key(), holder->get_priority());
+        if (position.found != nullptr) {
+            return {position.found};
+        }
+    }
+    auto it = link_node(holder.get(), position);
+    holder.release();
+    return it;
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::node_type
+treap<Node, Compare, Allocator, Priority, Statistics>::extract(const_iterator position) {
+    auto chunks = base_type::share_pool();
+    treap_node* node = detach_node_with_key(treap_node::get_key(*position));
+    return base_type::make_node_handle(node, std::move(chunks));
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::node_type
+treap<Node, Compare, Allocator, Priority, Statistics>::extract(const key_type& key) {
     auto it = find(key);
+    if (it == end()) {
+        return {};
+    }
+    return extract(it);
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::insert_return_type
+treap<Node, Compare, Allocator, Priority, Statistics>::insert(node_type&& handle) {
+    if (handle.empty()) {
+        return {end(), false, {}};
+    }
+    auto it = find(handle.key());
     if (it != end()) {
-        return {it, false};
+        return {it, false, std::move(handle)};
+    }
+    if (!base_type::can_adopt(handle)) {
+        // node memory can't be deallocated by this tree allocator
+        node_type moved(std::move(handle));
+        return {emplace_with_key(moved.key(), std::move(moved.value())).first, true, {}};
+    }
+    return {insert_node(base_type::adopt_node(handle)), true, {}};
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+void treap<Node, Compare, Allocator, Priority, Statistics>::merge(treap& other) {
+    if (this == &other) {
+        return;
+    }
+    for (auto it = other.begin(); it != other.end();) {
+        auto next = it;
+        ++next;
+        if (!contains(treap_node::get_key(*it))) {
+            insert(other.extract(it));
+        }
+        it = next;
+    }
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+void treap<Node, Compare, Allocator, Priority, Statistics>::merge(treap&& other) {
+    merge(other);
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <typename... Args>
+std::pair<typename treap<Node, Compare, Allocator, Priority, Statistics>::iterator, bool>
+treap<Node, Compare, Allocator, Priority, Statistics>::emplace_with_key(const key_type& key, Args&& ... args) {
+    // priority is drawn before the descent, so the same descent finds the new node place
+    priority_type priority = base_type::next_priority();
+    auto position = find_insert_position(key, priority);
+    if (position.found != nullptr) {
+        return {{position.found}, false};
     }
     // allocate memory for node and construct value
-    node_holder holder = base_type::construct_node(std::forward<Args>(args)...);
-    // insert new constructed node into tree and get iterator
-    it = insert_node(holder.get());
+    node_holder holder = base_type::construct_node_with_priority(priority, std::forward<Args>(args)...);
+    auto it = link_node(holder.get(), position);
     // release node holder, as insertion completed successfully
     holder.release();
     return {it, true};
 }
 
-template <typename Node, typename Compare, typename Allocator>
-typename treap<Node, Compare, Allocator>::iterator
-treap<Node, Compare, Allocator>::erase_key_interval(const key_type& begin_key, const key_type& end_key) {
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <typename K>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::insert_position
+treap<Node, Compare, Allocator, Priority, Statistics>::find_insert_position(const K& key, priority_type priority) {
+    insert_position position;
+    treap_node* parent = end_node();
+    bool left = true;
+    for (treap_node* node = root(); node != nullptr;) {
+        if (position.subtree == nullptr && node->get_priority() < priority) {
+            position.subtree = node;
+            position.parent = parent;
+            position.left = left;
+        }
+        parent = node;
+        if (_comparator(key, node->get_key())) {
+            left = true;
+            node = node->get_left();
+            continue;
+        }
+        if (_comparator(node->get_key(), key)) {
+            left = false;
+            position.leftmost = false;
+            node = node->get_right();
+            continue;
+        }
+        position.found = node;
+        return position;
+    }
+    if (position.subtree == nullptr) {
+        position.parent = parent;
+        position.left = left;
+    }
+    return position;
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+bool treap<Node, Compare, Allocator, Priority, Statistics>::find_hint_position(const_iterator hint, const key_type& key,
+                                                                   priority_type priority,
+                                                                   insert_position& position) {
+    treap_node* next = base_type::iterator_node(hint);
+    treap_node* prev = next->predecessor();
+    // the key must lie between the hint and its predecessor
+    if ((next != end_node() && !_comparator(key, next->get_key())) ||
+        (prev != nullptr && !_comparator(prev->get_key(), key))) {
+        return false;
+    }
+    // the leaf place is the left child of the hint or the right child of its predecessor, one of them is free
+    position = insert_position();
+    position.leftmost = (prev == nullptr);
+    if (next->get_left() == nullptr) {
+        position.parent = next;
+        position.left = true;
+    } else {
+        position.parent = prev;
+        position.left = false;
+    }
+    // the new node replaces the ancestors having less priority
+    while (position.parent != end_node() && position.parent->get_priority() < priority) {
+        position.subtree = position.parent;
+        position.parent = position.subtree->get_parent();
+        position.left = (position.parent == end_node() || position.parent->get_left() == position.subtree);
+    }
+    return true;
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::iterator
+treap<Node, Compare, Allocator, Priority, Statistics>::link_node(treap_node* node, const insert_position& position) {
+    auto [left, right] = split(position.subtree, node->get_key());
+    node->set_left(left);
+    node->set_right(right);
+    if (position.parent == end_node()) {
+        set_root(node);
+    } else {
+        if (position.left) {
+            position.parent->set_left(node);
+        } else {
+            position.parent->set_right(node);
+        }
+        base_type::update_path(position.parent, root());
+    }
+    if (position.leftmost) {
+        _begin = node;
+    }
+    return {node};
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::iterator
+treap<Node, Compare, Allocator, Priority, Statistics>::erase_key_interval(const key_type& begin_key, const key_type& end_key) {
     auto it = lower_bound(end_key);
-    base_type::destroy_tree(detach_node_key_interval(begin_key, end_key));
+    base_type::retire_tree(detach_node_key_interval(begin_key, end_key));
     return it;
 }
 
-template <typename Node, typename Compare, typename Allocator>
-typename treap<Node, Compare, Allocator>::iterator
-treap<Node, Compare, Allocator>::erase_key_interval_with_end(const key_type& begin_key, const key_type& end_key) {
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::iterator
+treap<Node, Compare, Allocator, Priority, Statistics>::erase_key_interval_with_end(const key_type& begin_key, const key_type& end_key) {
     auto it = upper_bound(end_key);
-    base_type::destroy_tree(detach_node_key_interval<true>(begin_key, end_key));
+    base_type::retire_tree(detach_node_key_interval<true>(begin_key, end_key));
     return it;
 }
 
-template <typename Node, typename Compare, typename Allocator>
-typename treap<Node, Compare, Allocator>::iterator
-treap<Node, Compare, Allocator>::erase_key(const key_type& key) {
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::iterator
+treap<Node, Compare, Allocator, Priority, Statistics>::erase_key(const key_type& key) {
     auto it = upper_bound(key);
-    base_type::destroy_tree(detach_node_with_key(key));
+    base_type::retire_tree(detach_node_with_key(key));
     return it;
 }
 
-template <typename Node, typename Compare, typename Allocator>
-bool treap<Node, Compare, Allocator>::contains(const key_type& key) const {
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+bool treap<Node, Compare, Allocator, Priority, Statistics>::contains(const key_type& key) const {
     return node_of_key(key) != end_node();
 }
 
-template <typename Node, typename Compare, typename Allocator>
-typename treap<Node, Compare, Allocator>::iterator
-treap<Node, Compare, Allocator>::find(const key_type& key) {
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::iterator
+treap<Node, Compare, Allocator, Priority, Statistics>::find(const key_type& key) {
     auto node = lower_bound_node(key);
     if (node != end_node() && !_comparator(key, node->get_key())) {
         return {node};
@@ -529,9 +1674,9 @@ treap<Node, Compare, Allocator>::find(const key_type& key) {
     return end();
 }
 
-template <typename Node, typename Compare, typename Allocator>
-typename treap<Node, Compare, Allocator>::const_iterator
-treap<Node, Compare, Allocator>::find(const key_type& key) const {
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::const_iterator
+treap<Node, Compare, Allocator, Priority, Statistics>::find(const key_type& key) const {
     auto node = lower_bound_node(key);
     if (node != end_node() && !_comparator(key, node->get_key())) {
         return {node};
@@ -539,41 +1684,44 @@ treap<Node, Compare, Allocator>::find(const key_type& key) const {
     return end();
 }
 
-template <typename Node, typename Compare, typename Allocator>
-typename treap<Node, Compare, Allocator>::iterator
-treap<Node, Compare, Allocator>::lower_bound(const key_type& key) {
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::iterator
+treap<Node, Compare, Allocator, Priority, Statistics>::lower_bound(const key_type& key) {
     return {lower_bound_node(key)};
 }
 
-template <typename Node, typename Compare, typename Allocator>
-typename treap<Node, Compare, Allocator>::const_iterator
-treap<Node, Compare, Allocator>::lower_bound(const key_type& key) const {
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::const_iterator
+treap<Node, Compare, Allocator, Priority, Statistics>::lower_bound(const key_type& key) const {
     return {lower_bound_node(key)};
 }
 
-template <typename Node, typename Compare, typename Allocator>
-typename treap<Node, Compare, Allocator>::iterator
-treap<Node, Compare, Allocator>::upper_bound(const key_type& key) {
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::iterator
+treap<Node, Compare, Allocator, Priority, Statistics>::upper_bound(const key_type& key) {
     return {upper_bound_node(key)};
 }
 
-template <typename Node, typename Compare, typename Allocator>
-typename treap<Node, Compare, Allocator>::const_iterator
-treap<Node, Compare, Allocator>::upper_bound(const key_type& key) const {
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::const_iterator
+treap<Node, Compare, Allocator, Priority, Statistics>::upper_bound(const key_type& key) const {
     return {upper_bound_node(key)};
 }
 
-template <typename Node, typename Compare, typename Allocator>
-typename treap<Node, Compare, Allocator>::treap_node*
-treap<Node, Compare, Allocator>::node_of_key(const key_type& key) {
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <typename K>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::treap_node*
+treap<Node, Compare, Allocator, Priority, Statistics>::node_of_key(const K& key) {
     return const_cast<treap_node*>(const_cast<const treap*>(this)->node_of_key(key));
 }
 
-template <typename Node, typename Compare, typename Allocator>
-const typename treap<Node, Compare, Allocator>::treap_node*
-treap<Node, Compare, Allocator>::node_of_key(const key_type& key) const {
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <typename K>
+const typename treap<Node, Compare, Allocator, Priority, Statistics>::treap_node*
+treap<Node, Compare, Allocator, Priority, Statistics>::node_of_key(const K& key) const {
     const treap_node* node = root();
-    while (node != nullptr) {
+    size_type visited = 0;
+    for (; node != nullptr; ++visited) {
         if (_comparator(key, node->get_key())) {
             node = node->get_left();
             continue;
@@ -582,23 +1730,28 @@ treap<Node, Compare, Allocator>::node_of_key(const key_type& key) const {
             node = node->get_right();
             continue;
         }
+        base_type::_statistics.count_lookup(visited + 1);
         return node;
     }
+    base_type::_statistics.count_lookup(visited);
     return end_node();
 }
 
-template <typename Node, typename Compare, typename Allocator>
-typename treap<Node, Compare, Allocator>::treap_node*
-treap<Node, Compare, Allocator>::lower_bound_node(const key_type& key) {
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <typename K>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::treap_node*
+treap<Node, Compare, Allocator, Priority, Statistics>::lower_bound_node(const K& key) {
     return const_cast<treap_node*>(const_cast<const treap*>(this)->lower_bound_node(key));
 }
 
-template <typename Node, typename Compare, typename Allocator>
-const typename treap<Node, Compare, Allocator>::treap_node*
-treap<Node, Compare, Allocator>::lower_bound_node(const key_type& key) const {
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <typename K>
+const typename treap<Node, Compare, Allocator, Priority, Statistics>::treap_node*
+treap<Node, Compare, Allocator, Priority, Statistics>::lower_bound_node(const K& key) const {
     const treap_node* node = root();
     const treap_node* result = end_node();
-    while (node != nullptr) {
+    size_type visited = 0;
+    for (; node != nullptr; ++visited) {
         if (_comparator(node->get_key(), key)) {
             node = node->get_right();
             continue;
@@ -606,21 +1759,25 @@ treap<Node, Compare, Allocator>::lower_bound_node(const key_type& key) const {
         result = node;
         node = node->get_left();
     }
+    base_type::_statistics.count_lookup(visited);
     return result;
 }
 
-template <typename Node, typename Compare, typename Allocator>
-typename treap<Node, Compare, Allocator>::treap_node*
-treap<Node, Compare, Allocator>::upper_bound_node(const key_type& key) {
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <typename K>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::treap_node*
+treap<Node, Compare, Allocator, Priority, Statistics>::upper_bound_node(const K& key) {
     return const_cast<treap_node*>(const_cast<const treap*>(this)->upper_bound_node(key));
 }
 
-template <typename Node, typename Compare, typename Allocator>
-const typename treap<Node, Compare, Allocator>::treap_node*
-treap<Node, Compare, Allocator>::upper_bound_node(const key_type& key) const {
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <typename K>
+const typename treap<Node, Compare, Allocator, Priority, Statistics>::treap_node*
+treap<Node, Compare, Allocator, Priority, Statistics>::upper_bound_node(const K& key) const {
     const treap_node* node = root();
     const treap_node* result = end_node();
-    while (node != nullptr) {
+    size_type visited = 0;
+    for (; node != nullptr; ++visited) {
         if (_comparator(key, node->get_key())) {
             result = node;
             node = node->get_left();
@@ -628,24 +1785,322 @@ treap<Node, Compare, Allocator>::upper_bound_node(const key_type& key) const {
         }
         node = node->get_right();
     }
+    base_type::_statistics.count_lookup(visited);
     return result;
 }
 
-template <typename Node, typename Compare, typename Allocator>
-const typename treap<Node, Compare, Allocator>::key_type&
-treap<Node, Compare, Allocator>::key_of_order(size_type index) const {
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+const typename treap<Node, Compare, Allocator, Priority, Statistics>::key_type&
+treap<Node, Compare, Allocator, Priority, Statistics>::key_of_order(size_type index) const {
     if (index >= size()) {
         throw std::out_of_range("Index is out of bounds");
     }
     return root()->node_of_order(index)->get_key();
 }
 
-template <typename Node, typename Compare, typename Allocator>
-typename treap<Node, Compare, Allocator>::size_type
-treap<Node, Compare, Allocator>::order_of_key(const key_type& key) const {
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::size_type
+treap<Node, Compare, Allocator, Priority, Statistics>::order_of_key(const key_type& key) const {
+    return node_of_key(key)->order();
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <typename K, typename C, typename>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::iterator
+treap<Node, Compare, Allocator, Priority, Statistics>::erase_key(const K& key) {
+    auto it = upper_bound(key);
+    base_type::retire_tree(detach_node_with_key(key));
+    return it;
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <typename K, typename C, typename>
+bool treap<Node, Compare, Allocator, Priority, Statistics>::contains(const K& key) const {
+    return node_of_key(key) != end_node();
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <typename K, typename C, typename>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::iterator
+treap<Node, Compare, Allocator, Priority, Statistics>::find(const K& key) {
+    auto node = lower_bound_node(key);
+    if (node != end_node() && !_comparator(key, node->get_key())) {
+        return {node};
+    }
+    return end();
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <typename K, typename C, typename>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::const_iterator
+treap<Node, Compare, Allocator, Priority, Statistics>::find(const K& key) const {
+    auto node = lower_bound_node(key);
+    if (node != end_node() && !_comparator(key, node->get_key())) {
+        return {node};
+    }
+    return end();
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <typename K, typename C, typename>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::iterator
+treap<Node, Compare, Allocator, Priority, Statistics>::lower_bound(const K& key) {
+    return {lower_bound_node(key)};
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <typename K, typename C, typename>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::const_iterator
+treap<Node, Compare, Allocator, Priority, Statistics>::lower_bound(const K& key) const {
+    return {lower_bound_node(key)};
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <typename K, typename C, typename>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::iterator
+treap<Node, Compare, Allocator, Priority, Statistics>::upper_bound(const K& key) {
+    return {upper_bound_node(key)};
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <typename K, typename C, typename>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::const_iterator
+treap<Node, Compare, Allocator, Priority, Statistics>::upper_bound(const K& key) const {
+    return {upper_bound_node(key)};
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <typename K, typename C, typename>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::size_type
+treap<Node, Compare, Allocator, Priority, Statistics>::order_of_key(const K& key) const {
     return node_of_key(key)->order();
 }
 
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <bool KeyIncluded>
+const typename treap<Node, Compare, Allocator, Priority, Statistics>::treap_node*
+treap<Node, Compare, Allocator, Priority, Statistics>::bound_node_from(const_iterator hint, const key_type& key) const {
+    return base_type::bound_node_from(base_type::iterator_node(hint), [this, &key](const treap_node* node) {
+        return (KeyIncluded ? !_comparator(key, node->get_key()) : _comparator(node->get_key(), key));
+    });
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::iterator
+treap<Node, Compare, Allocator, Priority, Statistics>::find(const_iterator hint, const key_type& key) {
+    return base_type::iterator_node(std::as_const(*this).find(hint, key));
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::const_iterator
+treap<Node, Compare, Allocator, Priority, Statistics>::find(const_iterator hint, const key_type& key) const {
+    auto node = bound_node_from<false>(hint, key);
+    if (node != end_node() && !_comparator(key, node->get_key())) {
+        return {node};
+    }
+    return end();
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::iterator
+treap<Node, Compare, Allocator, Priority, Statistics>::lower_bound(const_iterator hint, const key_type& key) {
+    return {const_cast<treap_node*>(bound_node_from<false>(hint, key))};
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::const_iterator
+treap<Node, Compare, Allocator, Priority, Statistics>::lower_bound(const_iterator hint, const key_type& key) const {
+    return {bound_node_from<false>(hint, key)};
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::iterator
+treap<Node, Compare, Allocator, Priority, Statistics>::upper_bound(const_iterator hint, const key_type& key) {
+    return {const_cast<treap_node*>(bound_node_from<true>(hint, key))};
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::const_iterator
+treap<Node, Compare, Allocator, Priority, Statistics>::upper_bound(const_iterator hint, const key_type& key) const {
+    return {bound_node_from<true>(hint, key)};
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+typename treap<Node, Compare, Allocator, Priority, Statistics>::size_type
+treap<Node, Compare, Allocator, Priority, Statistics>::order_of_key(const_iterator hint, const key_type& key) const {
+    return find(hint, key).order();
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <typename ForwardIterator, typename OutputIterator>
+OutputIterator
+treap<Node, Compare, Allocator, Priority, Statistics>::find_many(ForwardIterator begin, ForwardIterator end, OutputIterator out) {
+    auto handler = [&](ForwardIterator first, ForwardIterator last, const treap_node* node, size_type, bool found) {
+        iterator result(found ? const_cast<treap_node*>(node) : end_node());
+        for (; first != last; ++first) {
+            *out++ = result;
+        }
+    };
+    resolve_sorted(root(), begin, end, end_node(), 0, handler);
+    return out;
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <typename ForwardIterator, typename OutputIterator>
+OutputIterator treap<Node, Compare, Allocator, Priority, Statistics>::find_many(ForwardIterator begin, ForwardIterator end,
+                                                                    OutputIterator out) const {
+    auto handler = [&](ForwardIterator first, ForwardIterator last, const treap_node* node, size_type, bool found) {
+        const_iterator result(found ? node : end_node());
+        for (; first != last; ++first) {
+            *out++ = result;
+        }
+    };
+    resolve_sorted(root(), begin, end, end_node(), 0, handler);
+    return out;
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <typename ForwardIterator, typename OutputIterator>
+OutputIterator treap<Node, Compare, Allocator, Priority, Statistics>::contains_many(ForwardIterator begin, ForwardIterator end,
+                                                                        OutputIterator out) const {
+    auto handler = [&](ForwardIterator first, ForwardIterator last, const treap_node*, size_type, bool found) {
+        for (; first != last; ++first) {
+            *out++ = found;
+        }
+    };
+    resolve_sorted(root(), begin, end, end_node(), 0, handler);
+    return out;
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <typename ForwardIterator, typename OutputIterator>
+OutputIterator treap<Node, Compare, Allocator, Priority, Statistics>::lower_bound_many(ForwardIterator begin, ForwardIterator end,
+                                                                           OutputIterator out) {
+    auto handler = [&](ForwardIterator first, ForwardIterator last, const treap_node* node, size_type, bool) {
+        iterator result(const_cast<treap_node*>(node));
+        for (; first != last; ++first) {
+            *out++ = result;
+        }
+    };
+    resolve_sorted(root(), begin, end, end_node(), 0, handler);
+    return out;
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <typename ForwardIterator, typename OutputIterator>
+OutputIterator treap<Node, Compare, Allocator, Priority, Statistics>::lower_bound_many(ForwardIterator begin, ForwardIterator end,
+                                                                           OutputIterator out) const {
+    auto handler = [&](ForwardIterator first, ForwardIterator last, const treap_node* node, size_type, bool) {
+        const_iterator result(node);
+        for (; first != last; ++first) {
+            *out++ = result;
+        }
+    };
+    resolve_sorted(root(), begin, end, end_node(), 0, handler);
+    return out;
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <typename ForwardIterator, typename OutputIterator>
+OutputIterator treap<Node, Compare, Allocator, Priority, Statistics>::order_of_keys(ForwardIterator begin, ForwardIterator end,
+                                                                        OutputIterator out) const {
+    auto handler = [&](ForwardIterator first, ForwardIterator last, const treap_node*, size_type order, bool found) {
+        size_type result = (found ? order : size());
+        for (; first != last; ++first) {
+            *out++ = result;
+        }
+    };
+    resolve_sorted(root(), begin, end, end_node(), 0, handler);
+    return out;
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <typename ForwardIterator, typename Handler>
+void treap<Node, Compare, Allocator, Priority, Statistics>::resolve_sorted(const treap_node* node, ForwardIterator begin,
+                                                               ForwardIterator end, const treap_node* bound,
+                                                               size_type offset, Handler& handler) const {
+    while (begin != end) {
+        if (node == nullptr) {
+            handler(begin, end, bound, offset, false);
+            return;
+        }
+        const key_type& key = node->get_key();
+        // keys less than the node key go to the left subtree, the node becomes their bound
+        auto middle = std::partition_point(begin, end, [&](const auto& other) { return _comparator(other, key); });
+        resolve_sorted(node->get_left(), begin, middle, node, offset, handler);
+        offset += node->left_size();
+        auto greater = std::partition_point(middle, end, [&](const auto& other) { return !_comparator(key, other); });
+        if (middle != greater) {
+            handler(middle, greater, node, offset, true);
+        }
+        // the rest keys go to the right subtree keeping the inherited bound
+        begin = greater;
+        node = node->get_right();
+        ++offset;
+    }
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <typename ForwardIterator, typename OutputIterator>
+OutputIterator
+treap<Node, Compare, Allocator, Priority, Statistics>::find_batch(ForwardIterator begin, ForwardIterator end, OutputIterator out) {
+    auto handler = [&](const treap_node* node) { *out++ = iterator(const_cast<treap_node*>(node)); };
+    resolve_batch(begin, end, handler);
+    return out;
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <typename ForwardIterator, typename OutputIterator>
+OutputIterator treap<Node, Compare, Allocator, Priority, Statistics>::find_batch(ForwardIterator begin, ForwardIterator end,
+                                                                     OutputIterator out) const {
+    auto handler = [&](const treap_node* node) { *out++ = const_iterator(node); };
+    resolve_batch(begin, end, handler);
+    return out;
+}
+
+template <typename Node, typename Compare, typename Allocator, typename Priority, typename Statistics>
+template <typename ForwardIterator, typename Handler>
+void treap<Node, Compare, Allocator, Priority, Statistics>::resolve_batch(ForwardIterator begin, ForwardIterator end,
+                                                              Handler& handler) const {
+    // state of each lane is its key, current node and lower bound candidate, like in lower_bound_node
+    ForwardIterator keys[batch_lookup_lanes];
+    const treap_node* nodes[batch_lookup_lanes];
+    const treap_node* bounds[batch_lookup_lanes];
+    while (begin != end) {
+        size_type count = 0;
+        for (; count < batch_lookup_lanes && begin != end; ++count, ++begin) {
+            keys[count] = begin;
+            nodes[count] = root();
+            bounds[count] = end_node();
+        }
+        // every pass moves all the unfinished lanes one level down, so the prefetched nodes have time to arrive
+        for (bool active = true; active;) {
+            active = false;
+            for (size_type i = 0; i < count; ++i) {
+                const treap_node* node = nodes[i];
+                if (node == nullptr) {
+                    continue;
+                }
+                if (_comparator(node->get_key(), *keys[i])) {
+                    node = node->get_right();
+                } else {
+                    bounds[i] = node;
+                    node = node->get_left();
+                }
+                nodes[i] = node;
+                if (node != nullptr) {
+                    prefetch_node(node);
+                    active = true;
+                }
+            }
+        }
+        for (size_type i = 0; i < count; ++i) {
+            const treap_node* bound = bounds[i];
+            handler(bound != end_node() && !_comparator(*keys[i], bound->get_key()) ? bound : end_node());
+        }
+    }
+}
+
 } // namespace nstd
 
 #endif // BASICS_TREAP_HPP
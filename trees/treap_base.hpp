@@ -3,14 +3,29 @@
 
 #include <algorithm>
 #include <cstddef>
+#include <cstdint>
+#include <limits>
 #include <memory>
-#include <chrono>
-#include <random>
+#include <stdexcept>
+#include <type_traits>
 
 #include <reverse_iterator.hpp>
+#include <treap_node_handle.hpp>
+#include <treap_node_pool.hpp>
+#include <treap_priority.hpp>
+#include <treap_serialization.hpp>
+#include <treap_statistics.hpp>
 
 namespace nstd {
 
+/**
+ * Hints the processor to load the node memory into cache, null addresses are allowed
+ */
+inline void prefetch_node(const void* address) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address);
+#endif
+}
 
 template <typename Node>
 class treap_end_node {
@@ -69,14 +84,33 @@ public:
     }
 
     const treap_node* find_begin() const {
-        const auto* root = static_cast<const treap_node*>(this);
-        while (root->get_left() != nullptr) {
-            root = root->get_left();
-        }
-        return root;
+        return (_left != nullptr ? _left->find_begin() : static_cast<const treap_node*>(this));
     }
 };
 
+/**
+ * Treap node layouts, they define integer types for storing node priority and subtree size
+ */
+
+/**
+ * Default layout doesn't limit tree size
+ */
+struct default_treap_layout {
+    using priority_type = unsigned long long;
+    using size_type = size_t;
+};
+
+/**
+ * Narrow layout keeps priority and subtree size in 32 bits, so node links and counters take 32 bytes instead of 40
+ * Node links stay full pointers, since nodes move between pools through node handles and merges
+ * Tree must not contain more than 2^32 - 1 elements
+ * Priorities are truncated to 32 bits, rare equal priorities don't break the treap
+ */
+struct narrow_treap_layout {
+    using priority_type = std::uint32_t;
+    using size_type = std::uint32_t;
+};
+
 /**
  * Treap node base class
  * Implements basic part of the treap node (left, right child nodes, priority)
@@ -84,32 +118,33 @@ public:
  * Does not have key, value getter functions, as they are different for each data structure
  * @tparam Node Treap node class, which inherits from treap_node_base
  * Template parameter is for avoiding persistent down casts
+ * @tparam Layout node layout, default_treap_layout or narrow_treap_layout
  */
-template <typename Node>
+template <typename Node, typename Layout = default_treap_layout>
 class treap_node_base : public treap_end_node<Node> {
     using base_type = treap_end_node<Node>;
 protected:
     using typename base_type::treap_node;
     using typename base_type::size_type;
     using typename base_type::difference_type;
-    using priority_type = unsigned long long;
+    using priority_type = typename Layout::priority_type;
 
 private:
-    // node priority presented in integer type
-    priority_type _priority;
     // parent node
     using base_type::_parent;
     // left child
     using base_type::_left;
     // right child
     treap_node* _right;
+    // node priority presented in integer type, narrow counters are kept together to avoid padding
+    priority_type _priority;
     // size showing how many nodes are lying under tree with root of this node
-    size_type _size;
+    typename Layout::size_type _size;
 
 public:
     explicit treap_node_base(priority_type priority = 0, treap_node* left = nullptr,
                              treap_node* right = nullptr, treap_node* parent = nullptr)
-            : base_type(parent, left), _priority(priority), _right(right), _size(1) { update(); }
+            : base_type(parent, left), _right(right), _priority(priority), _size(left_size() + right_size() + 1) {}
 
 public:
     void set_members(priority_type priority = 0, treap_node* left = nullptr, treap_node* right = nullptr,
@@ -118,6 +153,7 @@ public:
         _left = left;
         _right = right;
         _parent = parent;
+        static_cast<treap_node*>(this)->reset_action();
         update();
     }
 
@@ -171,6 +207,28 @@ public:
 
     const treap_node* prev(difference_type offset = 1) const { return node_of_offset(-offset); }
 
+    treap_node* successor() {
+        return const_cast<treap_node*>(const_cast<const treap_node_base*>(this)->successor());
+    }
+
+    /**
+     * Gives the next node in the in-order sequence without counting sizes
+     * Full scan visits each edge twice, so it works in O(1) amortized complexity
+     * Right children of the passed nodes are prefetched, as the scan goes there next
+     * @return next node, end node for the last node, nullptr for the end node
+     */
+    const treap_node* successor() const;
+
+    treap_node* predecessor() {
+        return const_cast<treap_node*>(const_cast<const treap_node_base*>(this)->predecessor());
+    }
+
+    /**
+     * Gives the previous node in the in-order sequence, works in O(1) amortized complexity for full scan
+     * @return previous node, the last node for the end node, nullptr for the first node
+     */
+    const treap_node* predecessor() const;
+
     treap_node* node_of_order(size_type index);
 
     /**
@@ -186,6 +244,15 @@ public:
      */
     size_type order() const;
 
+    treap_node* find_begin() {
+        return const_cast<treap_node*>(const_cast<const treap_node_base*>(this)->find_begin());
+    }
+
+    /**
+     * Finds the leftmost node of the subtree, pending actions on the way are pushed
+     */
+    const treap_node* find_begin() const;
+
 private:
     treap_node* node_of_offset(difference_type offset);
 
@@ -197,26 +264,59 @@ private:
      */
     const treap_node* node_of_offset(difference_type offset) const;
 
-private:
+public:
     /**
      * Updates size member corresponding to left and right nodes
+     * Derived nodes maintaining subtree aggregates update them in update_aggregate function
+     */
+    void update() {
+        _size = left_size() + right_size() + 1;
+        static_cast<treap_node*>(this)->update_aggregate();
+    }
+
+    void update_aggregate() {}
+
+    /**
+     * Lazy action hooks, nodes supporting lazy actions hide them
+     * Action pending in the node is already applied to the node itself, but not to its children yet
+     * push passes pending action to the children, so it's called before visiting or relinking children
+     * Pushing doesn't change the tree content, so it's called from const functions either
+     */
+    static constexpr bool has_actions = false;
+
+    void push() {}
+
+    void reset_action() {}
+
+    /**
+     * Pushes pending actions of all the ancestors from the root down to the parent
+     * Afterwards the node position can be found by walking up the parents
+     * Nodes reached by descending from the root or from such nodes are already clean,
+     * so it's needed only for nodes, which were reached before restructuring actions
+     * Works in O(depth) complexity for nodes with actions and does nothing for other nodes
      */
-    void update() { _size = left_size() + right_size() + 1; }
+    void push_path() const;
+
+    /**
+     * Swaps the children, is used for reversing subtrees
+     * Doesn't update size, as it doesn't change
+     */
+    void swap_children() { std::swap(_left, _right); }
 };
 
 /**
 * Treap Node destructor class
 * Is used as unique pointer destructor class
-* @tparam Allocator Treap node allocator class
+* @tparam Pool Treap node pool class
 */
-template <typename Allocator>
+template <typename Pool>
 class treap_node_destructor {
-    using allocator_type = Allocator;
-    using allocator_traits = std::allocator_traits<Allocator>;
+    using pool_type = Pool;
+    using allocator_traits = typename pool_type::allocator_traits;
 public:
     using pointer = typename allocator_traits::pointer;
 private:
-    allocator_type& _allocator;
+    pool_type& _pool;
 public:
     bool value_constructed;
 public:
@@ -224,24 +324,30 @@ public:
 
     treap_node_destructor& operator=(const treap_node_destructor&) = delete;
 
-    explicit treap_node_destructor(allocator_type& allocator, bool value_constructed = false) noexcept
-            : _allocator(allocator), value_constructed(value_constructed) {}
+    explicit treap_node_destructor(pool_type& pool, bool value_constructed = false) noexcept
+            : _pool(pool), value_constructed(value_constructed) {}
 
     /**
-     * Destroys underlying value, if it's constructed and deallocates node memory
+     * Destroys underlying value, if it's constructed and returns node memory to the pool
      * @param node treap node pointer
      */
-    void operator()(pointer node) _NOEXCEPT {
-        if (value_constructed) {
-            allocator_traits::destroy(_allocator, node->get_value_address());
+    void operator()(pointer node) noexcept {
+        if (node == nullptr) {
+            return;
         }
-        if (node) {
-            allocator_traits::deallocate(_allocator, node, 1);
+        if (value_constructed) {
+            allocator_traits::destroy(_pool.allocator(), node->get_value_address());
         }
+        _pool.deallocate(node);
     }
 };
 
-template <typename Node, typename Allocator>
+/**
+ * Treap base class
+ * @tparam Priority node priority generator, see treap_priority.hpp
+ */
+template <typename Node, typename Allocator, typename Priority = random_priority_generator,
+        typename Statistics = no_treap_statistics>
 class treap_base {
 public:
     using value_type = typename Node::raw_value_type;
@@ -254,9 +360,10 @@ private:
     using alloc_traits = std::allocator_traits<allocator_type>;
     using node_allocator_type = typename alloc_traits::template rebind_alloc<treap_node>;
     using node_traits = std::allocator_traits<node_allocator_type>;
+    using node_pool_type = treap_node_pool<treap_node, node_allocator_type>;
 
-    using node_destructor = treap_node_destructor<node_allocator_type>;
 protected:
+    using node_destructor = treap_node_destructor<node_pool_type>;
     using node_holder = std::unique_ptr<treap_node, node_destructor>;
 
 private:
@@ -267,6 +374,7 @@ private:
     template <bool B>
     class common_iterator {
         friend class common_iterator<!B>;
+        friend class treap_base;
 
     public:
         using node_type = std::conditional_t<B, const treap_node, treap_node>;
@@ -285,6 +393,8 @@ private:
          */
         common_iterator(const common_iterator<false>& other);
 
+        common_iterator<B>& operator=(const common_iterator<B>& other) = default;
+
     public:
         common_iterator<B>& operator++();
 
@@ -333,11 +443,42 @@ public:
     using const_iterator = common_iterator<true>;
     using reverse_iterator = common_reverse_iterator<iterator>;
     using const_reverse_iterator = common_reverse_iterator<const_iterator>;
+    using node_type = treap_node_handle<treap_node, node_pool_type>;
+
+protected:
+    /**
+     * Builds treap from the nodes passed in their in-order sequence
+     * Uses Cartesian tree construction over node priorities
+     * The right spine of the built tree serves as stack and is kept through parent links,
+     * so each node is added in O(1) amortized complexity without any extra memory
+     */
+    class tree_builder {
+    private:
+        // root of the built tree
+        treap_node* _root = nullptr;
+        // the last added node, which is the bottom of the right spine
+        treap_node* _last = nullptr;
+
+    public:
+        /**
+         * Appends node to the end of in-order sequence
+         * @param node detached node with initialized members
+         */
+        void push_back(treap_node* node) noexcept;
+
+        treap_node* last() noexcept { return _last; }
+
+        /**
+         * Updates right spine node sizes and detaches the built tree from the builder
+         * @return root of the built tree, nullptr if nothing was added
+         */
+        treap_node* release() noexcept;
+    };
 
 protected:
     end_node_t _end;
     treap_node* _begin;
-    node_allocator_type _node_allocator;
+    node_pool_type _node_pool;
 
 protected:
     treap_node* root() { return _end.get_left(); }
@@ -381,6 +522,28 @@ protected:
      */
     void destroy_tree(treap_node* node) noexcept;
 
+    /**
+     * Destroys detached tree or retires it, when deferred destruction is enabled
+     * Retired nodes are destroyed in portions by later modifications, see set_reclaim_step
+     * @param node detached tree root
+     */
+    void retire_tree(treap_node* node) noexcept;
+
+    /**
+     * Destroys all the tree node values and releases node pool chunks
+     * Works in O(chunks count) complexity for trivially destructible values, in O(size) otherwise
+     */
+    void release_tree() noexcept;
+
+private:
+    /**
+     * Destroys underlying tree node values without deallocating node memory
+     * @param node
+     */
+    void destroy_values(treap_node* node) noexcept;
+
+protected:
+
     /**
      * Constructs treap node and it's value with passed constructor arguments
      * Uses perfect forwarding technique
@@ -391,19 +554,128 @@ protected:
     template <typename... Args>
     node_holder construct_node(Args&& ... args);
 
+    using priority_type = std::decay_t<decltype(std::declval<const treap_node&>().get_priority())>;
+
+    /**
+     * Draws the priority of the next node, is used, when the priority is needed before the node construction
+     */
+    priority_type next_priority() { return static_cast<priority_type>(_priority_generator()); }
+
+    /**
+     * Constructs treap node with the passed priority
+     */
+    template <typename... Args>
+    node_holder construct_node_with_priority(priority_type priority, Args&& ... args);
+
+    /**
+     * Reads the tree saved by save function in O(size) complexity
+     * Nodes are appended in the stored order, their priorities are read or generated
+     * @param stream input stream
+     * @param validator function (previous node or nullptr, node) returning false, when the node can't follow previous one
+     * @return root of the read tree
+     * Throws serialization_error, when the stream data is invalid, the container isn't changed
+     */
+    template <typename Validator>
+    treap_node* read_tree(std::istream& stream, Validator validator);
+
+    /**
+     * Makes the current nodes memory jointly owned, so the nodes can be moved to node handles
+     * Is called before detaching the node, so a failed allocation doesn't change the tree
+     * @return chunks keeping the memory of the current nodes
+     */
+    typename node_pool_type::shared_chunks_pointer share_pool() { return _node_pool.share(); }
+
+    /**
+     * Moves detached node to node handle
+     * @param node detached node, which memory is kept by the chunks
+     * @param chunks chunks returned by share_pool
+     * @return node handle
+     */
+    node_type make_node_handle(treap_node* node, typename node_pool_type::shared_chunks_pointer chunks) noexcept;
+
+    /**
+     * Takes the node from node handle, the node can be linked into this tree then
+     * Node handle allocator must be equal to the tree allocator
+     * @param handle non-empty node handle, which becomes empty
+     * @return detached node
+     */
+    treap_node* adopt_node(node_type& handle);
+
+    bool can_adopt(const node_type& handle) const { return *handle._allocator == _node_pool.allocator(); }
+
+    /**
+     * Takes the ownership of other tree node memory, when tree allocators are equal
+     * After this other tree nodes can be linked into this tree
+     * @param other other tree
+     * @return true if allocators are equal and the memory was taken, false otherwise
+     */
+    bool splice_pool(treap_base& other) noexcept;
+
 public:
     void swap(treap_base& other) noexcept;
 
+    /**
+     * Writes the container in the binary format described in treap_serialization.hpp in O(size) complexity
+     * Values are written with binary_serializer
+     * @param stream output stream
+     * @param with_priorities writes node priorities as well, so the loaded tree keeps the same shape
+     * Throws serialization_error, when the stream fails
+     */
+    void save(std::ostream& stream, bool with_priorities = false) const;
+
     bool empty() const noexcept { return size() == 0; }
 
     size_type size() const noexcept { return _end.left_size(); }
 
     void clear() noexcept {
-        destroy_tree(root());
+        if constexpr (!std::is_trivially_destructible_v<typename treap_node::value_type>) {
+            if (_reclaim_step != 0) {
+                // values would be destroyed in O(size), so the tree is retired as a whole
+                retire_tree(root());
+                set_root(nullptr);
+                adjust_begin();
+                return;
+            }
+        }
+        release_tree();
         set_root(nullptr);
         adjust_begin();
     }
 
+    /**
+     * Enables deferred destruction, when step is positive, and disables it otherwise
+     * In deferred mode erased nodes are detached in O(log size) and retired instead of being destroyed at once,
+     * then each later insertion or erasure destroys up to step retired nodes in O(step) complexity,
+     * so the erasure latency doesn't depend on the erased interval size
+     * Disabling destroys all the retired nodes
+     */
+    void set_reclaim_step(size_type step) noexcept;
+
+    size_type reclaim_step() const noexcept { return _reclaim_step; }
+
+    /**
+     * Gives count of erased nodes waiting for destruction
+     */
+    size_type retired_size() const noexcept { return _retired_size; }
+
+    /**
+     * Destroys up to count retired nodes, may be called in idle time
+     * Works in O(count) complexity without recursion
+     * @return count of nodes left retired
+     */
+    size_type reclaim(size_type count = std::numeric_limits<size_type>::max()) noexcept;
+
+    /**
+     * Gives the tree shape and the operation counters of the statistics policy
+     * The shape is collected by tree traversal in O(size) complexity, the counters stay zero without counting policy
+     */
+    treap_statistics stats() const;
+
+    /**
+     * Resets the operation counters, the shape is always computed from the current tree
+     */
+    void reset_stats() noexcept { _statistics.reset(); }
+
 public:
     iterator begin();
 
@@ -430,9 +702,123 @@ public:
     const_reverse_iterator crend() const;
 
 protected:
-    static treap_node* merge_with_index(treap_node* node1, treap_node* node2) noexcept;
+    /**
+     * Collects two trees of the top-down split
+     * Nodes are appended to the left tree as right children and to the right tree as left children,
+     * so split is done in one pass from the root without any extra memory
+     */
+    class split_collector {
+    private:
+        treap_node* _left_root = nullptr;
+        treap_node* _right_root = nullptr;
+        // the last appended nodes of the trees
+        treap_node* _left_tail = nullptr;
+        treap_node* _right_tail = nullptr;
+
+    public:
+        /**
+         * Appends node with its left subtree to the left tree
+         * Node right subtree remains to be split
+         */
+        void push_left(treap_node* node) noexcept;
 
-    static std::pair<treap_node*, treap_node*> split_with_index(treap_node* node, size_type index) noexcept;
+        /**
+         * Appends node with its right subtree to the right tree
+         * Node left subtree remains to be split
+         */
+        void push_right(treap_node* node) noexcept;
+
+        /**
+         * Links passed subtrees to the last appended nodes and updates sizes of the appended nodes
+         * @param left_rest subtree, which completes the left tree
+         * @param right_rest subtree, which completes the right tree
+         * @return left and right trees
+         */
+        std::pair<treap_node*, treap_node*> release(treap_node* left_rest = nullptr,
+                                                    treap_node* right_rest = nullptr) noexcept;
+    };
+
+    /**
+     * List of detached trees waiting for destruction
+     * Trees are linked through their root parent links, so no extra memory is needed
+     * Lists are joined in O(1) complexity, so trees dropped by different threads can be destroyed later by one thread
+     */
+    class tree_list {
+    private:
+        treap_node* _head = nullptr;
+        treap_node* _tail = nullptr;
+
+    public:
+        void push(treap_node* tree) noexcept;
+
+        void splice(tree_list& other) noexcept;
+
+        bool empty() const noexcept { return _head == nullptr; }
+
+        treap_node* pop() noexcept;
+    };
+
+    /**
+     * Destroys all the trees of the passed list
+     * @param trees tree list, which becomes empty
+     */
+    void destroy_trees(tree_list& trees) noexcept;
+
+    /**
+     * Refreshes sizes and aggregates of the nodes lying on the path from the iterator node to the root
+     * Is needed after modification of the node value taking part in aggregates
+     * Works in O(log size) complexity
+     * @param it iterator pointing on the modified node
+     */
+    void refresh(const_iterator it) noexcept { update_path(const_cast<treap_node*>(it._node), root()); }
+
+    /**
+     * Pushes pending actions on the path from the root to the iterator node, so the iterator can be moved
+     * Works in O(log size) complexity
+     * @param it iterator taken before restructuring actions
+     */
+    void clean_path(const_iterator it) noexcept { it._node->push_path(); }
+
+    static treap_node* iterator_node(const_iterator it) noexcept { return const_cast<treap_node*>(it._node); }
+
+    /**
+     * Finger search, finds the first node, which doesn't lie before the searched position, starting from the hint
+     * Climbs from the hint to the lowest ancestor, which subtree contains the result, and descends from there,
+     * so it works in O(log d) expected complexity, where d is the order distance between the hint and the result
+     * @param hint hint node, may be end node
+     * @param before predicate, which is true for the nodes lying before the searched position
+     * @return found node, end node, when all the nodes lie before the position
+     */
+    template <typename Before>
+    const treap_node* bound_node_from(const treap_node* hint, Before before) const;
+
+    /**
+     * Counts a lookup, which visited the nodes on the path from the root to the passed node
+     * Climbs to the root only, when the statistics policy is enabled
+     */
+    void count_path(const treap_node* node) const noexcept;
+
+    /**
+     * Updates sizes of the nodes lying on the path from the passed node to the passed root
+     * Used after top-down split and merge, which link nodes before their subtrees are complete
+     * @param node the deepest node of the path
+     * @param root the highest node of the path
+     */
+    static void update_path(treap_node* node, const treap_node* root) noexcept;
+
+    /**
+     * Merges two trees, where all the first tree nodes go before the second tree nodes
+     * Works top-down in O(log size) complexity without any extra memory
+     * @return merged tree
+     */
+    treap_node* merge_with_index(treap_node* node1, treap_node* node2) noexcept;
+
+    /**
+     * Splits tree into the first index nodes and the rest
+     * Works top-down in O(log size) complexity without any extra memory
+     * @return first index nodes tree and the rest nodes tree
+     */
+    std::pair<treap_node*, treap_node*> split_with_index(treap_node* node, size_type index) noexcept;
 
     treap_node* detach_interval(size_type begin, size_type end) noexcept;
 
@@ -476,178 +862,189 @@ public:
     iterator erase(const_iterator begin, const_iterator end) noexcept;
 
 protected:
-    static std::mt19937_64 random_generator;
+    // detached trees waiting for deferred destruction
+    tree_list _retired;
+    size_type _retired_size = 0;
+    // count of retired nodes destroyed by each modification, 0 if destruction isn't deferred
+    size_type _reclaim_step = 0;
+    Priority _priority_generator;
+    Statistics _statistics;
 };
 
-template <typename Node, typename Allocator>
-std::mt19937_64 treap_base<Node, Allocator>::random_generator(
-        std::chrono::steady_clock::now().time_since_epoch().count());
-
 //======================common_iterator implementation==========================================
 
 
-template <typename Node, typename Allocator>
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
 template <bool B>
-treap_base<Node, Allocator>::common_iterator<B>::common_iterator(node_type* node)
+treap_base<Node, Allocator, Priority, Statistics>::common_iterator<B>::common_iterator(node_type* node)
         :_node(node) {}
 
-template <typename Node, typename Allocator>
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
 template <bool B>
-treap_base<Node, Allocator>::common_iterator<B>::common_iterator(const common_iterator<false>& other)
+treap_base<Node, Allocator, Priority, Statistics>::common_iterator<B>::common_iterator(const common_iterator<false>& other)
         :_node(other._node) {}
 
-template <typename Node, typename Allocator>
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
 template <bool B>
-typename treap_base<Node, Allocator>::template common_iterator<B>&
-treap_base<Node, Allocator>::common_iterator<B>::operator++() {
-    _node = _node->next();
+typename treap_base<Node, Allocator, Priority, Statistics>::template common_iterator<B>&
+treap_base<Node, Allocator, Priority, Statistics>::common_iterator<B>::operator++() {
+    _node = _node->successor();
     return *this;
 }
 
-template <typename Node, typename Allocator>
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
 template <bool B>
-typename treap_base<Node, Allocator>::template common_iterator<B>
-treap_base<Node, Allocator>::common_iterator<B>::operator++(int)& {
+typename treap_base<Node, Allocator, Priority, Statistics>::template common_iterator<B>
+treap_base<Node, Allocator, Priority, Statistics>::common_iterator<B>::operator++(int)& {
     common_iterator iter = *this;
     ++(*this);
     return iter;
 }
 
-template <typename Node, typename Allocator>
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
 template <bool B>
-typename treap_base<Node, Allocator>::template common_iterator<B>&
-treap_base<Node, Allocator>::common_iterator<B>::operator+=(difference_type n) {
+typename treap_base<Node, Allocator, Priority, Statistics>::template common_iterator<B>&
+treap_base<Node, Allocator, Priority, Statistics>::common_iterator<B>::operator+=(difference_type n) {
     _node = _node->next(n);
     return *this;
 }
 
-template <typename Node, typename Allocator>
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
 template <bool B>
-typename treap_base<Node, Allocator>::template common_iterator<B>&
-treap_base<Node, Allocator>::common_iterator<B>::operator--() {
-    _node = _node->prev();
+typename treap_base<Node, Allocator, Priority, Statistics>::template common_iterator<B>&
+treap_base<Node, Allocator, Priority, Statistics>::common_iterator<B>::operator--() {
+    _node = _node->predecessor();
     return *this;
 }
 
-template <typename Node, typename Allocator>
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
 template <bool B>
-typename treap_base<Node, Allocator>::template common_iterator<B>
-treap_base<Node, Allocator>::common_iterator<B>::operator--(int)& {
+typename treap_base<Node, Allocator, Priority, Statistics>::template common_iterator<B>
+treap_base<Node, Allocator, Priority, Statistics>::common_iterator<B>::operator--(int)& {
     common_iterator iter = *this;
     --(*this);
     return iter;
 }
 
-template <typename Node, typename Allocator>
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
 template <bool B>
-typename treap_base<Node, Allocator>::template common_iterator<B>&
-treap_base<Node, Allocator>::common_iterator<B>::operator-=(difference_type n) {
+typename treap_base<Node, Allocator, Priority, Statistics>::template common_iterator<B>&
+treap_base<Node, Allocator, Priority, Statistics>::common_iterator<B>::operator-=(difference_type n) {
     _node = _node->prev(n);
     return *this;
 }
 
-template <typename Node, typename Allocator>
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
 template <bool B>
 auto
-treap_base<Node, Allocator>::common_iterator<B>::operator-(const common_iterator<B>& other) const -> difference_type {
+treap_base<Node, Allocator, Priority, Statistics>::common_iterator<B>::operator-(const common_iterator<B>& other) const -> difference_type {
     return static_cast<difference_type>(_node->order()) - other._node->order();
 }
 
-template <typename Node, typename Allocator>
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
 template <bool B>
-auto treap_base<Node, Allocator>::common_iterator<B>::operator*() const -> value_type& {
+auto treap_base<Node, Allocator, Priority, Statistics>::common_iterator<B>::operator*() const -> value_type& {
     return _node->get_value();
 }
 
-template <typename Node, typename Allocator>
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
 template <bool B>
-auto treap_base<Node, Allocator>::common_iterator<B>::operator->() const -> value_type* {
+auto treap_base<Node, Allocator, Priority, Statistics>::common_iterator<B>::operator->() const -> value_type* {
     return _node->get_value_address();
 }
 
-template <typename Node, typename Allocator>
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
 template <bool B>
-bool treap_base<Node, Allocator>::common_iterator<B>::operator==(const common_iterator<B>& other) const {
+bool treap_base<Node, Allocator, Priority, Statistics>::common_iterator<B>::operator==(const common_iterator<B>& other) const {
     return _node == other._node;
 }
 
-template <typename Node, typename Allocator>
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
 template <bool B>
-bool treap_base<Node, Allocator>::common_iterator<B>::operator!=(const common_iterator<B>& other) const {
+bool treap_base<Node, Allocator, Priority, Statistics>::common_iterator<B>::operator!=(const common_iterator<B>& other) const {
     return _node != other._node;
 }
 
-template <typename Node, typename Allocator>
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
 template <bool B>
-bool treap_base<Node, Allocator>::common_iterator<B>::operator<(const common_iterator<B>& other) const {
+bool treap_base<Node, Allocator, Priority, Statistics>::common_iterator<B>::operator<(const common_iterator<B>& other) const {
     return _node->order() < other._node->order();
 }
 
-template <typename Node, typename Allocator>
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
 template <bool B>
-bool treap_base<Node, Allocator>::common_iterator<B>::operator>(const common_iterator<B>& other) const {
+bool treap_base<Node, Allocator, Priority, Statistics>::common_iterator<B>::operator>(const common_iterator<B>& other) const {
     return _node->order() > other._node->order();
 }
 
-template <typename Node, typename Allocator>
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
 template <bool B>
-bool treap_base<Node, Allocator>::common_iterator<B>::operator<=(const common_iterator<B>& other) const {
+bool treap_base<Node, Allocator, Priority, Statistics>::common_iterator<B>::operator<=(const common_iterator<B>& other) const {
     return _node->order() <= other._node->order();
 }
 
-template <typename Node, typename Allocator>
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
 template <bool B>
-bool treap_base<Node, Allocator>::common_iterator<B>::operator>=(const common_iterator<B>& other) const {
+bool treap_base<Node, Allocator, Priority, Statistics>::common_iterator<B>::operator>=(const common_iterator<B>& other) const {
     return _node->order() >= other._node->order();
 }
 
-template <typename Node, typename Allocator>
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
 template <bool B>
-typename treap_base<Node, Allocator>::template common_iterator<B>
-treap_base<Node, Allocator>::common_iterator<B>::operator+(difference_type n) const {
+typename treap_base<Node, Allocator, Priority, Statistics>::template common_iterator<B>
+treap_base<Node, Allocator, Priority, Statistics>::common_iterator<B>::operator+(difference_type n) const {
     common_iterator<B> iter = *this;
     return iter += n;
 }
 
-template <typename Node, typename Allocator>
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
 template <bool B>
-typename treap_base<Node, Allocator>::template common_iterator<B>
-treap_base<Node, Allocator>::common_iterator<B>::operator-(difference_type n) const {
+typename treap_base<Node, Allocator, Priority, Statistics>::template common_iterator<B>
+treap_base<Node, Allocator, Priority, Statistics>::common_iterator<B>::operator-(difference_type n) const {
     common_iterator<B> iter = *this;
     return iter -= n;
 }
 
-template <typename Node, typename Allocator>
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
 template <bool B>
-typename treap_base<Node, Allocator>::size_type
-treap_base<Node, Allocator>::common_iterator<B>::order() const {
+typename treap_base<Node, Allocator, Priority, Statistics>::size_type
+treap_base<Node, Allocator, Priority, Statistics>::common_iterator<B>::order() const {
     return _node->order();
 }
 
 //==========================================Treap base implementation==========================================
 
-template <typename Node, typename Allocator>
-treap_base<Node, Allocator>::treap_base(const allocator_type& allocator)
-        : _end(), _begin(end_node()), _node_allocator(allocator) {}
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+treap_base<Node, Allocator, Priority, Statistics>::treap_base(const allocator_type& allocator)
+        : _end(), _begin(end_node()), _node_pool(allocator) {}
 
-template <typename Node, typename Allocator>
-treap_base<Node, Allocator>::treap_base(treap_node* tree, const allocator_type& allocator)
-        : _end(tree), _begin(tree->find_begin()), _node_allocator(allocator) {}
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+treap_base<Node, Allocator, Priority, Statistics>::treap_base(treap_node* tree, const allocator_type& allocator)
+        : _end(tree), _begin(tree->find_begin()), _node_pool(allocator) {}
 
-template <typename Node, typename Allocator>
-treap_base<Node, Allocator>::treap_base(const treap_base& other)
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+treap_base<Node, Allocator, Priority, Statistics>::treap_base(const treap_base& other)
         : _end(), _begin(end_node()),
-          _node_allocator(node_traits::select_on_container_copy_construction(other._node_allocator)) {}
+          _node_pool(node_traits::select_on_container_copy_construction(other._node_pool.allocator())),
+          _reclaim_step(other._reclaim_step) {}
 
-template <typename Node, typename Allocator>
-treap_base<Node, Allocator>::treap_base(treap_base&& other) noexcept
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+treap_base<Node, Allocator, Priority, Statistics>::treap_base(treap_base&& other) noexcept
         : _end(std::move(other._end)),
-          _begin(other.empty() ? end() : other._begin),
-          _node_allocator(std::move(other._node_allocator)) {}
+          _begin(std::exchange(other._begin, other.end_node())),
+          _node_pool(std::move(other._node_pool)),
+          _retired(std::exchange(other._retired, tree_list())),
+          _retired_size(std::exchange(other._retired_size, 0)),
+          _reclaim_step(other._reclaim_step) {
+    // begin of the empty tree is its own end node
+    if (empty()) {
+        _begin = end_node();
+    }
+}
 
-template <typename Node, typename Allocator>
-treap_base<Node, Allocator>&
-treap_base<Node, Allocator>::operator=(treap_base&& other) noexcept {
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+treap_base<Node, Allocator, Priority, Statistics>&
+treap_base<Node, Allocator, Priority, Statistics>::operator=(treap_base&& other) noexcept {
     if (this != &other) {
         treap_base moved(std::move(other));
         this->swap(moved);
@@ -655,59 +1052,284 @@ treap_base<Node, Allocator>::operator=(treap_base&& other) noexcept {
     return *this;
 }
 
-template <typename Node, typename Allocator>
-treap_base<Node, Allocator>::~treap_base() {
-    destroy_tree(root());
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+treap_base<Node, Allocator, Priority, Statistics>::~treap_base() {
+    release_tree();
 }
 
-template <typename Node, typename Allocator>
-void treap_base<Node, Allocator>::destroy_tree(treap_node* node) noexcept {
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+void treap_base<Node, Allocator, Priority, Statistics>::destroy_tree(treap_node* node) noexcept {
     if (node != nullptr) {
         // destroy child nodes
         destroy_tree(node->get_left());
         destroy_tree(node->get_right());
         // destroy node key and deallocate memory
-        node_holder holder(node, treap_node_destructor(_node_allocator, true));
+        node_holder holder(node, node_destructor(_node_pool, true));
+    }
+}
+
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+void treap_base<Node, Allocator, Priority, Statistics>::retire_tree(treap_node* node) noexcept {
+    if (_reclaim_step == 0) {
+        destroy_tree(node);
+        return;
+    }
+    if (node != nullptr) {
+        _retired_size += node->size();
+        _retired.push(node);
+    }
+    reclaim(_reclaim_step);
+}
+
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+void treap_base<Node, Allocator, Priority, Statistics>::set_reclaim_step(size_type step) noexcept {
+    _reclaim_step = step;
+    if (step == 0) {
+        reclaim();
+    }
+}
+
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+typename treap_base<Node, Allocator, Priority, Statistics>::size_type
+treap_base<Node, Allocator, Priority, Statistics>::reclaim(size_type count) noexcept {
+    for (; count > 0 && !_retired.empty(); --count) {
+        // node children become separate retired trees, so each step destroys exactly one node
+        treap_node* node = _retired.pop();
+        _retired.push(node->get_left());
+        _retired.push(node->get_right());
+        node_holder holder(node, node_destructor(_node_pool, true));
+        --_retired_size;
+    }
+    return _retired_size;
+}
+
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+treap_statistics treap_base<Node, Allocator, Priority, Statistics>::stats() const {
+    treap_statistics result;
+    result.size = size();
+    // explicit stack, so degenerate trees don't overflow the call stack
+    std::vector<std::pair<const treap_node*, size_type>> stack;
+    if (root() != nullptr) {
+        stack.emplace_back(root(), 1);
+    }
+    size_type total_depth = 0;
+    while (!stack.empty()) {
+        auto [node, depth] = stack.back();
+        stack.pop_back();
+        if (result.depth_histogram.size() < depth) {
+            result.depth_histogram.resize(depth);
+        }
+        ++result.depth_histogram[depth - 1];
+        total_depth += depth;
+        if (node->get_left() != nullptr) {
+            stack.emplace_back(node->get_left(), depth + 1);
+        }
+        if (node->get_right() != nullptr) {
+            stack.emplace_back(node->get_right(), depth + 1);
+        }
+    }
+    result.max_depth = result.depth_histogram.size();
+    if (result.size != 0) {
+        result.average_depth = static_cast<double>(total_depth) / static_cast<double>(result.size);
+    }
+    _statistics.fill(result);
+    return result;
+}
+
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+void treap_base<Node, Allocator, Priority, Statistics>::release_tree() noexcept {
+    if constexpr (!std::is_trivially_destructible_v<typename treap_node::value_type>) {
+        // values still need their destructors, but memory is released chunk by chunk
+        destroy_values(root());
+        while (!_retired.empty()) {
+            destroy_values(_retired.pop());
+        }
+    }
+    _retired = tree_list();
+    _retired_size = 0;
+    _node_pool.release();
+}
+
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+void treap_base<Node, Allocator, Priority, Statistics>::destroy_values(treap_node* node) noexcept {
+    if (node != nullptr) {
+        destroy_values(node->get_left());
+        destroy_values(node->get_right());
+        node_traits::destroy(_node_pool.allocator(), node->get_value_address());
     }
 }
 
-template <typename Node, typename Allocator>
-void treap_base<Node, Allocator>::swap(treap_base& other) noexcept {
-    std::swap(_node_allocator, other._node_allocator);
-    treap_node* begin = (other.empty() ? end() : other._begin);
-    std::swap(_begin, begin);
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+void treap_base<Node, Allocator, Priority, Statistics>::swap(treap_base& other) noexcept {
+    _node_pool.swap(other._node_pool);
+    std::swap(_retired, other._retired);
+    std::swap(_retired_size, other._retired_size);
+    std::swap(_reclaim_step, other._reclaim_step);
+    std::swap(_begin, other._begin);
     std::swap(_end, other._end);
+    // begin of the empty tree is its own end node
+    if (empty()) {
+        _begin = end_node();
+    }
+    if (other.empty()) {
+        other._begin = other.end_node();
+    }
 }
 
-template <typename Node, typename Allocator>
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
 template <typename... Args>
-typename treap_base<Node, Allocator>::node_holder treap_base<Node, Allocator>::construct_node(Args&& ... args) {
+typename treap_base<Node, Allocator, Priority, Statistics>::node_holder treap_base<Node, Allocator, Priority, Statistics>::construct_node(Args&& ... args) {
+    return construct_node_with_priority(next_priority(), std::forward<Args>(args)...);
+}
+
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+template <typename... Args>
+typename treap_base<Node, Allocator, Priority, Statistics>::node_holder
+treap_base<Node, Allocator, Priority, Statistics>::construct_node_with_priority(priority_type priority, Args&& ... args) {
+    if (_retired_size != 0) {
+        // insertions pay for the deferred destruction, the released nodes are reused at once
+        reclaim(_reclaim_step);
+    }
+    if constexpr (Statistics::enabled) {
+        _statistics.count_construction(_node_pool.exhausted());
+    }
     // allocate memory for new node
-    node_holder holder(node_traits::allocate(_node_allocator, 1), treap_node_destructor(_node_allocator));
+    node_holder holder(_node_pool.allocate(), node_destructor(_node_pool));
     // construct key using perfect forwarding technique
-    node_traits::construct(_node_allocator, holder->get_value_address(), std::forward<Args>(args)...);
+    node_traits::construct(_node_pool.allocator(), holder->get_value_address(), std::forward<Args>(args)...);
     // set value constructed flag true in order to destroy constructed value using deleter
     holder.get_deleter().value_constructed = true;
     // initialize non-initialized memory for avoiding segfaults
-    holder->set_members(random_generator(), nullptr, nullptr, nullptr);
+    holder->set_members(priority, nullptr, nullptr, nullptr);
     return holder;
 }
 
-template <typename Node>
-typename treap_node_base<Node>::treap_node* treap_node_base<Node>::node_of_offset(difference_type offset) {
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+void treap_base<Node, Allocator, Priority, Statistics>::tree_builder::push_back(treap_node* node) noexcept {
+    treap_node* top = _last;
+    treap_node* popped = nullptr;
+    // pop spine nodes having less priority, their subtrees are complete, so update their sizes bottom-up
+    while (top != nullptr && top->get_priority() < node->get_priority()) {
+        top->set_right(popped);
+        popped = top;
+        top = top->get_parent();
+    }
+    // popped nodes become the left subtree of the new node
+    node->set_left(popped);
+    if (top == nullptr) {
+        node->set_parent(nullptr);
+        _root = node;
+    } else {
+        top->set_right(node);
+    }
+    _last = node;
+}
+
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+typename treap_base<Node, Allocator, Priority, Statistics>::treap_node* treap_base<Node, Allocator, Priority, Statistics>::tree_builder::release() noexcept {
+    treap_node* popped = nullptr;
+    for (treap_node* top = _last; top != nullptr; top = top->get_parent()) {
+        top->set_right(popped);
+        popped = top;
+    }
+    _last = nullptr;
+    return std::exchange(_root, nullptr);
+}
+
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+template <typename Validator>
+typename treap_base<Node, Allocator, Priority, Statistics>::treap_node*
+treap_base<Node, Allocator, Priority, Statistics>::read_tree(std::istream& stream, Validator validator) {
+    using serializer = binary_serializer<std::remove_const_t<typename treap_node::value_type>>;
+    binary_reader reader(stream);
+    auto header = treap_serialization_header::read(reader);
+    bool with_priorities = (header.flags & treap_serialization_header::priorities_flag) != 0;
+    tree_builder builder;
+    try {
+        for (std::uint64_t i = 0; i < header.size; ++i) {
+            node_holder holder = construct_node(serializer::read(reader));
+            if (with_priorities) {
+                holder->set_members(static_cast<decltype(holder->get_priority())>(reader.read<std::uint64_t>()));
+            }
+            if (!validator(static_cast<const treap_node*>(builder.last()), static_cast<const treap_node*>(holder.get()))) {
+                throw serialization_error("Stream elements are out of order");
+            }
+            builder.push_back(holder.release());
+        }
+    } catch (...) {
+        destroy_tree(builder.release());
+        throw;
+    }
+    return builder.release();
+}
+
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+void treap_base<Node, Allocator, Priority, Statistics>::save(std::ostream& stream, bool with_priorities) const {
+    using serializer = binary_serializer<std::remove_const_t<typename treap_node::value_type>>;
+    binary_writer writer(stream);
+    treap_serialization_header header;
+    header.flags = (with_priorities ? treap_serialization_header::priorities_flag : 0);
+    header.size = size();
+    header.write(writer);
+    for (const treap_node* node = _begin; node != end_node(); node = node->successor()) {
+        serializer::write(writer, node->get_value());
+        if (with_priorities) {
+            writer.write(static_cast<std::uint64_t>(node->get_priority()));
+        }
+    }
+}
+
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+typename treap_base<Node, Allocator, Priority, Statistics>::node_type
+treap_base<Node, Allocator, Priority, Statistics>::make_node_handle(treap_node* node,
+                                                        typename node_pool_type::shared_chunks_pointer chunks) noexcept {
+    node->set_members(node->get_priority());
+    return node_type(node, _node_pool.allocator(), std::move(chunks));
+}
+
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+typename treap_base<Node, Allocator, Priority, Statistics>::treap_node*
+treap_base<Node, Allocator, Priority, Statistics>::adopt_node(node_type& handle) {
+    // the node memory must outlive the pool, which may deallocate the node
+    _node_pool.adopt(handle._chunks);
+    treap_node* node = handle.release().first;
+    node->set_members(node->get_priority());
+    return node;
+}
+
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+bool treap_base<Node, Allocator, Priority, Statistics>::splice_pool(treap_base& other) noexcept {
+    if (!(_node_pool.allocator() == other._node_pool.allocator())) {
+        return false;
+    }
+    _node_pool.splice(other._node_pool);
+    // other retired nodes lie in the taken memory now
+    _retired.splice(other._retired);
+    _retired_size += std::exchange(other._retired_size, 0);
+    if (_reclaim_step == 0) {
+        reclaim();
+    }
+    return true;
+}
+
+template <typename Node, typename Layout>
+typename treap_node_base<Node, Layout>::treap_node* treap_node_base<Node, Layout>::node_of_offset(difference_type offset) {
     return const_cast<treap_node*>(const_cast<const treap_node_base*>(this)->node_of_offset(offset));
 }
 
-template <typename Node>
-const typename treap_node_base<Node>::treap_node* treap_node_base<Node>::node_of_offset(difference_type offset) const {
+template <typename Node, typename Layout>
+const typename treap_node_base<Node, Layout>::treap_node* treap_node_base<Node, Layout>::node_of_offset(difference_type offset) const {
     const auto* root = static_cast<const treap_node*>(this);
     ptrdiff_t index = left_size() + offset;
     while (root != nullptr) {
-        if (0 <= index && index < root->size()) {
+        // end node has no own size field
+        ptrdiff_t size = (root->is_end_node() ? root->left_size() + 1 : root->size());
+        if (0 <= index && index < size) {
             return root->node_of_order(index);
         }
         const treap_node* parent = root->get_parent();
-        if (parent->get_right() == root) {
+        // end node has no right child field either
+        if (parent != nullptr && !parent->is_end_node() && parent->get_right() == root) {
             index += parent->left_size() + 1;
         }
         root = parent;
@@ -715,16 +1337,19 @@ const typename treap_node_base<Node>::treap_node* treap_node_base<Node>::node_of
     return nullptr;
 }
 
-template <typename Node>
-typename treap_node_base<Node>::treap_node* treap_node_base<Node>::node_of_order(size_type index) {
-    return const_cast<treap_node*>(const_cast<const treap_node_base<Node>*>(this)->node_of_order(index));
+template <typename Node, typename Layout>
+typename treap_node_base<Node, Layout>::treap_node* treap_node_base<Node, Layout>::node_of_order(size_type index) {
+    return const_cast<treap_node*>(const_cast<const treap_node_base*>(this)->node_of_order(index));
 }
 
-template <typename Node>
-const typename treap_node_base<Node>::treap_node* treap_node_base<Node>::node_of_order(size_type index) const {
+template <typename Node, typename Layout>
+const typename treap_node_base<Node, Layout>::treap_node* treap_node_base<Node, Layout>::node_of_order(size_type index) const {
     ++index;
     const auto* root = static_cast<const treap_node*>(this);
     while (root != nullptr) {
+        if (!root->is_end_node()) {
+            const_cast<treap_node*>(root)->push();
+        }
         size_type left_count = root->left_size();
         if (index == left_count + 1) {
             return root;
@@ -739,8 +1364,92 @@ const typename treap_node_base<Node>::treap_node* treap_node_base<Node>::node_of
     throw std::runtime_error("Unreachable code");
 }
 
-template <typename Node>
-typename treap_node_base<Node>::size_type treap_node_base<Node>::order() const {
+template <typename Node, typename Layout>
+const typename treap_node_base<Node, Layout>::treap_node* treap_node_base<Node, Layout>::find_begin() const {
+    auto* node = const_cast<treap_node*>(static_cast<const treap_node*>(this));
+    node->push();
+    while (node->get_left() != nullptr) {
+        node = node->get_left();
+        node->push();
+    }
+    return node;
+}
+
+template <typename Node, typename Layout>
+const typename treap_node_base<Node, Layout>::treap_node* treap_node_base<Node, Layout>::successor() const {
+    const auto* node = static_cast<const treap_node*>(this);
+    if (!node->is_end_node()) {
+        const_cast<treap_node*>(node)->push();
+        if (node->get_right() != nullptr) {
+            // right children of the left spine are visited right after their parents
+            auto* next = const_cast<treap_node*>(node->get_right());
+            next->push();
+            prefetch_node(next->get_right());
+            while (next->get_left() != nullptr) {
+                next = next->get_left();
+                next->push();
+                prefetch_node(next->get_right());
+            }
+            return next;
+        }
+    }
+    const treap_node* parent = node->get_parent();
+    // climb while the node is the right child, end node has only the left one
+    while (parent != nullptr && parent->get_left() != node) {
+        node = parent;
+        parent = parent->get_parent();
+    }
+    if (parent != nullptr && !parent->is_end_node()) {
+        prefetch_node(parent->get_right());
+    }
+    return parent;
+}
+
+template <typename Node, typename Layout>
+const typename treap_node_base<Node, Layout>::treap_node* treap_node_base<Node, Layout>::predecessor() const {
+    auto* node = const_cast<treap_node*>(static_cast<const treap_node*>(this));
+    if (!node->is_end_node()) {
+        node->push();
+    }
+    if (node->get_left() != nullptr) {
+        // left children of the right spine are visited right after their parents
+        node = node->get_left();
+        node->push();
+        prefetch_node(node->get_left());
+        while (node->get_right() != nullptr) {
+            node = node->get_right();
+            node->push();
+            prefetch_node(node->get_left());
+        }
+        return node;
+    }
+    const treap_node* child = node;
+    const treap_node* parent = child->get_parent();
+    // climb while the node is the left child, the first node is reached from the end node this way
+    while (parent != nullptr && parent->get_left() == child) {
+        child = parent;
+        parent = parent->get_parent();
+    }
+    if (parent != nullptr) {
+        prefetch_node(parent->get_left());
+    }
+    return parent;
+}
+
+template <typename Node, typename Layout>
+void treap_node_base<Node, Layout>::push_path() const {
+    if constexpr (treap_node::has_actions) {
+        auto* parent = const_cast<treap_node*>(_parent);
+        if (parent != nullptr && !parent->is_end_node()) {
+            parent->push_path();
+            parent->push();
+        }
+    }
+}
+
+template <typename Node, typename Layout>
+typename treap_node_base<Node, Layout>::size_type treap_node_base<Node, Layout>::order() const {
+    push_path();
     const auto* node = static_cast<const treap_node*>(this);
     bool is_left = true;
     size_type index = left_size();
@@ -754,108 +1463,301 @@ typename treap_node_base<Node>::size_type treap_node_base<Node>::order() const {
     return index;
 }
 
-template <typename Node, typename Allocator>
-typename treap_base<Node, Allocator>::iterator treap_base<Node, Allocator>::begin() {
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+typename treap_base<Node, Allocator, Priority, Statistics>::iterator treap_base<Node, Allocator, Priority, Statistics>::begin() {
     return {_begin};
 }
 
-template <typename Node, typename Allocator>
-typename treap_base<Node, Allocator>::const_iterator treap_base<Node, Allocator>::begin() const {
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+typename treap_base<Node, Allocator, Priority, Statistics>::const_iterator treap_base<Node, Allocator, Priority, Statistics>::begin() const {
     return cbegin();
 }
 
-template <typename Node, typename Allocator>
-typename treap_base<Node, Allocator>::iterator treap_base<Node, Allocator>::end() {
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+typename treap_base<Node, Allocator, Priority, Statistics>::iterator treap_base<Node, Allocator, Priority, Statistics>::end() {
     return {end_node()};
 }
 
-template <typename Node, typename Allocator>
-typename treap_base<Node, Allocator>::const_iterator treap_base<Node, Allocator>::end() const {
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+typename treap_base<Node, Allocator, Priority, Statistics>::const_iterator treap_base<Node, Allocator, Priority, Statistics>::end() const {
     return cend();
 }
 
-template <typename Node, typename Allocator>
-typename treap_base<Node, Allocator>::reverse_iterator treap_base<Node, Allocator>::rbegin() {
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+typename treap_base<Node, Allocator, Priority, Statistics>::reverse_iterator treap_base<Node, Allocator, Priority, Statistics>::rbegin() {
     return {end()};
 }
 
-template <typename Node, typename Allocator>
-typename treap_base<Node, Allocator>::const_reverse_iterator treap_base<Node, Allocator>::rbegin() const {
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+typename treap_base<Node, Allocator, Priority, Statistics>::const_reverse_iterator treap_base<Node, Allocator, Priority, Statistics>::rbegin() const {
     return {end()};
 }
 
-template <typename Node, typename Allocator>
-typename treap_base<Node, Allocator>::reverse_iterator treap_base<Node, Allocator>::rend() {
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+typename treap_base<Node, Allocator, Priority, Statistics>::reverse_iterator treap_base<Node, Allocator, Priority, Statistics>::rend() {
     return {begin()};
 }
 
-template <typename Node, typename Allocator>
-typename treap_base<Node, Allocator>::const_reverse_iterator treap_base<Node, Allocator>::rend() const {
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+typename treap_base<Node, Allocator, Priority, Statistics>::const_reverse_iterator treap_base<Node, Allocator, Priority, Statistics>::rend() const {
     return {begin()};
 }
 
-template <typename Node, typename Allocator>
-typename treap_base<Node, Allocator>::const_iterator treap_base<Node, Allocator>::cbegin() const {
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+typename treap_base<Node, Allocator, Priority, Statistics>::const_iterator treap_base<Node, Allocator, Priority, Statistics>::cbegin() const {
     return {_begin};
 }
 
-template <typename Node, typename Allocator>
-typename treap_base<Node, Allocator>::const_iterator treap_base<Node, Allocator>::cend() const {
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+typename treap_base<Node, Allocator, Priority, Statistics>::const_iterator treap_base<Node, Allocator, Priority, Statistics>::cend() const {
     return {end_node()};
 }
 
-template <typename Node, typename Allocator>
-typename treap_base<Node, Allocator>::const_reverse_iterator treap_base<Node, Allocator>::crbegin() const {
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+typename treap_base<Node, Allocator, Priority, Statistics>::const_reverse_iterator treap_base<Node, Allocator, Priority, Statistics>::crbegin() const {
     return {cend()};
 }
 
-template <typename Node, typename Allocator>
-typename treap_base<Node, Allocator>::const_reverse_iterator treap_base<Node, Allocator>::crend() const {
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+typename treap_base<Node, Allocator, Priority, Statistics>::const_reverse_iterator treap_base<Node, Allocator, Priority, Statistics>::crend() const {
     return {cbegin()};
 }
 
-template <typename Node, typename Allocator>
-typename treap_base<Node, Allocator>::treap_node*
-treap_base<Node, Allocator>::merge_with_index(treap_node* node1, treap_node* node2) noexcept {
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+void treap_base<Node, Allocator, Priority, Statistics>::split_collector::push_left(treap_node* node) noexcept {
+    if (_left_tail == nullptr) {
+        _left_root = node;
+    } else {
+        _left_tail->set_right(node);
+    }
+    _left_tail = node;
+}
+
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+void treap_base<Node, Allocator, Priority, Statistics>::split_collector::push_right(treap_node* node) noexcept {
+    if (_right_tail == nullptr) {
+        _right_root = node;
+    } else {
+        _right_tail->set_left(node);
+    }
+    _right_tail = node;
+}
+
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+auto treap_base<Node, Allocator, Priority, Statistics>::split_collector::release(treap_node* left_rest,
+                                                           treap_node* right_rest) noexcept
+-> std::pair<treap_node*, treap_node*> {
+    // the last appended nodes may still have links to the nodes of another tree
+    if (_left_tail != nullptr) {
+        _left_tail->set_right(left_rest);
+        update_path(_left_tail, _left_root);
+    } else {
+        _left_root = left_rest;
+    }
+    if (_right_tail != nullptr) {
+        _right_tail->set_left(right_rest);
+        update_path(_right_tail, _right_root);
+    } else {
+        _right_root = right_rest;
+    }
+    std::pair<treap_node*, treap_node*> result(_left_root, _right_root);
+    _left_root = _right_root = _left_tail = _right_tail = nullptr;
+    return result;
+}
+
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+void treap_base<Node, Allocator, Priority, Statistics>::tree_list::push(treap_node* tree) noexcept {
+    if (tree == nullptr) {
+        return;
+    }
+    tree->set_parent(_head);
+    _head = tree;
+    if (_tail == nullptr) {
+        _tail = tree;
+    }
+}
+
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+void treap_base<Node, Allocator, Priority, Statistics>::tree_list::splice(tree_list& other) noexcept {
+    if (other.empty()) {
+        return;
+    }
+    other._tail->set_parent(_head);
+    _head = other._head;
+    if (_tail == nullptr) {
+        _tail = other._tail;
+    }
+    other._head = other._tail = nullptr;
+}
+
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+typename treap_base<Node, Allocator, Priority, Statistics>::treap_node* treap_base<Node, Allocator, Priority, Statistics>::tree_list::pop() noexcept {
+    treap_node* tree = _head;
+    _head = tree->get_parent();
+    if (_head == nullptr) {
+        _tail = nullptr;
+    }
+    tree->set_parent(nullptr);
+    return tree;
+}
+
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+void treap_base<Node, Allocator, Priority, Statistics>::destroy_trees(tree_list& trees) noexcept {
+    while (!trees.empty()) {
+        destroy_tree(trees.pop());
+    }
+}
+
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+void treap_base<Node, Allocator, Priority, Statistics>::update_path(treap_node* node, const treap_node* root) noexcept {
+    while (true) {
+        node->update();
+        if (node == root) {
+            return;
+        }
+        node = node->get_parent();
+    }
+}
+
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+template <typename Before>
+const typename treap_base<Node, Allocator, Priority, Statistics>::treap_node*
+treap_base<Node, Allocator, Priority, Statistics>::bound_node_from(const treap_node* hint, Before before) const {
+    const treap_node* node = hint;
+    const treap_node* result = end_node();
+    if (hint == end_node()) {
+        // end node is the root parent, so the search descends from the root
+        node = root();
+    } else if (before(hint)) {
+        // the result lies after the hint, the climb stops at the first ancestor, which doesn't lie before the position
+        while (node->get_parent() != end_node()) {
+            const treap_node* parent = node->get_parent();
+            if (parent->get_left() == node && !before(parent)) {
+                result = parent;
+                break;
+            }
+            node = parent;
+        }
+    } else {
+        // the result is the hint or lies before it, the climb stops at the first ancestor lying before the position
+        result = hint;
+        while (node->get_parent() != end_node()) {
+            const treap_node* parent = node->get_parent();
+            if (parent->get_right() == node) {
+                if (before(parent)) {
+                    break;
+                }
+                result = parent;
+            }
+            node = parent;
+        }
+    }
+    size_type visited = 0;
+    while (node != nullptr) {
+        ++visited;
+        if (before(node)) {
+            node = node->get_right();
+            continue;
+        }
+        result = node;
+        node = node->get_left();
+    }
+    _statistics.count_lookup(visited);
+    return result;
+}
+
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+void treap_base<Node, Allocator, Priority, Statistics>::count_path(const treap_node* node) const noexcept {
+    if constexpr (Statistics::enabled) {
+        size_type depth = 0;
+        for (; node != end_node(); node = node->get_parent()) {
+            ++depth;
+        }
+        _statistics.count_lookup(depth);
+    }
+}
+
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+typename treap_base<Node, Allocator, Priority, Statistics>::treap_node*
+treap_base<Node, Allocator, Priority, Statistics>::merge_with_index(treap_node* node1, treap_node* node2) noexcept {
+    _statistics.count_merge();
     if (node1 == nullptr) {
         return node2;
     }
     if (node2 == nullptr) {
         return node1;
     }
-    if (node1->get_priority() > node2->get_priority()) {
-        node1->set_right(merge_with_index(node1->get_right(), node2));
-        return node1;
+    treap_node* result = nullptr;
+    // the last linked node and the side, where the next node should be linked
+    treap_node* parent = nullptr;
+    bool link_right = false;
+    while (node1 != nullptr && node2 != nullptr) {
+        treap_node* top;
+        bool right;
+        // pending actions must reach the children before relinking
+        node1->push();
+        node2->push();
+        if (node1->get_priority() > node2->get_priority()) {
+            // node1 keeps its left subtree, the rest goes to its right
+            top = node1;
+            node1 = node1->get_right();
+            right = true;
+        } else {
+            // node2 keeps its right subtree, the rest goes to its left
+            top = node2;
+            node2 = node2->get_left();
+            right = false;
+        }
+        if (parent == nullptr) {
+            result = top;
+        } else if (link_right) {
+            parent->set_right(top);
+        } else {
+            parent->set_left(top);
+        }
+        parent = top;
+        link_right = right;
+    }
+    // link the rest of the non-empty tree
+    treap_node* rest = (node1 == nullptr ? node2 : node1);
+    if (link_right) {
+        parent->set_right(rest);
+    } else {
+        parent->set_left(rest);
     }
-    node2->set_left(merge_with_index(node1, node2->get_left()));
-    return node2;
+    update_path(parent, result);
+    return result;
 }
 
-template <typename Node, typename Allocator>
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
 auto
-treap_base<Node, Allocator>::split_with_index(treap_node* node,
+treap_base<Node, Allocator, Priority, Statistics>::split_with_index(treap_node* node,
                                               size_type index) noexcept -> std::pair<treap_node*, treap_node*> {
+    _statistics.count_split();
     if (node == nullptr || index <= 0) {
         return std::make_pair(nullptr, node);
     }
     if (index >= node->size()) {
         return std::make_pair(node, nullptr);
     }
-    if (node->left_size() < index) {
-        auto [first, second] = split_with_index(node->get_right(), index - node->left_size() - 1);
-        node->set_right(first);
-        // return separated nodes
-        return {node, second};
+    split_collector collector;
+    while (node != nullptr) {
+        node->push();
+        if (node->left_size() < index) {
+            index -= node->left_size() + 1;
+            collector.push_left(node);
+            node = node->get_right();
+            continue;
+        }
+        collector.push_right(node);
+        node = node->get_left();
     }
-    auto [first, second] = split_with_index(node->get_left(), index);
-    node->set_left(second);
-    // return separated nodes
-    return {first, node};
+    return collector.release();
 }
 
-template <typename Node, typename Allocator>
-typename treap_base<Node, Allocator>::treap_node*
-treap_base<Node, Allocator>::detach_interval(size_type begin, size_type end) noexcept {
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+typename treap_base<Node, Allocator, Priority, Statistics>::treap_node*
+treap_base<Node, Allocator, Priority, Statistics>::detach_interval(size_type begin, size_type end) noexcept {
     if (end <= begin) {
         return nullptr;
     }
@@ -869,31 +1771,31 @@ treap_base<Node, Allocator>::detach_interval(size_type begin, size_type end) noe
     return interval;
 }
 
-template <typename Node, typename Allocator>
-typename treap_base<Node, Allocator>::iterator
-treap_base<Node, Allocator>::erase_interval(size_type begin, size_type end) noexcept {
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+typename treap_base<Node, Allocator, Priority, Statistics>::iterator
+treap_base<Node, Allocator, Priority, Statistics>::erase_interval(size_type begin, size_type end) noexcept {
     auto* interval = detach_interval(begin, end);
     // erase the interval
-    destroy_tree(interval);
+    retire_tree(interval);
     return treap_base::begin() + begin;
 }
 
-template <typename Node, typename Allocator>
-typename treap_base<Node, Allocator>::iterator
-treap_base<Node, Allocator>::erase_index(size_type index) noexcept {
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+typename treap_base<Node, Allocator, Priority, Statistics>::iterator
+treap_base<Node, Allocator, Priority, Statistics>::erase_index(size_type index) noexcept {
     erase_interval(index, index + 1);
     return treap_base::begin() + index;
 }
 
-template <typename Node, typename Allocator>
-typename treap_base<Node, Allocator>::iterator
-treap_base<Node, Allocator>::erase(const_iterator it) noexcept {
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+typename treap_base<Node, Allocator, Priority, Statistics>::iterator
+treap_base<Node, Allocator, Priority, Statistics>::erase(const_iterator it) noexcept {
     return erase_index(it.order());
 }
 
-template <typename Node, typename Allocator>
-typename treap_base<Node, Allocator>::iterator
-treap_base<Node, Allocator>::erase(const_iterator begin, const_iterator end) noexcept {
+template <typename Node, typename Allocator, typename Priority, typename Statistics>
+typename treap_base<Node, Allocator, Priority, Statistics>::iterator
+treap_base<Node, Allocator, Priority, Statistics>::erase(const_iterator begin, const_iterator end) noexcept {
     return erase_interval(begin.order(), end.order());
 }
 
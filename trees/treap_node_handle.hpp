@@ -0,0 +1,113 @@
+#ifndef BASICS_TREAP_NODE_HANDLE_HPP
+#define BASICS_TREAP_NODE_HANDLE_HPP
+
+#include <memory>
+#include <optional>
+#include <utility>
+
+namespace nstd {
+
+/**
+ * Node handle of treap containers, C++17 node_type analogue
+ * Owns a node extracted from the container, which can be inserted into another container without copying its value
+ * Keeps the extracted node memory alive, even if the source container is destroyed
+ * Dropped node memory returns to the free list of the shared chunks group, so the group containers reuse it
+ * @tparam Node treap node class
+ * @tparam Pool node pool class of the containers
+ */
+template <typename Node, typename Pool>
+class treap_node_handle {
+    template <typename, typename, typename, typename>
+    friend class treap_base;
+
+public:
+    using allocator_type = typename Pool::allocator_type;
+
+private:
+    using allocator_traits = typename Pool::allocator_traits;
+    using shared_chunks_pointer = typename Pool::shared_chunks_pointer;
+
+private:
+    Node* _node = nullptr;
+    std::optional<allocator_type> _allocator;
+    shared_chunks_pointer _chunks;
+
+public:
+    treap_node_handle() noexcept = default;
+
+    treap_node_handle(const treap_node_handle& other) = delete;
+
+    treap_node_handle(treap_node_handle&& other) noexcept
+            : _node(std::exchange(other._node, nullptr)),
+              _allocator(std::move(other._allocator)),
+              _chunks(std::move(other._chunks)) {
+        other._allocator.reset();
+    }
+
+    treap_node_handle& operator=(const treap_node_handle& other) = delete;
+
+    treap_node_handle& operator=(treap_node_handle&& other) noexcept {
+        if (this != &other) {
+            treap_node_handle moved(std::move(other));
+            swap(moved);
+        }
+        return *this;
+    }
+
+    ~treap_node_handle() { reset(); }
+
+public:
+    bool empty() const noexcept { return _node == nullptr; }
+
+    explicit operator bool() const noexcept { return _node != nullptr; }
+
+    allocator_type get_allocator() const { return *_allocator; }
+
+    /**
+     * Gives the node value, handle must not be empty
+     * Keys of ordered containers are given as constant
+     */
+    decltype(auto) value() const { return _node->get_value(); }
+
+    decltype(auto) key() const { return _node->get_key(); }
+
+    /**
+     * Gives the mapped value of map node, handle must not be empty
+     */
+    template <typename N = Node>
+    auto& mapped() const { return static_cast<N*>(_node)->get_value().second; }
+
+    void swap(treap_node_handle& other) noexcept {
+        std::swap(_node, other._node);
+        std::swap(_allocator, other._allocator);
+        _chunks.swap(other._chunks);
+    }
+
+private:
+    treap_node_handle(Node* node, const allocator_type& allocator, shared_chunks_pointer chunks) noexcept
+            : _node(node), _allocator(allocator), _chunks(std::move(chunks)) {}
+
+    /**
+     * Releases the node ownership, the node memory is kept by the returned shared chunks
+     */
+    std::pair<Node*, shared_chunks_pointer> release() noexcept {
+        _allocator.reset();
+        return {std::exchange(_node, nullptr), std::move(_chunks)};
+    }
+
+    /**
+     * Destroys the node value and returns the node memory to the shared chunks group
+     */
+    void reset() noexcept {
+        if (_node != nullptr) {
+            allocator_traits::destroy(*_allocator, _node->get_value_address());
+            Pool::deallocate_shared(_chunks, std::exchange(_node, nullptr));
+        }
+        _allocator.reset();
+        _chunks.reset();
+    }
+};
+
+} // namespace nstd
+
+#endif //BASICS_TREAP_NODE_HANDLE_HPP
@@ -0,0 +1,382 @@
+#ifndef BASICS_TREAP_NODE_POOL_HPP
+#define BASICS_TREAP_NODE_POOL_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+
+namespace nstd {
+
+/**
+ * Slab node pool for treap nodes
+ * Allocates node memory in chunks through the passed allocator and recycles deallocated nodes using free list
+ * Chunk sizes grow geometrically, so n allocations cost O(log n) allocator calls
+ * All the chunks are released at once in O(chunks count) complexity
+ * Pool does not construct or destroy node values, it only manages raw node memory
+ * Nodes may leave the pool through node handles (see share function), then the chunks are moved to shared chunks group,
+ * which is released, when the last pool or node handle using it is destroyed
+ * Dropped node handles return their nodes to the group free list, which is reused by the group pools
+ * Group state is guarded by the groups mutex, so containers exchanging nodes may be used by different threads
+ * @tparam Node treap node class
+ * @tparam Allocator node allocator class (already rebound to Node)
+ */
+template <typename Node, typename Allocator>
+class treap_node_pool {
+public:
+    using node_type = Node;
+    using allocator_type = Allocator;
+    using allocator_traits = std::allocator_traits<allocator_type>;
+    using size_type = size_t;
+
+private:
+    // deallocated node memory is reused for storing the free list link
+    struct free_slot {
+        free_slot* next;
+    };
+
+    // the first node slot of each chunk is reused for storing chunk header
+    struct chunk_header {
+        node_type* next;
+        size_type capacity;
+    };
+
+    static_assert(sizeof(chunk_header) <= sizeof(node_type) && alignof(chunk_header) <= alignof(node_type),
+                  "Treap node is too small for storing chunk header");
+
+public:
+    /**
+     * Group of chunks owned jointly by pools and node handles
+     * Groups of pools exchanging nodes are united like in disjoint set union:
+     * chunks of the absorbed group are moved to the other one and the absorbed group forwards to it,
+     * so holding any group of the union keeps all the union chunks alive
+     */
+    class shared_chunks {
+        friend class treap_node_pool;
+
+    private:
+        allocator_type _allocator;
+        node_type* _chunks = nullptr;
+        // nodes of dropped node handles
+        free_slot* _free = nullptr;
+        std::shared_ptr<shared_chunks> _forward;
+
+    public:
+        explicit shared_chunks(const allocator_type& allocator) noexcept: _allocator(allocator) {}
+
+        shared_chunks(const shared_chunks& other) = delete;
+
+        shared_chunks& operator=(const shared_chunks& other) = delete;
+
+        ~shared_chunks() { release_chunks(_allocator, _chunks); }
+    };
+
+    using shared_chunks_pointer = std::shared_ptr<shared_chunks>;
+
+    // chunk capacities (header slot included) are doubling starting from the minimal one
+    static constexpr size_type min_chunk_capacity = 8;
+    static constexpr size_type max_chunk_capacity = 4096;
+
+private:
+    allocator_type _allocator;
+    // the most recently allocated chunk, chunks are linked through their headers
+    node_type* _chunks;
+    // free list of deallocated nodes
+    free_slot* _free;
+    // never used node slots of the most recently allocated chunk
+    node_type* _cursor;
+    node_type* _chunk_end;
+    // capacity of the next allocated chunk
+    size_type _next_capacity;
+    // group owning the chunks of the nodes, which have left the pool or came from other pools, nullptr if there are none
+    shared_chunks_pointer _shared;
+    // guards the state of all the groups, it's locked only when nodes leave or join pools or group free lists are used
+    static inline std::mutex _groups_mutex;
+
+public:
+    explicit treap_node_pool(const allocator_type& allocator = allocator_type()) noexcept
+            : _allocator(allocator), _chunks(nullptr), _free(nullptr), _cursor(nullptr), _chunk_end(nullptr),
+              _next_capacity(min_chunk_capacity) {}
+
+    treap_node_pool(const treap_node_pool& other) = delete;
+
+    treap_node_pool(treap_node_pool&& other) noexcept
+            : _allocator(std::move(other._allocator)),
+              _chunks(std::exchange(other._chunks, nullptr)),
+              _free(std::exchange(other._free, nullptr)),
+              _cursor(std::exchange(other._cursor, nullptr)),
+              _chunk_end(std::exchange(other._chunk_end, nullptr)),
+              _next_capacity(std::exchange(other._next_capacity, min_chunk_capacity)),
+              _shared(std::move(other._shared)) {}
+
+    treap_node_pool& operator=(const treap_node_pool& other) = delete;
+
+    treap_node_pool& operator=(treap_node_pool&& other) noexcept {
+        if (this != &other) {
+            treap_node_pool moved(std::move(other));
+            swap(moved);
+        }
+        return *this;
+    }
+
+    ~treap_node_pool() { release(); }
+
+public:
+    allocator_type& allocator() noexcept { return _allocator; }
+
+    const allocator_type& allocator() const noexcept { return _allocator; }
+
+    /**
+     * Gives raw memory for one node
+     * Takes node from the free list if it's not empty, otherwise from the current chunk
+     * Allocates new chunk only when the current one is exhausted
+     * @return pointer to non-initialized node memory
+     */
+    node_type* allocate();
+
+    /**
+     * Tells whether the next allocate call takes a new chunk from the allocator
+     */
+    bool exhausted() const noexcept {
+        if (_free != nullptr || _cursor != _chunk_end) {
+            return false;
+        }
+        if (_shared == nullptr) {
+            return true;
+        }
+        std::lock_guard<std::mutex> lock(_groups_mutex);
+        return representative(_shared)->_free == nullptr;
+    }
+
+    /**
+     * Returns node memory to the free list
+     * Node value must be already destroyed
+     * @param node node allocated by this pool
+     */
+    void deallocate(node_type* node) noexcept;
+
+    /**
+     * Returns memory of the node, which has left its pool, to the group free list
+     * The group pools reuse it before allocating new chunks
+     * Node value must be already destroyed
+     * @param chunks shared group given by share function for the node
+     */
+    static void deallocate_shared(const shared_chunks_pointer& chunks, node_type* node) noexcept;
+
+    /**
+     * Deallocates all the chunks in O(chunks count) complexity
+     * All the nodes allocated by this pool become invalid
+     */
+    void release() noexcept;
+
+    /**
+     * Takes the ownership of all the other pool chunks, so nodes allocated by the other pool can be deallocated by this one
+     * Works in O(other chunks count + other free list size) complexity
+     * Pool allocators must be equal
+     * @param other other pool, which becomes empty
+     */
+    void splice(treap_node_pool& other) noexcept;
+
+    /**
+     * Moves the pool chunks to its shared group, so the current nodes can outlive the pool
+     * Allocates only the first time, afterwards works in O(pool chunks count) complexity
+     * @return shared group keeping the memory of all the current pool nodes
+     */
+    shared_chunks_pointer share();
+
+    /**
+     * Unites the pool group with the passed one, so the group nodes can be deallocated by this pool
+     * Works in O(group chunks count + group free list size) complexity without allocations
+     * Groups must have equal allocators
+     * @param chunks shared group
+     */
+    void adopt(const shared_chunks_pointer& chunks) noexcept;
+
+    void swap(treap_node_pool& other) noexcept;
+
+private:
+    static void release_chunks(allocator_type& allocator, node_type* chunks) noexcept;
+
+    // links the chunks list before the other list, returns the united list
+    static node_type* link_chunks(node_type* chunks, node_type* other) noexcept;
+
+    // gives the group representative, which keeps the union chunks
+    static const shared_chunks_pointer& representative(const shared_chunks_pointer& chunks) noexcept;
+};
+
+template <typename Node, typename Allocator>
+typename treap_node_pool<Node, Allocator>::node_type* treap_node_pool<Node, Allocator>::allocate() {
+    if (_free != nullptr) {
+        free_slot* slot = _free;
+        _free = slot->next;
+        return reinterpret_cast<node_type*>(slot);
+    }
+    if (_cursor == _chunk_end) {
+        // nodes of dropped node handles are reused before allocating new chunk
+        if (_shared != nullptr) {
+            std::unique_lock<std::mutex> lock(_groups_mutex);
+            free_slot* slot = std::exchange(representative(_shared)->_free, nullptr);
+            lock.unlock();
+            if (slot != nullptr) {
+                _free = slot->next;
+                return reinterpret_cast<node_type*>(slot);
+            }
+        }
+        size_type capacity = _next_capacity;
+        node_type* chunk = allocator_traits::allocate(_allocator, capacity);
+        ::new(static_cast<void*>(chunk)) chunk_header{_chunks, capacity};
+        _chunks = chunk;
+        // the first slot is occupied by the header
+        _cursor = chunk + 1;
+        _chunk_end = chunk + capacity;
+        _next_capacity = std::min(2 * capacity, max_chunk_capacity);
+    }
+    return _cursor++;
+}
+
+template <typename Node, typename Allocator>
+void treap_node_pool<Node, Allocator>::deallocate(node_type* node) noexcept {
+    _free = ::new(static_cast<void*>(node)) free_slot{_free};
+}
+
+template <typename Node, typename Allocator>
+void treap_node_pool<Node, Allocator>::deallocate_shared(const shared_chunks_pointer& chunks, node_type* node) noexcept {
+    std::lock_guard<std::mutex> lock(_groups_mutex);
+    const shared_chunks_pointer& group = representative(chunks);
+    group->_free = ::new(static_cast<void*>(node)) free_slot{group->_free};
+}
+
+template <typename Node, typename Allocator>
+void treap_node_pool<Node, Allocator>::release() noexcept {
+    release_chunks(_allocator, std::exchange(_chunks, nullptr));
+    // shared chunks are released by their last user
+    _shared.reset();
+    _free = nullptr;
+    _cursor = _chunk_end = nullptr;
+    _next_capacity = min_chunk_capacity;
+}
+
+template <typename Node, typename Allocator>
+void treap_node_pool<Node, Allocator>::splice(treap_node_pool& other) noexcept {
+    if (this == &other) {
+        return;
+    }
+    // other nodes may lie in other shared chunks
+    if (other._shared != nullptr) {
+        adopt(other._shared);
+        other._shared.reset();
+    }
+    if (other._chunks == nullptr && other._free == nullptr && other._cursor == other._chunk_end) {
+        return;
+    }
+    // link other chunks before this pool chunks
+    _chunks = link_chunks(std::exchange(other._chunks, nullptr), _chunks);
+    // link other free list before this pool free list
+    if (other._free != nullptr) {
+        free_slot* last_slot = other._free;
+        while (last_slot->next != nullptr) {
+            last_slot = last_slot->next;
+        }
+        last_slot->next = _free;
+        _free = std::exchange(other._free, nullptr);
+    }
+    // keep only one never used region, slots of the other one go to the free list
+    if (_cursor == _chunk_end) {
+        std::swap(_cursor, other._cursor);
+        std::swap(_chunk_end, other._chunk_end);
+    }
+    for (; other._cursor != other._chunk_end; ++other._cursor) {
+        deallocate(other._cursor);
+    }
+    other._cursor = other._chunk_end = nullptr;
+    _next_capacity = std::max(_next_capacity, std::exchange(other._next_capacity, min_chunk_capacity));
+}
+
+template <typename Node, typename Allocator>
+void treap_node_pool<Node, Allocator>::swap(treap_node_pool& other) noexcept {
+    std::swap(_allocator, other._allocator);
+    std::swap(_chunks, other._chunks);
+    std::swap(_free, other._free);
+    std::swap(_cursor, other._cursor);
+    std::swap(_chunk_end, other._chunk_end);
+    std::swap(_next_capacity, other._next_capacity);
+    _shared.swap(other._shared);
+}
+
+template <typename Node, typename Allocator>
+typename treap_node_pool<Node, Allocator>::shared_chunks_pointer treap_node_pool<Node, Allocator>::share() {
+    if (_shared == nullptr) {
+        _shared = std::make_shared<shared_chunks>(_allocator);
+    }
+    std::lock_guard<std::mutex> lock(_groups_mutex);
+    _shared = representative(_shared);
+    // the pool keeps using the chunk memory, but the group owns it from now
+    _shared->_chunks = link_chunks(std::exchange(_chunks, nullptr), _shared->_chunks);
+    return _shared;
+}
+
+template <typename Node, typename Allocator>
+void treap_node_pool<Node, Allocator>::adopt(const shared_chunks_pointer& chunks) noexcept {
+    std::lock_guard<std::mutex> lock(_groups_mutex);
+    if (_shared == nullptr) {
+        _shared = representative(chunks);
+        return;
+    }
+    const shared_chunks_pointer& group = representative(_shared);
+    const shared_chunks_pointer& other = representative(chunks);
+    if (group == other) {
+        _shared = group;
+        return;
+    }
+    group->_chunks = link_chunks(std::exchange(other->_chunks, nullptr), group->_chunks);
+    if (other->_free != nullptr) {
+        free_slot* last_slot = other->_free;
+        while (last_slot->next != nullptr) {
+            last_slot = last_slot->next;
+        }
+        last_slot->next = group->_free;
+        group->_free = std::exchange(other->_free, nullptr);
+    }
+    other->_forward = group;
+    _shared = group;
+}
+
+template <typename Node, typename Allocator>
+void treap_node_pool<Node, Allocator>::release_chunks(allocator_type& allocator, node_type* chunks) noexcept {
+    while (chunks != nullptr) {
+        auto* header = reinterpret_cast<chunk_header*>(chunks);
+        node_type* next = header->next;
+        allocator_traits::deallocate(allocator, chunks, header->capacity);
+        chunks = next;
+    }
+}
+
+template <typename Node, typename Allocator>
+typename treap_node_pool<Node, Allocator>::node_type*
+treap_node_pool<Node, Allocator>::link_chunks(node_type* chunks, node_type* other) noexcept {
+    if (chunks == nullptr) {
+        return other;
+    }
+    node_type* last_chunk = chunks;
+    while (reinterpret_cast<chunk_header*>(last_chunk)->next != nullptr) {
+        last_chunk = reinterpret_cast<chunk_header*>(last_chunk)->next;
+    }
+    reinterpret_cast<chunk_header*>(last_chunk)->next = other;
+    return chunks;
+}
+
+template <typename Node, typename Allocator>
+const typename treap_node_pool<Node, Allocator>::shared_chunks_pointer&
+treap_node_pool<Node, Allocator>::representative(const shared_chunks_pointer& chunks) noexcept {
+    const shared_chunks_pointer* group = &chunks;
+    while ((*group)->_forward != nullptr) {
+        group = &(*group)->_forward;
+    }
+    return *group;
+}
+
+} // namespace nstd
+
+#endif //BASICS_TREAP_NODE_POOL_HPP
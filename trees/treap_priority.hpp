@@ -0,0 +1,68 @@
+#ifndef BASICS_TREAP_PRIORITY_HPP
+#define BASICS_TREAP_PRIORITY_HPP
+
+#include <atomic>
+#include <chrono>
+
+namespace nstd {
+
+/**
+ * Priority generators for treap nodes
+ * Each container owns its generator instance, so inserting into different containers from different threads is safe
+ * Generator is default constructible and returns the next node priority with operator()
+ * Both generators are splitmix64 sequences keeping only 8 bytes of state
+ */
+
+/**
+ * splitmix64 step, gives well mixed 64-bit values for consecutive states
+ * @param state generator state, which is advanced
+ * @return next value of the sequence
+ */
+inline unsigned long long splitmix64(unsigned long long& state) noexcept {
+    unsigned long long value = (state += 0x9e3779b97f4a7c15ULL);
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
+
+/**
+ * Default priority generator
+ * Every instance gets its own seed, so tree shapes are not reproducible between runs
+ */
+class random_priority_generator {
+private:
+    unsigned long long _state;
+
+public:
+    random_priority_generator() noexcept: _state(next_seed()) {}
+
+    unsigned long long operator()() noexcept { return splitmix64(_state); }
+
+private:
+    // seeds are taken from the process-wide sequence started from the clock
+    static unsigned long long next_seed() noexcept {
+        static std::atomic<unsigned long long> sequence(
+                static_cast<unsigned long long>(std::chrono::steady_clock::now().time_since_epoch().count()));
+        unsigned long long seed = sequence.fetch_add(1, std::memory_order_relaxed);
+        return splitmix64(seed);
+    }
+};
+
+/**
+ * Deterministic priority generator
+ * Every instance starts from the same seed, so the same operation sequence gives the same tree shape
+ * Is meant for tests and benchmarks
+ * @tparam Seed initial state
+ */
+template <unsigned long long Seed = 0>
+class seeded_priority_generator {
+private:
+    unsigned long long _state = Seed;
+
+public:
+    unsigned long long operator()() noexcept { return splitmix64(_state); }
+};
+
+} // namespace nstd
+
+#endif //BASICS_TREAP_PRIORITY_HPP
@@ -0,0 +1,174 @@
+#ifndef BASICS_TREAP_SERIALIZATION_HPP
+#define BASICS_TREAP_SERIALIZATION_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace nstd {
+
+/**
+ * Binary format of treap containers
+ * Header: magic, version, flags and elements count, then elements in the container order
+ * Each element is written by binary_serializer and followed by its node priority, when the flag is set
+ * Values are written in the native byte order, so the format is not portable between architectures
+ */
+
+/**
+ * Is thrown, when the stream doesn't contain valid treap data or can't be read or written
+ */
+class serialization_error : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+/**
+ * Streaming reader over std::istream
+ * Reads exactly the requested bytes and throws serialization_error otherwise
+ */
+class binary_reader {
+private:
+    std::istream& _stream;
+
+public:
+    explicit binary_reader(std::istream& stream) noexcept: _stream(stream) {}
+
+    void read(void* data, std::streamsize size) {
+        if (!_stream.read(static_cast<char*>(data), size)) {
+            throw serialization_error("Unexpected end of the stream");
+        }
+    }
+
+    template <typename T>
+    T read() {
+        static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable values are read as raw bytes");
+        T value;
+        read(&value, sizeof(T));
+        return value;
+    }
+};
+
+/**
+ * Streaming writer over std::ostream
+ * Throws serialization_error, when the stream fails
+ */
+class binary_writer {
+private:
+    std::ostream& _stream;
+
+public:
+    explicit binary_writer(std::ostream& stream) noexcept: _stream(stream) {}
+
+    void write(const void* data, std::streamsize size) {
+        if (!_stream.write(static_cast<const char*>(data), size)) {
+            throw serialization_error("Failed to write to the stream");
+        }
+    }
+
+    template <typename T>
+    void write(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable values are written as raw bytes");
+        write(&value, sizeof(T));
+    }
+};
+
+/**
+ * Writes and reads container values
+ * Is defined for trivially copyable types, std::pair and std::basic_string
+ * Specialize it for other types with static write(binary_writer&, const T&) and read(binary_reader&) functions
+ * read may return any type the container value is constructible from
+ */
+template <typename T, typename = void>
+struct binary_serializer;
+
+template <typename T>
+struct binary_serializer<T, std::enable_if_t<std::is_trivially_copyable_v<T>>> {
+    static void write(binary_writer& writer, const T& value) { writer.write(value); }
+
+    static std::remove_const_t<T> read(binary_reader& reader) { return reader.read<std::remove_const_t<T>>(); }
+};
+
+template <typename First, typename Second>
+struct binary_serializer<std::pair<First, Second>,
+        std::enable_if_t<!std::is_trivially_copyable_v<std::pair<First, Second>>>> {
+    static void write(binary_writer& writer, const std::pair<First, Second>& value) {
+        binary_serializer<std::remove_const_t<First>>::write(writer, value.first);
+        binary_serializer<std::remove_const_t<Second>>::write(writer, value.second);
+    }
+
+    static auto read(binary_reader& reader) {
+        // members are read in the written order
+        auto first = binary_serializer<std::remove_const_t<First>>::read(reader);
+        auto second = binary_serializer<std::remove_const_t<Second>>::read(reader);
+        return std::make_pair(std::move(first), std::move(second));
+    }
+};
+
+template <typename Char, typename Traits, typename Allocator>
+struct binary_serializer<std::basic_string<Char, Traits, Allocator>> {
+    static_assert(std::is_trivially_copyable_v<Char>, "String characters must be trivially copyable");
+
+    static void write(binary_writer& writer, const std::basic_string<Char, Traits, Allocator>& value) {
+        writer.write(static_cast<std::uint64_t>(value.size()));
+        writer.write(value.data(), static_cast<std::streamsize>(value.size() * sizeof(Char)));
+    }
+
+    static std::basic_string<Char, Traits, Allocator> read(binary_reader& reader) {
+        auto size = reader.read<std::uint64_t>();
+        std::basic_string<Char, Traits, Allocator> value;
+        // the string grows while it's read, so a corrupted size can't cause a huge allocation
+        constexpr std::uint64_t step = 4096;
+        for (std::uint64_t offset = 0; offset < size; offset += step) {
+            auto count = static_cast<size_t>(std::min(step, size - offset));
+            value.resize(static_cast<size_t>(offset) + count);
+            reader.read(value.data() + offset, static_cast<std::streamsize>(count * sizeof(Char)));
+        }
+        return value;
+    }
+};
+
+/**
+ * Header of the serialized container
+ */
+struct treap_serialization_header {
+    static constexpr std::uint32_t magic_value = 0x50525454; // "TTRP"
+    static constexpr std::uint16_t current_version = 1;
+    // the elements are followed by their node priorities
+    static constexpr std::uint16_t priorities_flag = 1;
+
+    std::uint32_t magic = magic_value;
+    std::uint16_t version = current_version;
+    std::uint16_t flags = 0;
+    std::uint64_t size = 0;
+
+    void write(binary_writer& writer) const {
+        writer.write(magic);
+        writer.write(version);
+        writer.write(flags);
+        writer.write(size);
+    }
+
+    static treap_serialization_header read(binary_reader& reader) {
+        treap_serialization_header header;
+        header.magic = reader.read<std::uint32_t>();
+        header.version = reader.read<std::uint16_t>();
+        header.flags = reader.read<std::uint16_t>();
+        header.size = reader.read<std::uint64_t>();
+        if (header.magic != magic_value) {
+            throw serialization_error("Stream doesn't contain treap data");
+        }
+        if (header.version != current_version) {
+            throw serialization_error("Unsupported treap data version");
+        }
+        return header;
+    }
+};
+
+} // namespace nstd
+
+#endif //BASICS_TREAP_SERIALIZATION_HPP
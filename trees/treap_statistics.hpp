@@ -0,0 +1,130 @@
+#ifndef BASICS_TREAP_STATISTICS_HPP
+#define BASICS_TREAP_STATISTICS_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace nstd {
+
+/**
+ * Statistics policies of treap containers
+ * Each container owns its policy instance, the policy is notified about lookups, splits, merges and node constructions
+ * no_treap_statistics is the default, its hooks are empty, so they are compiled out
+ * treap_operation_counters counts the operations
+ */
+
+/**
+ * Snapshot of the container shape and operation counters, is given by stats() function of treap containers
+ */
+struct treap_statistics {
+    size_t size = 0;
+    // depth_histogram[i] is the nodes count of depth i + 1, the root depth is 1
+    std::vector<size_t> depth_histogram;
+    // the longest root to node path length
+    size_t max_depth = 0;
+    // average root to node path length, is about 2 ln size for random priorities
+    double average_depth = 0;
+
+    // counters stay zero without counting policy
+    size_t lookups = 0;
+    // nodes visited by the lookup descents
+    size_t visited_nodes = 0;
+    size_t splits = 0;
+    size_t merges = 0;
+    size_t constructed_nodes = 0;
+    // allocator calls made by the node pool for the constructed nodes
+    size_t allocations = 0;
+
+    double visited_nodes_per_lookup() const {
+        return (lookups == 0 ? 0 : static_cast<double>(visited_nodes) / static_cast<double>(lookups));
+    }
+
+    double allocations_per_node() const {
+        return (constructed_nodes == 0 ? 0 : static_cast<double>(allocations) / static_cast<double>(constructed_nodes));
+    }
+};
+
+/**
+ * Default statistics policy, counts nothing
+ */
+struct no_treap_statistics {
+    static constexpr bool enabled = false;
+
+    void count_lookup(size_t) const noexcept {}
+
+    void count_split() const noexcept {}
+
+    void count_merge() const noexcept {}
+
+    void count_construction(bool) const noexcept {}
+
+    void fill(treap_statistics&) const noexcept {}
+
+    void reset() noexcept {}
+};
+
+/**
+ * Counting statistics policy
+ * Counters are relaxed atomics, as const lookups and parallel set operations may count from several threads
+ * Copies and moved-to containers start counting from zero, since the counters are not part of the content
+ */
+class treap_operation_counters {
+private:
+    mutable std::atomic<size_t> _lookups {0};
+    mutable std::atomic<size_t> _visited_nodes {0};
+    mutable std::atomic<size_t> _splits {0};
+    mutable std::atomic<size_t> _merges {0};
+    mutable std::atomic<size_t> _constructed_nodes {0};
+    mutable std::atomic<size_t> _allocations {0};
+
+public:
+    static constexpr bool enabled = true;
+
+    treap_operation_counters() noexcept = default;
+
+    treap_operation_counters(const treap_operation_counters&) noexcept {}
+
+    treap_operation_counters& operator=(const treap_operation_counters&) noexcept { return *this; }
+
+    void count_lookup(size_t visited_nodes) const noexcept {
+        _lookups.fetch_add(1, std::memory_order_relaxed);
+        _visited_nodes.fetch_add(visited_nodes, std::memory_order_relaxed);
+    }
+
+    void count_split() const noexcept { _splits.fetch_add(1, std::memory_order_relaxed); }
+
+    void count_merge() const noexcept { _merges.fetch_add(1, std::memory_order_relaxed); }
+
+    /**
+     * @param allocated true, when the node pool called the allocator for the node
+     */
+    void count_construction(bool allocated) const noexcept {
+        _constructed_nodes.fetch_add(1, std::memory_order_relaxed);
+        if (allocated) {
+            _allocations.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void fill(treap_statistics& statistics) const noexcept {
+        statistics.lookups = _lookups.load(std::memory_order_relaxed);
+        statistics.visited_nodes = _visited_nodes.load(std::memory_order_relaxed);
+        statistics.splits = _splits.load(std::memory_order_relaxed);
+        statistics.merges = _merges.load(std::memory_order_relaxed);
+        statistics.constructed_nodes = _constructed_nodes.load(std::memory_order_relaxed);
+        statistics.allocations = _allocations.load(std::memory_order_relaxed);
+    }
+
+    void reset() noexcept {
+        _lookups.store(0, std::memory_order_relaxed);
+        _visited_nodes.store(0, std::memory_order_relaxed);
+        _splits.store(0, std::memory_order_relaxed);
+        _merges.store(0, std::memory_order_relaxed);
+        _constructed_nodes.store(0, std::memory_order_relaxed);
+        _allocations.store(0, std::memory_order_relaxed);
+    }
+};
+
+} // namespace nstd
+
+#endif //BASICS_TREAP_STATISTICS_HPP
@@ -2,12 +2,24 @@
 #define BASICS_VECTOR_TREE_HPP
 
 #include <implicit_treap.hpp>
+#include <monoid.hpp>
 
 namespace nstd {
 
-template <typename T, typename Allocator = std::allocator<T>>
-class vector_tree : public implicit_treap<T, Allocator> {
-    using base_type = implicit_treap<T, Allocator>;
+/**
+ * Vector based on implicit treap
+ * @tparam Operations optional operations class (range_sum_operations, range_min_operations, range_max_operations
+ * or custom one), which enables lazy interval actions and interval aggregates in O(log size) complexity
+ * @tparam Priority node priority generator, random_priority_generator by default,
+ * seeded_priority_generator gives reproducible tree shapes
+ * @tparam Layout node layout, narrow_treap_layout narrows node priority and size counters to 32 bits
+ * @tparam Statistics statistics policy, no_treap_statistics by default, treap_operation_counters counts operations
+ */
+template <typename T, typename Allocator = std::allocator<T>, typename Operations = void,
+        typename Priority = random_priority_generator, typename Layout = default_treap_layout,
+        typename Statistics = no_treap_statistics>
+class vector_tree : public implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics> {
+    using base_type = implicit_treap<T, Allocator, Operations, Priority, Layout, Statistics>;
 
 public:
     using typename base_type::value_type;
@@ -25,11 +37,7 @@ public:
 
     vector_tree(std::initializer_list<value_type> il,
                 const allocator_type& allocator = allocator_type())
-            : base_type(allocator) {
-        for (const auto& value: il) {
-            base_type::emplace_back(value);
-        }
-    }
+            : base_type(il.begin(), il.end(), allocator) {}
 };
 
 } // namespace nstd